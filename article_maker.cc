@@ -7,6 +7,7 @@
 #include "utf8.hh"
 #include "wstring_qt.hh"
 #include <limits.h>
+#include <algorithm>
 #include <QFile>
 #include <QUrl>
 #include <QTextDocumentFragment>
@@ -14,6 +15,7 @@
 #include "langcoder.hh"
 #include "gddebug.hh"
 #include "qt4x5.hh"
+#include "lookupstats.hh"
 
 using std::vector;
 using std::string;
@@ -21,6 +23,44 @@ using gd::wstring;
 using std::set;
 using std::list;
 
+namespace {
+
+/// Makes the contents of a single-quoted JavaScript string which goes into
+/// a script element of the article
+string makeJavaScriptString( string const & str )
+{
+  string escaped = Html::escapeForJavaScript( str );
+
+  string result;
+
+  result.reserve( escaped.size() );
+
+  for( size_t x = 0; x < escaped.size(); ++x )
+  {
+    // "</script>" would end the element, and the line separators the string
+    if ( escaped[ x ] == '<' && x + 1 < escaped.size() && escaped[ x + 1 ] == '/' )
+      result += "<\\";
+    else
+    if ( escaped.compare( x, 3, "\xE2\x80\xA8" ) == 0 )
+    {
+      result += "\\u2028";
+      x += 2;
+    }
+    else
+    if ( escaped.compare( x, 3, "\xE2\x80\xA9" ) == 0 )
+    {
+      result += "\\u2029";
+      x += 2;
+    }
+    else
+      result += escaped[ x ];
+  }
+
+  return result;
+}
+
+}
+
 ArticleMaker::ArticleMaker( vector< sptr< Dictionary::Class > > const & dictionaries_,
                             vector< Instances::Group > const & groups_,
                             QString const & displayStyle_,
@@ -32,6 +72,8 @@ ArticleMaker::ArticleMaker( vector< sptr< Dictionary::Class > > const & dictiona
   needExpandOptionalParts( true )
 , collapseBigArticles( true )
 , articleLimitSize( 500 )
+, stemmedSearches( new StemmedSearches )
+, sharedArticles( new Dictionary::SharedDataRequests( MaxFinishedArticles ) )
 {
 }
 
@@ -222,6 +264,50 @@ std::string ArticleMaker::makeHtmlHeader( QString const & word,
               "el=document.getElementById('gdfrom-'+s);"
               "if(el && el.className.search('gdcollapsedarticle')>0) gdExpandArticle(s);"
             "} }"
+            "function gdUpdateArticleContents() {"
+            "var arts = document.getElementsByClassName( 'gdarticle' ); gdArticleContents = '';"
+            "for ( var i = 0; i < arts.length; i++ ) gdArticleContents += arts[ i ].id.replace( 'gdfrom-', '' ) + ' '; }"
+            "function gdRemoveArticle( id ) {"
+            "var art = document.getElementById( 'gdfrom-' + id ); if ( !art ) return;"
+            "var n = art.previousSibling;"
+            "while ( n && n.nodeName == 'SCRIPT' ) { var p = n.previousSibling; n.parentNode.removeChild( n ); n = p; }"
+            "if ( !n || n.className != 'gdarticleseparator' ) { n = art.nextSibling; if ( n ) n = n.nextSibling; }"
+            "if ( n && n.className == 'gdarticleseparator' ) { n.parentNode.removeChild( n.previousSibling ); n.parentNode.removeChild( n ); }"
+            "art.parentNode.removeChild( art ); delete gdAudioLinks[ id ]; gdUpdateArticleContents();"
+            "if ( gdCurrentArticle == 'gdfrom-' + id ) {"
+              "var arts = document.getElementsByClassName( 'gdarticle' );"
+              "if ( arts.length ) { arts[ 0 ].className += ' gdactivearticle'; gdCurrentArticle = arts[ 0 ].id;"
+              "gdAudioLinks.current = gdCurrentArticle.replace( 'gdfrom-', '' ); articleview.onJsActiveArticleChanged( gdCurrentArticle ); }"
+            "} }"
+            "function gdInsertArticles( html, order ) {"
+            "var box = document.createElement( 'div' ); box.innerHTML = html;"
+            "var added = box.getElementsByClassName( 'gdarticle' );"
+            "while ( added.length ) {"
+              "var art = added[ 0 ]; art.className = art.className.replace( ' gdactivearticle', '' );"
+              "var idx = order.indexOf( art.id.replace( 'gdfrom-', '' ) );"
+              "var arts = document.getElementsByClassName( 'gdarticle' ); var next = null; var last = null;"
+              "for ( var i = 0; i < arts.length; i++ ) { last = arts[ i ];"
+              "if ( !next && order.indexOf( last.id.replace( 'gdfrom-', '' ) ) > idx ) next = last; }"
+              "if ( !last ) break;"
+              "var clear = document.createElement( 'div' ); clear.style.clear = 'both';"
+              "var sep = document.createElement( 'span' ); sep.className = 'gdarticleseparator';"
+              "if ( next ) {"
+                "while ( next.previousSibling && next.previousSibling.nodeName == 'SCRIPT' ) next = next.previousSibling;"
+                "next.parentNode.insertBefore( art, next ); next.parentNode.insertBefore( clear, next ); next.parentNode.insertBefore( sep, next );"
+              "} else {"
+                "var after = last.nextSibling; last.parentNode.insertBefore( clear, after );"
+                "last.parentNode.insertBefore( sep, after ); last.parentNode.insertBefore( art, after ); }"
+              "gdRecreateScripts( art );"
+            "} gdUpdateArticleContents(); }"
+            "function gdAppendArticleBody( id, html ) {"
+            "var body = document.getElementById( 'gdarticlefrom-' + id ); if ( !body ) return;"
+            "var box = document.createElement( 'div' ); box.innerHTML = html; gdRecreateScripts( box );"
+            "while ( box.firstChild ) body.appendChild( box.firstChild ); }"
+            // Scripts set through innerHTML don't run, so they are recreated
+            "function gdRecreateScripts( el ) {"
+            "var s = el.getElementsByTagName( 'script' );"
+            "for ( var i = 0; i < s.length; i++ ) { var n = document.createElement( 'script' ); n.type = 'text/javascript';"
+            "if ( s[ i ].src ) n.src = s[ i ].src; else n.text = s[ i ].text; s[ i ].parentNode.replaceChild( n, s[ i ] ); } }"
             "</script>";
 
   result += "</head><body>";
@@ -286,7 +372,7 @@ sptr< Dictionary::DataRequest > ArticleMaker::makeDefinitionFor(
     string header = makeHtmlHeader( phrase.phrase, QString(), true );
 
     return new ArticleRequest( phrase, "",
-                               contexts, ftsDicts, header,
+                               contexts, ftsDicts, stemmedSearches, sharedArticles, header,
                                -1, true );
   }
 
@@ -368,6 +454,9 @@ sptr< Dictionary::DataRequest > ArticleMaker::makeDefinitionFor(
                                     activeGroup->icon : QString(),
                                   needExpandOptionalParts );
 
+  sptr< LookupTrace::Lookup > trace =
+    LookupTrace::startLookup( LookupTrace::Article, phrase.phrase, groupId );
+
   if ( mutedDicts.size() )
   {
     std::vector< sptr< Dictionary::Class > > unmutedDicts;
@@ -380,15 +469,15 @@ sptr< Dictionary::DataRequest > ArticleMaker::makeDefinitionFor(
         unmutedDicts.push_back( activeDicts[ x ] );
 
     return new ArticleRequest( phrase, activeGroup ? activeGroup->name : "",
-                               contexts, unmutedDicts, header,
+                               contexts, unmutedDicts, stemmedSearches, sharedArticles, header,
                                collapseBigArticles ? articleLimitSize : -1,
-                               needExpandOptionalParts, ignoreDiacritics );
+                               needExpandOptionalParts, ignoreDiacritics, trace );
   }
   else
     return new ArticleRequest( phrase, activeGroup ? activeGroup->name : "",
-                               contexts, activeDicts, header,
+                               contexts, activeDicts, stemmedSearches, sharedArticles, header,
                                collapseBigArticles ? articleLimitSize : -1,
-                               needExpandOptionalParts, ignoreDiacritics );
+                               needExpandOptionalParts, ignoreDiacritics, trace );
 }
 
 sptr< Dictionary::DataRequest > ArticleMaker::makeNotFoundTextFor(
@@ -464,22 +553,118 @@ bool ArticleMaker::adjustFilePath( QString & fileName )
   return false;
 }
 
+//////// StemmedSearches
+
+sptr< WordFinder > StemmedSearches::acquire( QString const & word,
+                                             vector< sptr< Dictionary::Class > > const & dicts )
+{
+  QString key = word;
+
+  for( unsigned x = 0; x < dicts.size(); ++x )
+    key += QChar( 0 ) + QString::fromStdString( dicts[ x ]->getId() );
+
+  for( list< Search >::iterator i = searches.begin(); i != searches.end(); ++i )
+  {
+    if ( !i->key.isEmpty() && i->key == key )
+    {
+      ++i->users;
+      searches.splice( searches.begin(), searches, i );
+
+      return i->finder;
+    }
+  }
+
+  searches.push_front( Search() );
+
+  Search & search = searches.front();
+
+  search.key = key;
+  search.dicts = dicts;
+  search.finder = new WordFinder( 0 );
+  search.users = 1;
+
+  search.finder->stemmedMatch( word, search.dicts );
+
+  return search.finder;
+}
+
+void StemmedSearches::release( sptr< WordFinder > const & finder )
+{
+  list< Search >::iterator i;
+
+  for( i = searches.begin(); i != searches.end(); ++i )
+    if ( i->finder.get() == finder.get() )
+      break;
+
+  if ( i == searches.end() )
+    return; // Dropped by clear()
+
+  if ( --i->users )
+    return;
+
+  if ( !i->finder->isSearchFinished() )
+  {
+    // No one needs it anymore
+    i->finder->cancel();
+    searches.erase( i );
+    return;
+  }
+
+  // Keep the latest finished ones only
+
+  unsigned finished = 0;
+
+  for( i = searches.begin(); i != searches.end(); )
+  {
+    if ( !i->users && ++finished > MaxFinishedSearches )
+      searches.erase( i++ );
+    else
+      ++i;
+  }
+}
+
+void StemmedSearches::clear()
+{
+  for( list< Search >::iterator i = searches.begin(); i != searches.end(); )
+  {
+    if ( i->users )
+    {
+      // Still in use, so its dictionaries must stay. Make sure it won't be
+      // reused with the new ones, and it would go once released.
+      i->key.clear();
+      ++i;
+    }
+    else
+      searches.erase( i++ );
+  }
+}
+
 //////// ArticleRequest
 
 ArticleRequest::ArticleRequest(
   Config::InputPhrase const & phrase, QString const & group_,
   QMap< QString, QString > const & contexts_,
   vector< sptr< Dictionary::Class > > const & activeDicts_,
+  sptr< StemmedSearches > const & stemmedSearches_,
+  sptr< Dictionary::SharedDataRequests > const & sharedArticles_,
   string const & header,
-  int sizeLimit, bool needExpandOptionalParts_, bool ignoreDiacritics_ ):
+  int sizeLimit, bool needExpandOptionalParts_, bool ignoreDiacritics_,
+  sptr< LookupTrace::Lookup > const & trace_ ):
     word( phrase.phrase ), group( group_ ), contexts( contexts_ ),
     activeDicts( activeDicts_ ),
     altsDone( false ), bodyDone( false ), foundAnyDefinitions( false ),
-    closePrevSpan( false )
+    closePrevSpan( false ),
+    stemmedSearches( stemmedSearches_ ),
+    sharedArticles( sharedArticles_ )
 ,   articleSizeLimit( sizeLimit )
 ,   needExpandOptionalParts( needExpandOptionalParts_ )
 ,   ignoreDiacritics( ignoreDiacritics_ )
+,   trace( trace_ )
 {
+  // We may finish right away, so this goes first
+  if ( trace.get() )
+    connect( this, SIGNAL( finished() ), this, SLOT( lookupFinished() ) );
+
   if ( !phrase.punctuationSuffix.isEmpty() )
     alts.insert( gd::toWString( phrase.phraseWithSuffix() ) );
 
@@ -502,14 +687,80 @@ ArticleRequest::ArticleRequest(
     altSearches.push_back( s );
   }
 
-  altSearchFinished(); // Handle any ones which have already finished
+  collectAlts(); // Take the ones which have already finished
+
+  // Don't wait for the slow synonym searches (Hunspell, DICT servers, wikis)
+  // to start looking up bodies -- the alternate writings they find later
+  // are looked up with supplementary requests.
+
+  if( activeDicts.size() <= 1 )
+    articleSizeLimit = -1; // Don't collapse article if only one dictionary presented
+
+  requestedAlts = alts;
+
+  vector< wstring > altsVector( alts.begin(), alts.end() );
+
+  wstring wordStd = gd::toWString( word );
+
+  // The dictionaries which find the words most often are queried first, so
+  // that their requests would be the first to get the threads. The bodies
+  // are still shown in the order of the group.
+
+  vector< unsigned > queryOrder = LookupStats::instance().getQueryOrder( activeDicts );
+
+  vector< sptr< Dictionary::DataRequest > > mainRequests( activeDicts.size() );
+  vector< char > mainSkipped( activeDicts.size(), 0 );
+
+  for( unsigned x = 0; x < queryOrder.size(); ++x )
+  {
+    bool skipped;
+
+    mainRequests[ queryOrder[ x ] ] = requestArticle( queryOrder[ x ], wordStd, altsVector, skipped );
+    mainSkipped[ queryOrder[ x ] ] = skipped;
+  }
+
+  for( unsigned x = 0; x < activeDicts.size(); ++x )
+  {
+    if ( mainRequests[ x ].get() )
+    {
+      bodyRequests.push_back( BodyRequest() );
+      bodyRequests.back().dictIndex = x;
+      bodyRequests.back().main = mainRequests[ x ];
+      bodyRequests.back().mainAppended = false;
+      bodyRequests.back().mainFound = false;
+      bodyRequests.back().queried = !mainSkipped[ x ];
+    }
+  }
+
+  altSearchFinished(); // Handle the case when all of them have already finished
 }
 
-void ArticleRequest::altSearchFinished()
+ArticleRequest::~ArticleRequest()
 {
-  if ( altsDone )
-    return;
+  for( list< BodyRequest >::iterator i = bodyRequests.begin(); i != bodyRequests.end(); ++i )
+    releaseBody( *i );
+
+  if ( stemmedWordFinder.get() )
+    stemmedSearches->release( stemmedWordFinder );
+}
+
+void ArticleRequest::releaseBody( BodyRequest & body )
+{
+  // The requests may still signal us, yet we won't look at them anymore
+  disconnect( body.main.get(), 0, this, 0 );
+  sharedArticles->release( body.main );
+  body.main.reset();
 
+  if ( body.extra.get() )
+  {
+    disconnect( body.extra.get(), 0, this, 0 );
+    sharedArticles->release( body.extra );
+    body.extra.reset();
+  }
+}
+
+void ArticleRequest::collectAlts()
+{
   // Check every request for finishing
   for( list< sptr< Dictionary::WordSearchRequest > >::iterator i =
          altSearches.begin(); i != altSearches.end(); )
@@ -525,6 +776,75 @@ void ArticleRequest::altSearchFinished()
     else
       ++i;
   }
+}
+
+sptr< Dictionary::DataRequest > ArticleRequest::requestArticle( unsigned dictIndex,
+                                                                wstring const & mainWord,
+                                                                vector< wstring > const & altsVector,
+                                                                bool & skipped )
+{
+  skipped = false;
+
+  try
+  {
+    Dictionary::Class & dict = *activeDicts[ dictIndex ];
+
+    // The dictionaries which rarely have the words asked for are only
+    // queried if they might have any of the writings
+    if ( LookupStats::instance().isRarelyFound( dict.getId() )
+         && !dict.mayHaveArticles( mainWord ) )
+    {
+      unsigned x = 0;
+
+      while( x < altsVector.size() && !dict.mayHaveArticles( altsVector[ x ] ) )
+        ++x;
+
+      if ( x == altsVector.size() )
+      {
+        skipped = true;
+        return new Dictionary::DataRequestInstant( false );
+      }
+    }
+
+    wstring context = gd::toWString( contexts.value( QString::fromStdString( dict.getId() ) ) );
+
+    // The same article is often asked for by several views at once, e.g. by
+    // the main window and the popup, so the requests are shared
+
+    string key = Dictionary::SharedDataRequests::makeArticleKey( dict, mainWord, altsVector,
+                                                                 context, ignoreDiacritics );
+
+    sptr< Dictionary::DataRequest > r = sharedArticles->acquire( key );
+
+    if ( !r.get() )
+    {
+      r = dict.getArticle( mainWord, altsVector, context, ignoreDiacritics );
+      sharedArticles->add( key, r );
+    }
+
+    connect( r.get(), SIGNAL( finished() ),
+             this, SLOT( bodyFinished() ), Qt::QueuedConnection );
+
+    if ( trace.get() )
+      trace->addRequest( r.get(), dict.getId() );
+
+    return r;
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "getArticle request error (%s) in \"%s\"\n",
+               e.what(), activeDicts[ dictIndex ]->getName().c_str() );
+  }
+
+  return sptr< Dictionary::DataRequest >();
+}
+
+void ArticleRequest::altSearchFinished()
+{
+  if ( altsDone || isFinished() )
+    return;
+
+  collectAlts();
 
   if ( altSearches.empty() )
   {
@@ -532,42 +852,44 @@ void ArticleRequest::altSearchFinished()
     qDebug( "alts finished\n" );
 #endif
 
-    // They all've finished! Now we can look up bodies
-
     altsDone = true; // So any pending signals in queued mode won't mess us up
 
-    vector< wstring > altsVector( alts.begin(), alts.end() );
-
 #ifdef QT_DEBUG
-    for( unsigned x = 0; x < altsVector.size(); ++x )
+    for( set< wstring >::const_iterator i = alts.begin(); i != alts.end(); ++i )
     {
-      qDebug() << "Alt:" << gd::toQString( altsVector[ x ] );
+      if ( requestedAlts.find( *i ) == requestedAlts.end() )
+        qDebug() << "Alt:" << gd::toQString( *i );
     }
 #endif
 
+    // If any alternate writings were found after the bodies had been
+    // requested, only those are looked up, and the articles they bring are
+    // added to the ones already shown
+
     wstring wordStd = gd::toWString( word );
 
-    if( activeDicts.size() <= 1 )
-      articleSizeLimit = -1; // Don't collapse article if only one dictionary presented
+    vector< wstring > newAlts;
 
-    for( unsigned x = 0; x < activeDicts.size(); ++x )
+    for( set< wstring >::const_iterator i = alts.begin(); i != alts.end(); ++i )
     {
-      try
-      {
-        sptr< Dictionary::DataRequest > r =
-          activeDicts[ x ]->getArticle( wordStd, altsVector,
-                                        gd::toWString( contexts.value( QString::fromStdString( activeDicts[ x ]->getId() ) ) ),
-                                        ignoreDiacritics );
+      if ( *i != wordStd && requestedAlts.find( *i ) == requestedAlts.end() )
+        newAlts.push_back( *i );
+    }
 
-        connect( r.get(), SIGNAL( finished() ),
-                 this, SLOT( bodyFinished() ), Qt::QueuedConnection );
+    if ( newAlts.size() )
+    {
+      wstring firstAlt = newAlts.front();
 
-        bodyRequests.push_back( r );
-      }
-      catch( std::exception & e )
+      newAlts.erase( newAlts.begin() );
+
+      for( list< BodyRequest >::iterator i = bodyRequests.begin(); i != bodyRequests.end(); ++i )
       {
-        gdWarning( "getArticle request error (%s) in \"%s\"\n",
-                   e.what(), activeDicts[ x ]->getName().c_str() );
+        bool skipped;
+
+        i->extra = requestArticle( i->dictIndex, firstAlt, newAlts, skipped );
+
+        if ( !skipped )
+          i->queried = true;
       }
     }
 
@@ -593,167 +915,299 @@ int ArticleRequest::findEndOfCloseDiv( const QString &str, int pos )
   }
 }
 
-void ArticleRequest::bodyFinished()
+string ArticleRequest::makeArticleHead( unsigned dictIndex, Dictionary::DataRequest & req,
+                                        bool active )
 {
-  if ( bodyDone )
-    return;
+  sptr< Dictionary::Class > const & activeDict = activeDicts[ dictIndex ];
 
-  GD_DPRINTF( "some body finished\n" );
+  string dictId = activeDict->getId();
 
-  bool wasUpdated = false;
+  string gdFrom = "gdfrom-" + Html::escape( dictId );
+
+  string head;
 
-  while ( bodyRequests.size() )
+  bool collapse = false;
+  if( articleSizeLimit >= 0 )
   {
-    // Since requests should go in order, check the first one first
-    if ( bodyRequests.front()->isFinished() )
+    try
+    {
+      Mutex::Lock _( dataMutex );
+      QString text = QString::fromUtf8( req.getFullData().data(), req.getFullData().size() );
+
+      if( !needExpandOptionalParts )
+      {
+        // Strip DSL optional parts
+        int pos = 0;
+        for( ; ; )
+        {
+          pos = text.indexOf( "<div class=\"dsl_opt\"" );
+          if( pos > 0 )
+          {
+            int endPos = findEndOfCloseDiv( text, pos + 1 );
+            if( endPos > pos)
+              text.remove( pos, endPos - pos );
+            else
+              break;
+          }
+          else
+            break;
+        }
+      }
+
+      int size = QTextDocumentFragment::fromHtml( text ).toPlainText().length();
+      if( size > articleSizeLimit )
+        collapse = true;
+    }
+    catch(...)
     {
-      // Good
+    }
+  }
 
-      GD_DPRINTF( "one finished.\n" );
+  string jsVal = Html::escapeForJavaScript( dictId );
+  head += "<script type=\"text/javascript\">var gdArticleContents; "
+    "if ( !gdArticleContents ) gdArticleContents = \"" + jsVal +" \"; "
+    "else gdArticleContents += \"" + jsVal + " \";</script>";
+
+  head += string( "<div class=\"gdarticle" ) +
+          ( active ? " gdactivearticle" : "" ) +
+          ( collapse ? " gdcollapsedarticle" : "" ) +
+          "\" id=\"" + gdFrom +
+          "\" onClick=\"gdMakeArticleActive( '" + jsVal + "' );\" " +
+          " onContextMenu=\"gdMakeArticleActive( '" + jsVal + "' );\""
+          + ">";
+
+  head += string( "<div class=\"gddictname\" onclick=\"gdExpandArticle(\'" ) + dictId + "\');"
+    + ( collapse ? "\" style=\"cursor:pointer;" : "" )
+    + "\" id=\"gddictname-" + Html::escape( dictId ) + "\""
+    + ( collapse ? string( " title=\"" ) + tr( "Expand article" ).toUtf8().data() + "\"" : "" )
+    + "><span class=\"gddicticon\"><img src=\"gico://" + Html::escape( dictId )
+    + "/dicticon.png\"></span><span class=\"gdfromprefix\">"  +
+    Html::escape( tr( "From " ).toUtf8().data() ) + "</span><span class=\"gddicttitle\">" +
+    Html::escape( activeDict->getName().c_str() ) + "</span>"
+    + "<span class=\"collapse_expand_area\"><img src=\"qrcx://localhost/icons/blank.png\" class=\""
+    + ( collapse ? "gdexpandicon" : "gdcollapseicon" )
+    + "\" id=\"expandicon-" + Html::escape( dictId ) + "\""
+    + ( collapse ? "" : string( " title=\"" ) + tr( "Collapse article" ).toUtf8().data() + "\"" )
+    + "></span>" + "</div>";
+
+  head += "<div class=\"gddictnamebodyseparator\"></div>";
+
+  head += "<div class=\"gdarticlebody gdlangfrom-";
+  head += LangCoder::intToCode2( activeDict->getLangFrom() ).toLatin1().data();
+  head += "\" lang=\"";
+  head += LangCoder::intToCode2( activeDict->getLangTo() ).toLatin1().data();
+  head += "\"";
+  head += " style=\"display:";
+  head += collapse ? "none" : "inline";
+  head += string( "\" id=\"gdarticlefrom-" ) + Html::escape( dictId ) + "\">";
+
+  return head;
+}
 
-      Dictionary::DataRequest & req = *bodyRequests.front();
+bool ArticleRequest::appendBody( unsigned dictIndex, Dictionary::DataRequest & req )
+{
+  QString errorString = req.getErrorString();
 
-      QString errorString = req.getErrorString();
+  if ( req.dataSize() < 0 && errorString.isEmpty() )
+    return false;
 
-      if ( req.dataSize() >= 0 || errorString.size() )
-      {
-        sptr< Dictionary::Class > const & activeDict =
-            activeDicts[ activeDicts.size() - bodyRequests.size() ];
+  string head;
 
-        string dictId = activeDict->getId();
+  if ( closePrevSpan )
+  {
+    head += "</div></div><div style=\"clear:both;\"></div><span class=\"gdarticleseparator\"></span>";
+  }
+  else
+  {
+    // This is the first article
+    head += "<script type=\"text/javascript\">"
+            "var gdCurrentArticle=\"gdfrom-" + Html::escape( activeDicts[ dictIndex ]->getId() ) + "\"; "
+            "articleview.onJsActiveArticleChanged(gdCurrentArticle)</script>";
+  }
 
-        string head;
+  head += makeArticleHead( dictIndex, req, !closePrevSpan );
 
-        string gdFrom = "gdfrom-" + Html::escape( dictId );
+  closePrevSpan = true;
 
-        if ( closePrevSpan )
-        {
-          head += "</div></div><div style=\"clear:both;\"></div><span class=\"gdarticleseparator\"></span>";
-        }
-        else
-        {
-          // This is the first article
-          head += "<script type=\"text/javascript\">"
-                  "var gdCurrentArticle=\"" + gdFrom  + "\"; "
-                  "articleview.onJsActiveArticleChanged(gdCurrentArticle)</script>";
-        }
+  if ( errorString.size() )
+  {
+    head += "<div class=\"gderrordesc\">" +
+      Html::escape( tr( "Query error: %1" ).arg( errorString ).toUtf8().data() )
+    + "</div>";
+  }
 
-        bool collapse = false;
-        if( articleSizeLimit >= 0 )
-        {
-          try
-          {
-            Mutex::Lock _( dataMutex );
-            QString text = QString::fromUtf8( req.getFullData().data(), req.getFullData().size() );
-
-            if( !needExpandOptionalParts )
-            {
-              // Strip DSL optional parts
-              int pos = 0;
-              for( ; ; )
-              {
-                pos = text.indexOf( "<div class=\"dsl_opt\"" );
-                if( pos > 0 )
-                {
-                  int endPos = findEndOfCloseDiv( text, pos + 1 );
-                  if( endPos > pos)
-                    text.remove( pos, endPos - pos );
-                  else
-                    break;
-                }
-                else
-                  break;
-              }
-            }
-
-            int size = QTextDocumentFragment::fromHtml( text ).toPlainText().length();
-            if( size > articleSizeLimit )
-              collapse = true;
-          }
-          catch(...)
-          {
-          }
-        }
+  Mutex::Lock _( dataMutex );
 
-        string jsVal = Html::escapeForJavaScript( dictId );
-        head += "<script type=\"text/javascript\">var gdArticleContents; "
-          "if ( !gdArticleContents ) gdArticleContents = \"" + jsVal +" \"; "
-          "else gdArticleContents += \"" + jsVal + " \";</script>";
-
-        head += string( "<div class=\"gdarticle" ) +
-                ( closePrevSpan ? "" : " gdactivearticle" ) +
-                ( collapse ? " gdcollapsedarticle" : "" ) +
-                "\" id=\"" + gdFrom +
-                "\" onClick=\"gdMakeArticleActive( '" + jsVal + "' );\" " +
-                " onContextMenu=\"gdMakeArticleActive( '" + jsVal + "' );\""
-                + ">";
-
-        closePrevSpan = true;
-
-        head += string( "<div class=\"gddictname\" onclick=\"gdExpandArticle(\'" ) + dictId + "\');"
-          + ( collapse ? "\" style=\"cursor:pointer;" : "" )
-          + "\" id=\"gddictname-" + Html::escape( dictId ) + "\""
-          + ( collapse ? string( " title=\"" ) + tr( "Expand article" ).toUtf8().data() + "\"" : "" )
-          + "><span class=\"gddicticon\"><img src=\"gico://" + Html::escape( dictId )
-          + "/dicticon.png\"></span><span class=\"gdfromprefix\">"  +
-          Html::escape( tr( "From " ).toUtf8().data() ) + "</span><span class=\"gddicttitle\">" +
-          Html::escape( activeDict->getName().c_str() ) + "</span>"
-          + "<span class=\"collapse_expand_area\"><img src=\"qrcx://localhost/icons/blank.png\" class=\""
-          + ( collapse ? "gdexpandicon" : "gdcollapseicon" )
-          + "\" id=\"expandicon-" + Html::escape( dictId ) + "\""
-          + ( collapse ? "" : string( " title=\"" ) + tr( "Collapse article" ).toUtf8().data() + "\"" )
-          + "></span>" + "</div>";
-
-        head += "<div class=\"gddictnamebodyseparator\"></div>";
-
-        head += "<div class=\"gdarticlebody gdlangfrom-";
-        head += LangCoder::intToCode2( activeDict->getLangFrom() ).toLatin1().data();
-        head += "\" lang=\"";
-        head += LangCoder::intToCode2( activeDict->getLangTo() ).toLatin1().data();
-        head += "\"";
-        head += " style=\"display:";
-        head += collapse ? "none" : "inline";
-        head += string( "\" id=\"gdarticlefrom-" ) + Html::escape( dictId ) + "\">";
-
-        if ( errorString.size() )
-        {
-          head += "<div class=\"gderrordesc\">" +
-            Html::escape( tr( "Query error: %1" ).arg( errorString ).toUtf8().data() )
-          + "</div>";
-        }
+  size_t offset = data.size();
 
-        Mutex::Lock _( dataMutex );
+  data.resize( data.size() + head.size() + ( req.dataSize() > 0 ? req.dataSize() : 0 ) );
 
-        size_t offset = data.size();
+  memcpy( &data.front() + offset, head.data(), head.size() );
 
-        data.resize( data.size() + head.size() + ( req.dataSize() > 0 ? req.dataSize() : 0 ) );
+  try
+  {
+    if ( req.dataSize() > 0 )
+      req.getDataSlice( 0, req.dataSize(), &data.front() + offset + head.size() );
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "getDataSlice error: %s\n", e.what() );
+  }
 
-        memcpy( &data.front() + offset, head.data(), head.size() );
+  foundAnyDefinitions = true;
 
-        try
-        {
-          if ( req.dataSize() > 0 )
-            bodyRequests.front()->getDataSlice( 0, req.dataSize(),
-                                                &data.front() + offset + head.size() );
-        }
-        catch( std::exception & e )
-        {
-          gdWarning( "getDataSlice error: %s\n", e.what() );
-        }
+  return true;
+}
 
-        wasUpdated = true;
+bool ArticleRequest::applyExtraBody( BodyRequest & body )
+{
+  Dictionary::DataRequest & req = *body.extra;
 
-        foundAnyDefinitions = true;
+  if ( req.dataSize() <= 0 || !req.getErrorString().isEmpty() )
+    return false;
+
+  vector< char > extraBody;
+
+  try
+  {
+    extraBody = req.getFullData();
+
+    // The articles found through the new writings may have been found
+    // through the word already
+    if ( body.mainFound && body.main->dataSize() > 0 )
+    {
+      vector< char > mainBody = body.main->getFullData();
+
+      if ( std::search( mainBody.begin(), mainBody.end(),
+                        extraBody.begin(), extraBody.end() ) != mainBody.end() )
+        return false;
+    }
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "getFullData error: %s\n", e.what() );
+    return false;
+  }
+
+  if ( !body.mainFound && !closePrevSpan )
+  {
+    // Nothing is shown yet, so the article can simply go next
+    return appendBody( body.dictIndex, req );
+  }
+
+  // Otherwise the article is put in place by a script, since the articles
+  // after it may have been shown already
+
+  string dictId = activeDicts[ body.dictIndex ]->getId();
+
+  string script = "<script type=\"text/javascript\">";
+
+  if ( body.mainFound )
+  {
+    script += "gdAppendArticleBody( '" + Html::escapeForJavaScript( dictId ) + "', '"
+              + makeJavaScriptString( string( extraBody.begin(), extraBody.end() ) ) + "' );";
+  }
+  else
+  {
+    string article = makeArticleHead( body.dictIndex, req, false )
+                     + string( extraBody.begin(), extraBody.end() ) + "</div></div>";
+
+    string order;
+
+    for( unsigned x = 0; x < activeDicts.size(); ++x )
+    {
+      if ( x )
+        order += ", ";
+
+      order += "'" + Html::escapeForJavaScript( activeDicts[ x ]->getId() ) + "'";
+    }
+
+    script += "gdInsertArticles( '" + makeJavaScriptString( article ) + "', [ " + order + " ] );";
+  }
+
+  script += "</script>";
+
+  appendToData( script );
+
+  foundAnyDefinitions = true;
+
+  return true;
+}
+
+void ArticleRequest::bodyFinished()
+{
+  if ( bodyDone || isFinished() )
+    return; // Done or cancelled -- the cancelled bodies must not trigger
+            // the stemmed search
+
+  GD_DPRINTF( "some body finished\n" );
+
+  if ( trace.get() )
+  {
+    // The bodies are handled in order, so the ones finished out of it are
+    // only noticed here
+    for( list< BodyRequest >::iterator i = bodyRequests.begin(); i != bodyRequests.end(); ++i )
+    {
+      if ( i->main->isFinished() )
+        trace->requestFinished( i->main.get(), i->main->dataSize() > 0 );
+
+      if ( i->extra.get() && i->extra->isFinished() )
+        trace->requestFinished( i->extra.get(), i->extra->dataSize() > 0 );
+    }
+  }
+
+  bool wasUpdated = false;
+
+  for( list< BodyRequest >::iterator i = bodyRequests.begin(); i != bodyRequests.end(); )
+  {
+    BodyRequest & body = *i;
+
+    if ( !body.mainAppended )
+    {
+      // The articles are shown in the order of the group, so the ones
+      // after an unfinished body have to wait
+      if ( !body.main->isFinished() )
+      {
+        GD_DPRINTF( "one not finished.\n" );
+        break;
       }
-      GD_DPRINTF( "erasing..\n" );
-      bodyRequests.pop_front();
-      GD_DPRINTF( "erase done..\n" );
+
+      GD_DPRINTF( "one finished.\n" );
+
+      body.mainFound = appendBody( body.dictIndex, *body.main );
+      body.mainAppended = true;
+
+      if ( body.mainFound )
+        wasUpdated = true;
     }
-    else
+
+    // Each article shown is completed on its own once the alternate writings
+    // are known, without holding the ones after it
+
+    if ( !altsDone || ( body.extra.get() && !body.extra->isFinished() ) )
     {
-      GD_DPRINTF( "one not finished.\n" );
-      break;
+      ++i;
+      continue;
+    }
+
+    bool found = body.mainFound;
+
+    if ( body.extra.get() && applyExtraBody( body ) )
+    {
+      wasUpdated = true;
+      found = true;
     }
+
+    // The skipped lookups would only make the dictionaries look even less
+    // useful, keeping them skipped for good
+    if ( body.queried )
+      LookupStats::instance().addLookup( activeDicts[ body.dictIndex ]->getId(), found );
+
+    releaseBody( body );
+
+    GD_DPRINTF( "erasing..\n" );
+    bodyRequests.erase( i++ );
+    GD_DPRINTF( "erase done..\n" );
   }
 
   if ( bodyRequests.empty() )
@@ -779,13 +1233,15 @@ void ArticleRequest::bodyFinished()
         // with their full bodies.
         footer += ArticleMaker::makeNotFoundBody( word.size() < 40 ? word : "", group );
 
-        // When there were no definitions, we run stemmed search.
-        stemmedWordFinder = new WordFinder( this );
-
-        connect( stemmedWordFinder.get(), SIGNAL( finished() ),
-                 this, SLOT( stemmedSearchFinished() ), Qt::QueuedConnection );
+        // When there were no definitions, we run stemmed search, unless
+        // some other request has already run it.
+        stemmedWordFinder = stemmedSearches->acquire( word, activeDicts );
 
-        stemmedWordFinder->stemmedMatch( word, activeDicts );
+        if ( stemmedWordFinder->isSearchFinished() )
+          QMetaObject::invokeMethod( this, "stemmedSearchFinished", Qt::QueuedConnection );
+        else
+          connect( stemmedWordFinder.get(), SIGNAL( finished() ),
+                   this, SLOT( stemmedSearchFinished() ), Qt::QueuedConnection );
       }
       else
       {
@@ -813,6 +1269,9 @@ void ArticleRequest::bodyFinished()
 
 void ArticleRequest::stemmedSearchFinished()
 {
+  if ( isFinished() )
+    return; // Cancelled
+
   // Got stemmed matching results
 
   WordFinder::SearchResults sr = stemmedWordFinder->getResults();
@@ -844,18 +1303,7 @@ void ArticleRequest::stemmedSearchFinished()
 
   if ( splittedWords.first.size() > 1 ) // Contains more than one word
   {
-    disconnect( stemmedWordFinder.get(), SIGNAL( finished() ),
-                this, SLOT( stemmedSearchFinished() ) );
-
-    connect( stemmedWordFinder.get(), SIGNAL( finished() ),
-             this, SLOT( individualWordFinished() ), Qt::QueuedConnection );
-
-    currentSplittedWordStart = -1;
-    currentSplittedWordEnd = currentSplittedWordStart;
-
-    firstCompoundWasFound = false;
-
-    compoundSearchNextStep( false );
+    startCompoundSearch();
 
     continueMatching = true;
   }
@@ -874,195 +1322,251 @@ void ArticleRequest::stemmedSearchFinished()
   }
 
   if ( continueMatching )
+  {
     update();
+
+    compoundSearchFinished(); // Handle the case when all of them have already finished
+  }
   else
     finish();
 }
 
-void ArticleRequest::compoundSearchNextStep( bool lastSearchSucceeded )
+void ArticleRequest::startCompoundSearch()
 {
-  if ( !lastSearchSucceeded )
-  {
-    // Last search was unsuccessful. First, emit what we had.
+  // All the compounds of two or more adjacent words are looked up at once,
+  // each dictionary getting them in a single request. Longer compounds are
+  // rare, so they aren't looked up.
+
+  int const maxCompoundWords = 8;
+
+  int wordsCount = splittedWords.first.size();
 
-    string footer;
+  vector< wstring > compounds;
 
-    if ( lastGoodCompoundResult.size() ) // We have something to append
+  for( int start = 0; start < wordsCount - 1; ++start )
+  {
+    for( int end = start + 1; end < wordsCount && end - start < maxCompoundWords; ++end )
     {
-//      DPRINTF( "Appending\n" );
+      compoundCandidates.push_back( QPair< int, int >( start, end ) );
+      compounds.push_back( gd::toWString( makeSplittedWordCompound( start, end ) ) );
+    }
+  }
 
-      if ( !firstCompoundWasFound )
-      {
-        // Append the beginning
-        footer += "<div class=\"gdstemmedsuggestion\"><span class=\"gdstemmedsuggestion_head\">" +
-          Html::escape( tr( "Compound expressions: " ).toUtf8().data() ) +
-          "</span><span class=\"gdstemmedsuggestion_body\">";
+  compoundCandidateFound.assign( compoundCandidates.size(), false );
 
-        firstCompoundWasFound = true;
-      }
-      else
-      {
-        // Append the separator
-        footer += " / ";
-      }
+  vector< sptr< Dictionary::Class > > compoundDicts;
 
-      footer += linkWord( lastGoodCompoundResult );
+  for( unsigned x = 0; x < activeDicts.size(); ++x )
+  {
+    if ( activeDicts[ x ]->getFeatures() & Dictionary::SuitableForCompoundSearching )
+      compoundDicts.push_back( activeDicts[ x ] );
+  }
 
-      lastGoodCompoundResult.clear();
-    }
+  // Each compound is looked up along with its alternate writings, like
+  // WordFinder::expressionMatch() does
 
-    // Then, start a new search for the next word, if possible
+  for( unsigned x = 0; x < activeDicts.size(); ++x )
+    activeDicts[ x ]->prepareAlternateWritings( compounds );
 
-    if ( currentSplittedWordStart >= splittedWords.first.size() - 2 )
-    {
-      // The last word was the last possible to start from
+  vector< wstring > writings;
 
-      if ( firstCompoundWasFound )
-        footer += "</span>";
+  for( unsigned c = 0; c < compounds.size(); ++c )
+  {
+    vector< unsigned > & indices = compoundCandidatesByWriting[ compounds[ c ] ];
 
-      // Now add links to all the individual words. They conclude the result.
+    if ( indices.empty() )
+      writings.push_back( compounds[ c ] );
 
-      footer += "<div class=\"gdstemmedsuggestion\"><span class=\"gdstemmedsuggestion_head\">" +
-        Html::escape( tr( "Individual words: " ).toUtf8().data() ) +
-        "</span><span class=\"gdstemmedsuggestion_body\"";
-      if( splittedWords.first[ 0 ].isRightToLeft() )
-        footer += " dir=\"rtl\"";
-      footer += ">";
+    indices.push_back( c );
 
-      footer += escapeSpacing( splittedWords.second[ 0 ] );
+    for( unsigned x = 0; x < activeDicts.size(); ++x )
+    {
+      vector< wstring > alts = activeDicts[ x ]->getAlternateWritings( compounds[ c ] );
 
-      for( int x = 0; x < splittedWords.first.size(); ++x )
+      for( unsigned y = 0; y < alts.size(); ++y )
       {
-        footer += linkWord( splittedWords.first[ x ] );
-        footer += escapeSpacing( splittedWords.second[ x + 1 ] );
-      }
+        vector< unsigned > & altIndices = compoundCandidatesByWriting[ alts[ y ] ];
 
-      footer += "</span>";
+        if ( altIndices.empty() )
+          writings.push_back( alts[ y ] );
 
-      footer += "</body></html>";
+        if ( std::find( altIndices.begin(), altIndices.end(), c ) == altIndices.end() )
+          altIndices.push_back( c );
+      }
+    }
+  }
 
-      appendToData( footer );
+  for( unsigned x = 0; x < compoundDicts.size(); ++x )
+  {
+    try
+    {
+      sptr< Dictionary::WordSearchRequest > s = compoundDicts[ x ]->findHeadwords( writings );
 
-      finish();
+      connect( s.get(), SIGNAL( finished() ),
+               this, SLOT( compoundSearchFinished() ), Qt::QueuedConnection );
 
-      return;
+      compoundSearches.push_back( s );
     }
-
-    if ( footer.size() )
+    catch( std::exception & e )
     {
-      appendToData( footer );
-      update();
+      gdWarning( "Compound search error (%s) in \"%s\"\n",
+                 e.what(), compoundDicts[ x ]->getName().c_str() );
     }
-
-    // Advance to the next word and start from looking up two words
-    ++currentSplittedWordStart;
-    currentSplittedWordEnd = currentSplittedWordStart + 1;
   }
-  else
-  {
-    // Last lookup succeeded -- see if we can try the larger sequence
+}
 
-    if ( currentSplittedWordEnd < splittedWords.first.size() - 1 )
-    {
-      // We can, indeed.
-      ++currentSplittedWordEnd;
-    }
-    else
-    {
-      // We can't. Emit what we have and start over.
+void ArticleRequest::compoundSearchFinished()
+{
+  if ( isFinished() )
+    return;
 
-      ++currentSplittedWordEnd; // So we could use the same code for result
-                                // emitting
+  for( list< sptr< Dictionary::WordSearchRequest > >::iterator i =
+         compoundSearches.begin(); i != compoundSearches.end(); )
+  {
+    if ( (*i)->isFinished() )
+    {
+      for( size_t count = (*i)->matchesCount(), x = 0; x < count; ++x )
+      {
+        std::map< wstring, vector< unsigned > >::const_iterator c =
+          compoundCandidatesByWriting.find( (**i)[ x ].word );
 
-      // Initiate new lookup
-      compoundSearchNextStep( false );
+        if ( c != compoundCandidatesByWriting.end() )
+        {
+          for( unsigned y = 0; y < c->second.size(); ++y )
+            compoundCandidateFound[ c->second[ y ] ] = true;
+        }
+      }
 
-      return;
+      compoundSearches.erase( i++ );
     }
+    else
+      ++i;
   }
 
-  // Build the compound sequence
+  if ( compoundSearches.empty() )
+    appendCompoundResults();
+}
 
-  currentSplittedWordCompound = makeSplittedWordCompound();
+void ArticleRequest::appendCompoundResults()
+{
+  int wordsCount = splittedWords.first.size();
 
-  // Look it up
+  // The compound found for each [start..end] range of words, if any
 
-//  DPRINTF( "Looking up %s\n", qPrintable( currentSplittedWordCompound ) );
+  vector< vector< bool > > found( wordsCount, vector< bool >( wordsCount, false ) );
 
-  stemmedWordFinder->expressionMatch( currentSplittedWordCompound, activeDicts, 40, // Would one be enough? Leave 40 to be safe.
-                                      Dictionary::SuitableForCompoundSearching );
-}
+  for( unsigned x = 0; x < compoundCandidates.size(); ++x )
+  {
+    if ( compoundCandidateFound[ x ] )
+      found[ compoundCandidates[ x ].first ][ compoundCandidates[ x ].second ] = true;
+  }
 
-QString ArticleRequest::makeSplittedWordCompound()
-{
-  QString result;
+  // Segment the phrase into the found compounds and the individual words
+  // between them, so that the compounds cover as many words as possible,
+  // being as long as possible. For each number of leading words, we keep the
+  // best segmentation of them -- the number of words covered by compounds,
+  // the number of segments and where the last segment starts.
 
-  result.clear();
+  vector< int > covered( wordsCount + 1, 0 ), segments( wordsCount + 1, 0 ),
+                lastStart( wordsCount + 1, 0 );
 
-  for( int x = currentSplittedWordStart; x <= currentSplittedWordEnd; ++x )
+  for( int end = 0; end < wordsCount; ++end )
   {
-    result.append( splittedWords.first[ x ] );
+    // A single word
+    covered[ end + 1 ] = covered[ end ];
+    segments[ end + 1 ] = segments[ end ] + 1;
+    lastStart[ end + 1 ] = end;
 
-    if ( x < currentSplittedWordEnd )
+    for( int start = 0; start < end; ++start )
     {
-      wstring ws( gd::toWString( splittedWords.second[ x + 1 ] ) );
+      if ( !found[ start ][ end ] )
+        continue;
 
-      Folding::normalizeWhitespace( ws );
+      int newCovered = covered[ start ] + end - start + 1;
+      int newSegments = segments[ start ] + 1;
 
-      result.append( gd::toQString( ws ) );
+      if ( newCovered > covered[ end + 1 ] ||
+           ( newCovered == covered[ end + 1 ] && newSegments < segments[ end + 1 ] ) )
+      {
+        covered[ end + 1 ] = newCovered;
+        segments[ end + 1 ] = newSegments;
+        lastStart[ end + 1 ] = start;
+      }
     }
   }
 
-  return result;
-}
-
-void ArticleRequest::individualWordFinished()
-{
-  WordFinder::SearchResults const & results = stemmedWordFinder->getResults();
+  list< QString > compounds;
 
-  if ( results.size() )
+  for( int end = wordsCount; end > 0; end = lastStart[ end ] )
   {
-    wstring source = Folding::applySimpleCaseOnly( gd::toWString( currentSplittedWordCompound ) );
+    if ( end - 1 > lastStart[ end ] )
+      compounds.push_front( makeSplittedWordCompound( lastStart[ end ], end - 1 ) );
+  }
+
+  string footer;
 
-    bool hadSomething = false;
+  if ( !compounds.empty() )
+  {
+    footer += "<div class=\"gdstemmedsuggestion\"><span class=\"gdstemmedsuggestion_head\">" +
+      Html::escape( tr( "Compound expressions: " ).toUtf8().data() ) +
+      "</span><span class=\"gdstemmedsuggestion_body\">";
 
-    for( unsigned x = 0; x < results.size(); ++x )
+    for( list< QString >::const_iterator i = compounds.begin(); i != compounds.end(); ++i )
     {
-      if ( results[ x ].second )
-      {
-        // Spelling suggestion match found. No need to continue.
-        hadSomething = true;
-        lastGoodCompoundResult = currentSplittedWordCompound;
-        break;
-      }
+      if ( i != compounds.begin() )
+        footer += " / ";
 
-      // Prefix match found. Check if the aliases are acceptable.
+      footer += linkWord( *i );
+    }
 
-      wstring result( Folding::applySimpleCaseOnly( gd::toWString( results[ x ].first ) ) );
+    footer += "</span>";
+  }
 
-      if ( source.size() <= result.size() && result.compare( 0, source.size(), source ) == 0 )
-      {
-        // The resulting string begins with the source one
+  // Now add links to all the individual words. They conclude the result.
 
-        hadSomething = true;
+  footer += "<div class=\"gdstemmedsuggestion\"><span class=\"gdstemmedsuggestion_head\">" +
+    Html::escape( tr( "Individual words: " ).toUtf8().data() ) +
+    "</span><span class=\"gdstemmedsuggestion_body\"";
+  if( splittedWords.first[ 0 ].isRightToLeft() )
+    footer += " dir=\"rtl\"";
+  footer += ">";
 
-        if ( source.size() == result.size() )
-        {
-          // Got the match. No need to continue.
-          lastGoodCompoundResult = currentSplittedWordCompound;
-          break;
-        }
-      }
-    }
+  footer += escapeSpacing( splittedWords.second[ 0 ] );
+
+  for( int x = 0; x < splittedWords.first.size(); ++x )
+  {
+    footer += linkWord( splittedWords.first[ x ] );
+    footer += escapeSpacing( splittedWords.second[ x + 1 ] );
+  }
+
+  footer += "</span>";
+
+  footer += "</body></html>";
+
+  appendToData( footer );
 
-    if ( hadSomething )
+  finish();
+}
+
+QString ArticleRequest::makeSplittedWordCompound( int start, int end )
+{
+  QString result;
+
+  for( int x = start; x <= end; ++x )
+  {
+    result.append( splittedWords.first[ x ] );
+
+    if ( x < end )
     {
-      compoundSearchNextStep( true );
-      return;
+      wstring ws( gd::toWString( splittedWords.second[ x + 1 ] ) );
+
+      Folding::normalizeWhitespace( ws );
+
+      result.append( gd::toQString( ws ) );
     }
   }
 
-  compoundSearchNextStep( false );
+  return result;
 }
 
 void ArticleRequest::appendToData( std::string const & str )
@@ -1127,10 +1631,17 @@ std::string ArticleRequest::escapeSpacing( QString const & str )
   return spacing.data();
 }
 
+void ArticleRequest::lookupFinished()
+{
+  trace->finish();
+}
+
 void ArticleRequest::cancel()
 {
     if( isFinished() )
         return;
+    if( trace.get() )
+        trace->finish( false );
     if( !altSearches.empty() )
     {
         for( list< sptr< Dictionary::WordSearchRequest > >::iterator i =
@@ -1141,12 +1652,22 @@ void ArticleRequest::cancel()
     }
     if( !bodyRequests.empty() )
     {
-        for( list< sptr< Dictionary::DataRequest > >::iterator i =
+        // Cancels the bodies unless other requests wait for them as well
+        for( list< BodyRequest >::iterator i =
                bodyRequests.begin(); i != bodyRequests.end(); ++i )
-        {
-            (*i)->cancel();
-        }
+            releaseBody( *i );
+        bodyRequests.clear();
+    }
+    for( list< sptr< Dictionary::WordSearchRequest > >::iterator i =
+           compoundSearches.begin(); i != compoundSearches.end(); ++i )
+    {
+        (*i)->cancel();
+    }
+    if( stemmedWordFinder.get() )
+    {
+        // Cancels the search unless other requests wait for it as well
+        stemmedSearches->release( stemmedWordFinder );
+        stemmedWordFinder.reset();
     }
-    if( stemmedWordFinder.get() ) stemmedWordFinder->cancel();
     finish();
 }
@@ -8,10 +8,51 @@
 #include <QMap>
 #include <set>
 #include <list>
+#include <map>
 #include "config.hh"
 #include "dictionary.hh"
 #include "instances.hh"
 #include "wordfinder.hh"
+#include "lookuptrace.hh"
+
+/// Shares the stemmed searches, which the article requests run when nothing
+/// was found, between the requests for the same word in the same set of
+/// dictionaries. A search still running is cancelled once no request needs
+/// it anymore. A few latest finished ones are kept, since the same word is
+/// often looked up again soon, e.g. in the popup or on going back.
+class StemmedSearches
+{
+public:
+
+  /// Returns the search for the given word in the given dictionaries,
+  /// starting it if there's none yet. It may be already finished.
+  sptr< WordFinder > acquire( QString const & word,
+                              std::vector< sptr< Dictionary::Class > > const & dicts );
+
+  /// Tells that the search acquired before is no longer needed by its user.
+  void release( sptr< WordFinder > const & );
+
+  /// Drops all the searches no one uses. Should be called when the
+  /// dictionaries get reloaded.
+  void clear();
+
+private:
+
+  enum
+  {
+    MaxFinishedSearches = 16
+  };
+
+  struct Search
+  {
+    QString key;
+    std::vector< sptr< Dictionary::Class > > dicts; // WordFinder refers to it
+    sptr< WordFinder > finder;
+    unsigned users;
+  };
+
+  std::list< Search > searches; // Most recently used first
+};
 
 /// This class generates the article's body for the given lookup request
 class ArticleMaker: public QObject
@@ -27,6 +68,16 @@ class ArticleMaker: public QObject
   bool collapseBigArticles;
   int articleLimitSize;
 
+  enum
+  {
+    /// The finished article requests kept for reuse
+    MaxFinishedArticles = 32
+  };
+
+  // Shared with the requests, which may outlive the maker
+  sptr< StemmedSearches > stemmedSearches;
+  sptr< Dictionary::SharedDataRequests > sharedArticles;
+
 public:
 
   /// On construction, a reference to all dictionaries and a reference all
@@ -79,6 +130,11 @@ public:
   /// Set collapse articles parameters
   void setCollapseParameters( bool autoCollapse, int articleSize );
 
+  /// Drops the articles and the results of the stemmed searches kept for
+  /// reuse. To be called when the dictionaries get reloaded.
+  void clearSharedRequests()
+  { stemmedSearches->clear(); sharedArticles->clear(); }
+
 private:
 
   /// Makes everything up to and including the opening body tag.
@@ -102,13 +158,30 @@ class ArticleRequest: public Dictionary::DataRequest
   std::vector< sptr< Dictionary::Class > > activeDicts;
   
   std::set< gd::wstring > alts; // Accumulated main forms
+  std::set< gd::wstring > requestedAlts; // Main forms the bodies were requested with
   std::list< sptr< Dictionary::WordSearchRequest > > altSearches;
   bool altsDone, bodyDone;
-  std::list< sptr< Dictionary::DataRequest > > bodyRequests;
+
+  /// The body requested from one dictionary. The 'extra' one looks up the
+  /// main forms which were only found after the 'main' one had been issued.
+  struct BodyRequest
+  {
+    unsigned dictIndex;
+    sptr< Dictionary::DataRequest > main, extra;
+    bool mainAppended, mainFound;
+    bool queried; // False if the word filter ruled the dictionary out, so
+                  // the lookup doesn't count in LookupStats
+  };
+
+  std::list< BodyRequest > bodyRequests;
   bool foundAnyDefinitions;
   bool closePrevSpan; // Indicates whether the last opened article span is to
                       // be closed after the article ends.
-  sptr< WordFinder > stemmedWordFinder; // Used when there're no results
+  sptr< StemmedSearches > stemmedSearches;
+  sptr< WordFinder > stemmedWordFinder; // Used when there're no results,
+                                        // acquired from stemmedSearches
+  sptr< Dictionary::SharedDataRequests > sharedArticles; // The bodies are
+                                                         // acquired from there
 
   /// A sequence of words and spacings between them, including the initial
   /// spacing before the first word and the final spacing after the last word.
@@ -119,23 +192,31 @@ class ArticleRequest: public Dictionary::DataRequest
   QPair< Words, Spacings > splitIntoWords( QString const & );
 
   QPair< Words, Spacings > splittedWords;
-  int currentSplittedWordStart;
-  int currentSplittedWordEnd;
-  QString currentSplittedWordCompound;
-  QString lastGoodCompoundResult;
-  bool firstCompoundWasFound;
+
+  /// Compound search state. The candidates are the [first..second] ranges of
+  /// splittedWords, each one looked up along with its alternate writings.
+  std::list< sptr< Dictionary::WordSearchRequest > > compoundSearches;
+  std::vector< QPair< int, int > > compoundCandidates;
+  std::vector< bool > compoundCandidateFound;
+  std::map< gd::wstring, std::vector< unsigned > > compoundCandidatesByWriting;
   int articleSizeLimit;
   bool needExpandOptionalParts;
   bool ignoreDiacritics;
+  sptr< LookupTrace::Lookup > trace; // Empty unless the lookups are recorded
 
 public:
 
   ArticleRequest( Config::InputPhrase const & phrase, QString const & group,
                   QMap< QString, QString > const & contexts,
                   std::vector< sptr< Dictionary::Class > > const & activeDicts,
+                  sptr< StemmedSearches > const &,
+                  sptr< Dictionary::SharedDataRequests > const & sharedArticles,
                   std::string const & header,
                   int sizeLimit, bool needExpandOptionalParts_,
-                  bool ignoreDiacritics = false );
+                  bool ignoreDiacritics = false,
+                  sptr< LookupTrace::Lookup > const & trace = sptr< LookupTrace::Lookup >() );
+
+  ~ArticleRequest();
 
   virtual void cancel();
 //  { finish(); } // Add our own requests cancellation here
@@ -145,19 +226,57 @@ private slots:
   void altSearchFinished();
   void bodyFinished();
   void stemmedSearchFinished();
-  void individualWordFinished();
+  void compoundSearchFinished();
+
+  /// Records the lookup in the trace
+  void lookupFinished();
 
 private:
 
   /// Appends the given string to 'data', with locking its mutex.
   void appendToData( std::string const & );
 
-  /// Uses stemmedWordFinder to perform the next step of looking up word
-  /// combinations.
-  void compoundSearchNextStep( bool lastSearchSucceeded );
-
-  /// Creates a single word out of the [currentSplittedWordStart..End] range.
-  QString makeSplittedWordCompound();
+  /// Takes the main forms from all finished synonym searches.
+  void collectAlts();
+
+  /// Requests the article from the given active dictionary, reusing the
+  /// identical request made by some other article request if there's one.
+  /// Returns an empty pointer on failure. Sets skipped if the dictionary
+  /// wasn't queried since it surely has none of the words, returning an
+  /// empty finished request then.
+  sptr< Dictionary::DataRequest > requestArticle( unsigned dictIndex,
+                                                  gd::wstring const & mainWord,
+                                                  std::vector< gd::wstring > const & alts,
+                                                  bool & skipped );
+
+  /// Releases the requests of the given body, which is no longer needed.
+  void releaseBody( BodyRequest & );
+
+  /// Makes everything of the article of the given dictionary up to and
+  /// including the opening tag of its body.
+  std::string makeArticleHead( unsigned dictIndex, Dictionary::DataRequest &,
+                               bool active );
+
+  /// Appends the article with the body of the given request to 'data',
+  /// closing the previous one. Returns true if anything was appended.
+  bool appendBody( unsigned dictIndex, Dictionary::DataRequest & );
+
+  /// Shows the body brought by the 'extra' request of the given body unless
+  /// the 'main' one had it already. Since the articles after it may have
+  /// been shown already, it's appended to its article, or its article is
+  /// inserted, by a script. Returns true if anything was shown.
+  bool applyExtraBody( BodyRequest & );
+
+  /// Looks up all the combinations of adjacent words in the dictionaries
+  /// suitable for compound searching.
+  void startCompoundSearch();
+
+  /// Splits the phrase into the longest compounds found and appends them
+  /// along with the individual words. Finishes the request.
+  void appendCompoundResults();
+
+  /// Creates a single word out of the [start..end] range of splittedWords.
+  QString makeSplittedWordCompound( int start, int end );
 
   /// Makes an html link to the given word.
   std::string linkWord( QString const & );
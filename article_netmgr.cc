@@ -202,6 +202,73 @@ using std::string;
 
 #endif
 
+// ArticleResourceCache
+
+ArticleResourceCache::ArticleResourceCache():
+  generation( 0 ), entries( MaxTotalSize ), requests( 0 )
+{
+}
+
+bool ArticleResourceCache::find( QByteArray const & key, vector< char > & data )
+{
+  Mutex::Lock _( mutex );
+
+  QByteArray const * entry = entries.object( key );
+
+  if ( !entry )
+    return false;
+
+  data.assign( entry->constData(), entry->constData() + entry->size() );
+
+  return true;
+}
+
+void ArticleResourceCache::insert( QByteArray const & key, vector< char > const & data )
+{
+  if ( data.size() > (size_t) MaxEntrySize )
+    return;
+
+  QByteArray * entry = new QByteArray( data.empty() ? 0 : &data.front(), data.size() );
+
+  Mutex::Lock _( mutex );
+
+  // QCache doesn't accept zero-cost objects as a way to bound their number
+  entries.insert( key, entry, entry->size() + 1 );
+}
+
+sptr< Dictionary::DataRequest > ArticleResourceCache::acquireRequest( QByteArray const & key )
+{
+  return requests.acquire( string( key.constData(), key.size() ) );
+}
+
+void ArticleResourceCache::addRequest( QByteArray const & key,
+                                       sptr< Dictionary::DataRequest > const & req )
+{
+  requests.add( string( key.constData(), key.size() ), req );
+}
+
+void ArticleResourceCache::releaseRequest( sptr< Dictionary::DataRequest > const & req )
+{
+  requests.release( req );
+}
+
+void ArticleResourceCache::clear()
+{
+  requests.clear();
+
+  Mutex::Lock _( mutex );
+
+  entries.clear();
+  ++generation;
+}
+
+unsigned ArticleResourceCache::getGeneration()
+{
+  Mutex::Lock _( mutex );
+
+  return generation;
+}
+
 namespace
 {
   /// Uses some heuristics to chop off the first domain name from the host name,
@@ -290,11 +357,13 @@ QNetworkReply * ArticleNetworkAccessManager::createRequest( Operation op,
 #endif
 
     QString contentType;
+    QByteArray cacheKey;
 
-    sptr< Dictionary::DataRequest > dr = getResource( req.url(), contentType );
+    sptr< Dictionary::DataRequest > dr = getResource( req.url(), contentType, &cacheKey );
 
     if ( dr.get() )
-      return new ArticleResourceReply( this, req, dr, contentType );
+      return new ArticleResourceReply( this, req, dr, contentType,
+                                       cacheKey.isEmpty() ? 0 : &resourceCache, cacheKey );
   }
 
   // Check the Referer. If the user has opted-in to block elements from external
@@ -369,7 +438,7 @@ QNetworkReply * ArticleNetworkAccessManager::createRequest( Operation op,
 }
 
 sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource(
-  QUrl const & url, QString & contentType )
+  QUrl const & url, QString & contentType, QByteArray * cacheKey )
 {
   GD_DPRINTF( "getResource: %ls\n", url.toString().toStdWString().c_str() );
   GD_DPRINTF( "scheme: %ls\n", url.scheme().toStdWString().c_str() );
@@ -447,6 +516,22 @@ sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource(
       for( unsigned x = 0; x < dictionaries.size(); ++x )
         if ( dictionaries[ x ]->getId() == id )
         {
+            // Video is streamed to an external player, and it's too large to
+            // be kept around anyway
+            bool cacheable = url.scheme() != "gdvideo";
+
+            QByteArray key;
+
+            if ( cacheable )
+            {
+              key = url.toEncoded( QUrl::RemoveQuery | QUrl::RemoveFragment );
+
+              sptr< Dictionary::DataRequestInstant > cached = new Dictionary::DataRequestInstant( true );
+
+              if ( resourceCache.find( key, cached->getData() ) )
+                return cached;
+            }
+
             if( url.scheme() == "gico" )
             {
                 QByteArray bytes;
@@ -457,11 +542,35 @@ sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource(
                 sptr< Dictionary::DataRequestInstant > ico = new Dictionary::DataRequestInstant( true );
                 ico->getData().resize( bytes.size() );
                 memcpy( &( ico->getData().front() ), bytes.data(), bytes.size() );
+                resourceCache.insert( key, ico->getData() );
                 return ico;
             }
+            bool shared = cacheable && cacheKey;
+
+            if ( shared )
+            {
+              // Some other article may be reading the same resource already
+              sptr< Dictionary::DataRequest > running = resourceCache.acquireRequest( key );
+
+              if ( running.get() )
+              {
+                *cacheKey = key;
+                return running;
+              }
+            }
+
             try
             {
-              return  dictionaries[ x ]->getResource( Qt4x5::Url::path( url ).mid( 1 ).toUtf8().data() );
+              sptr< Dictionary::DataRequest > dr =
+                dictionaries[ x ]->getResource( Qt4x5::Url::path( url ).mid( 1 ).toUtf8().data() );
+
+              if ( shared )
+              {
+                resourceCache.addRequest( key, dr );
+                *cacheKey = key;
+              }
+
+              return dr;
             }
             catch( std::exception & e )
             {
@@ -511,8 +620,11 @@ sptr< Dictionary::DataRequest > ArticleNetworkAccessManager::getResource(
 ArticleResourceReply::ArticleResourceReply( QObject * parent,
   QNetworkRequest const & netReq,
   sptr< Dictionary::DataRequest > const & req_,
-  QString const & contentType ):
-  QNetworkReply( parent ), req( req_ ), alreadyRead( 0 )
+  QString const & contentType,
+  ArticleResourceCache * cache_,
+  QByteArray const & cacheKey_ ):
+  QNetworkReply( parent ), req( req_ ), alreadyRead( 0 ),
+  cache( cache_ ), cacheKey( cacheKey_ ), storeWanted( cache_ != 0 )
 {
   setRequest( netReq );
 
@@ -521,6 +633,19 @@ ArticleResourceReply::ArticleResourceReply( QObject * parent,
   if ( contentType.size() )
     setHeader( QNetworkRequest::ContentTypeHeader, contentType );
 
+  QString scheme = netReq.url().scheme();
+
+  if ( scheme == "bres" || scheme == "gico" )
+  {
+    // The resources may change once the dictionaries are reloaded or
+    // edited, so the web engine has to ask for them each time. It's cheap,
+    // as they come from the resource cache then.
+    setRawHeader( "Cache-Control", "no-cache" );
+
+    if ( cache )
+      setRawHeader( "ETag", '"' + QByteArray::number( cache->getGeneration() ) + '"' );
+  }
+
   connect( req.get(), SIGNAL( updated() ),
            this, SLOT( reqUpdated() ) );
   
@@ -538,6 +663,7 @@ ArticleResourceReply::ArticleResourceReply( QObject * parent,
 
     if ( req->isFinished() )
     {
+      storeInCache();
       emit finishedSignal();
       GD_DPRINTF( "In-place finish.\n" );
     }
@@ -546,7 +672,11 @@ ArticleResourceReply::ArticleResourceReply( QObject * parent,
 
 ArticleResourceReply::~ArticleResourceReply()
 {
-  req->cancel();
+  // Other replies may be reading it as well
+  if ( cache )
+    cache->releaseRequest( req );
+  else
+    req->cancel();
 }
 
 void ArticleResourceReply::reqUpdated()
@@ -556,10 +686,28 @@ void ArticleResourceReply::reqUpdated()
 
 void ArticleResourceReply::reqFinished()
 {
+  storeInCache();
   emit readyRead();
   finishedSlot();
 }
 
+void ArticleResourceReply::storeInCache()
+{
+  if ( !storeWanted || req->dataSize() < 0 || !req->getErrorString().isEmpty() )
+    return;
+
+  try
+  {
+    cache->insert( cacheKey, req->getFullData() );
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "Can't cache resource: %s\n", e.what() );
+  }
+
+  storeWanted = false; // Store only once
+}
+
 qint64 ArticleResourceReply::bytesAvailable() const
 {
   qint64 avail = req->dataSize();
@@ -5,6 +5,7 @@
 #define __ARTICLE_NETMGR_HH_INCLUDED__
 
 #include <QtNetwork>
+#include <QCache>
 
 #if QT_VERSION >= 0x050300  // Qt 5.3+
 #include <QWebSecurityOrigin>
@@ -122,12 +123,68 @@ protected:
 };
 #endif
 
+/// A size-bounded cache of dictionary resources (stylesheets, pictures,
+/// sounds, icons), keyed by their urls. It is shared by all the article views,
+/// so the same resource referenced from several tabs or articles is only read
+/// and decompressed once. The least recently used entries are evicted first.
+class ArticleResourceCache
+{
+public:
+
+  /// The total size of the data cached, in bytes
+  enum { MaxTotalSize = 32 * 1024 * 1024 };
+  /// Larger resources aren't cached at all
+  enum { MaxEntrySize = 4 * 1024 * 1024 };
+
+  ArticleResourceCache();
+
+  /// Returns true and fills the data if the resource with the given key is
+  /// cached.
+  bool find( QByteArray const & key, vector< char > & data );
+
+  /// Stores the given resource data, unless it is too large.
+  void insert( QByteArray const & key, vector< char > const & data );
+
+  /// Returns the request still reading the resource with the given key, if
+  /// there's one, so that the same resource asked for by several articles at
+  /// once would only be read once. The request is to be released with
+  /// releaseRequest(). Unlike the rest, this is for the GUI thread only.
+  sptr< Dictionary::DataRequest > acquireRequest( QByteArray const & key );
+
+  /// Makes the request just issued for the given key available to
+  /// acquireRequest(). The caller is its first user.
+  void addRequest( QByteArray const & key, sptr< Dictionary::DataRequest > const & );
+
+  /// Tells that the request acquired or added before is no longer needed by
+  /// its user.
+  void releaseRequest( sptr< Dictionary::DataRequest > const & );
+
+  /// Drops all the cached data. Should be called whenever the dictionaries
+  /// are reloaded, since their resources may have changed.
+  void clear();
+
+  /// Returns the number of the times the cache was cleared. The replies
+  /// tell it as the version of the resources they bring.
+  unsigned getGeneration();
+
+private:
+
+  Mutex mutex;
+  unsigned generation;
+  QCache< QByteArray, QByteArray > entries;
+
+  // The finished ones are in the cache already, so only the running ones
+  // are shared
+  Dictionary::SharedDataRequests requests;
+};
+
 class ArticleNetworkAccessManager: public QNetworkAccessManager
 {
   vector< sptr< Dictionary::Class > > const & dictionaries;
   ArticleMaker const & articleMaker;
   bool const & disallowContentFromOtherSites;
   bool const & hideGoldenDictHeader;
+  ArticleResourceCache resourceCache;
 #if QT_VERSION >= 0x050300  // Qt 5.3+
   Origins allOrigins;
 #endif
@@ -149,8 +206,19 @@ public:
   /// If it succeeds, the result is a dictionary request object. Otherwise, an
   /// empty pointer is returned.
   /// The function can optionally set the Content-Type header correspondingly.
+  /// Dictionary resources are served from the resource cache when possible.
+  /// If the resource is cacheable but isn't cached yet, and cacheKey is
+  /// given, it receives the key to store the resource under once the request
+  /// finishes successfully. Such a request may be shared with the other
+  /// users reading the same resource, and is to be released with
+  /// ArticleResourceCache::releaseRequest() rather than cancelled.
   sptr< Dictionary::DataRequest > getResource( QUrl const & url,
-                                               QString & contentType );
+                                               QString & contentType,
+                                               QByteArray * cacheKey = 0 );
+
+  /// Returns the cache of dictionary resources.
+  ArticleResourceCache & getResourceCache()
+  { return resourceCache; }
 
 protected:
 
@@ -166,12 +234,21 @@ class ArticleResourceReply: public QNetworkReply
   sptr< Dictionary::DataRequest > req;
   qint64 alreadyRead;
 
+  ArticleResourceCache * cache;
+  QByteArray cacheKey;
+  bool storeWanted; // The data is yet to be put to the cache
+
 public:
 
+  /// If cache is passed, the data is put there under cacheKey once the
+  /// request finishes successfully, and the request is released to it
+  /// rather than cancelled on destruction.
   ArticleResourceReply( QObject * parent,
                         QNetworkRequest const &,
                         sptr< Dictionary::DataRequest > const &,
-                        QString const & contentType );
+                        QString const & contentType,
+                        ArticleResourceCache * cache = 0,
+                        QByteArray const & cacheKey = QByteArray() );
 
   ~ArticleResourceReply();
 
@@ -197,6 +274,11 @@ private slots:
   
   void readyReadSlot();
   void finishedSlot();
+
+private:
+
+  /// Stores the finished request's data in the resource cache, if needed.
+  void storeInCache();
 };
 
 class BlockedNetworkReply: public QNetworkReply
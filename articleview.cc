@@ -3,6 +3,9 @@
 
 #include "articleview.hh"
 #include <map>
+#include <algorithm>
+#include <QThreadPool>
+#include <QSemaphore>
 #include <QMessageBox>
 #include <QWebHitTestResult>
 #include <QMenu>
@@ -20,6 +23,7 @@
 #include <QCryptographicHash>
 #include "gestures.hh"
 #include "fulltextsearch.hh"
+#include "htmlescape.hh"
 
 #if QT_VERSION >= 0x040600
 #include <QWebElement>
@@ -96,15 +100,9 @@ public:
   /// Convert position into position in original text
   int mirrorPosition( int const & pos ) const
   {
-    int newPos = pos;
-    for( int x = 0; x < accentMarkPos.size(); x++ )
-    {
-      if( accentMarkPos.at( x ) < pos )
-        newPos++;
-      else
-        break;
-    }
-    return newPos;
+    // The marks positions are ascending
+    return pos + ( std::lower_bound( accentMarkPos.constBegin(), accentMarkPos.constEnd(), pos )
+                   - accentMarkPos.constBegin() );
   }
 };
 
@@ -176,6 +174,195 @@ public:
 
 /// End of DiacriticsHandler class
 
+class FtsHighlightRequestRunnable: public QRunnable
+{
+  FtsHighlightRequest & r;
+  QSemaphore & hasExited;
+
+public:
+
+  FtsHighlightRequestRunnable( FtsHighlightRequest & r_,
+                               QSemaphore & hasExited_ ): r( r_ ),
+                                                          hasExited( hasExited_ )
+  {}
+
+  ~FtsHighlightRequestRunnable()
+  {
+    hasExited.release();
+  }
+
+  virtual void run();
+};
+
+/// Finds the matches of the full-text search expression in the page text
+/// off the GUI thread. The page text is the concatenation of its text nodes,
+/// so the matches can be highlighted right in them.
+class FtsHighlightRequest: public Dictionary::Request
+{
+  QString text, regString;
+  bool wildcards, matchCase, ignoreDiacritics;
+
+  QStringList matches;
+  QVector< int > ranges;
+
+  QAtomicInt isCancelled;
+  QSemaphore hasExited;
+
+public:
+
+  FtsHighlightRequest( QString const & text_, QString const & regString_,
+                       bool wildcards_, bool matchCase_, bool ignoreDiacritics_ ):
+    text( text_ ), regString( regString_ ), wildcards( wildcards_ ),
+    matchCase( matchCase_ ), ignoreDiacritics( ignoreDiacritics_ )
+  {
+    QThreadPool::globalInstance()->start(
+      new FtsHighlightRequestRunnable( *this, hasExited ) );
+  }
+
+  void run(); // Run from another thread by FtsHighlightRequestRunnable
+
+  /// The matched strings, in the order of the text. Only valid once the
+  /// request is finished.
+  QStringList const & getMatches() const
+  { return matches; }
+
+  /// Positions and lengths of the matches in the text, in pairs.
+  QVector< int > const & getRanges() const
+  { return ranges; }
+
+  virtual void cancel()
+  {
+    isCancelled.ref();
+  }
+
+  ~FtsHighlightRequest()
+  {
+    isCancelled.ref();
+    hasExited.acquire();
+  }
+};
+
+void FtsHighlightRequestRunnable::run()
+{
+  r.run();
+}
+
+void FtsHighlightRequest::run()
+{
+  if ( Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
+  {
+    finish();
+    return;
+  }
+
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
+  QRegularExpression regexp;
+  if( wildcards )
+    regexp.setPattern( wildcardsToRegexp( regString ) );
+  else
+    regexp.setPattern( regString );
+
+  QRegularExpression::PatternOptions patternOptions = QRegularExpression::DotMatchesEverythingOption
+                                                      | QRegularExpression::UseUnicodePropertiesOption
+                                                      | QRegularExpression::MultilineOption
+                                                      | QRegularExpression::InvertedGreedinessOption;
+  if( !matchCase )
+    patternOptions |= QRegularExpression::CaseInsensitiveOption;
+  regexp.setPatternOptions( patternOptions );
+
+  if( regexp.pattern().isEmpty() || !regexp.isValid() )
+  {
+    setErrorString( "Invalid search expression" );
+    finish();
+    return;
+  }
+#else
+  QRegExp regexp( regString,
+                  matchCase ? Qt::CaseSensitive : Qt::CaseInsensitive,
+                  wildcards ? QRegExp::WildcardUnix : QRegExp::RegExp2 );
+
+  if( regexp.pattern().isEmpty() )
+  {
+    setErrorString( "Invalid search expression" );
+    finish();
+    return;
+  }
+
+  regexp.setMinimal( true );
+#endif
+
+  sptr< AccentMarkHandler > marksHandler = ignoreDiacritics ?
+                                           new DiacriticsHandler : new AccentMarkHandler;
+
+  marksHandler->setText( text );
+
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
+  QRegularExpressionMatchIterator it = regexp.globalMatch( marksHandler->normalizedText() );
+  while( it.hasNext() && !Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
+  {
+    QRegularExpressionMatch match = it.next();
+
+    // Mirror pos and matched length to original string
+    int pos = match.capturedStart();
+    int spos = marksHandler->mirrorPosition( pos );
+    int matched = marksHandler->mirrorPosition( pos + match.capturedLength() ) - spos;
+
+    // Add mark pos (if presented)
+    while( spos + matched < text.length()
+           && text[ spos + matched ].category() == QChar::Mark_NonSpacing )
+      matched++;
+
+    if( matched > FTS::MaxMatchLengthForHighlightResults )
+    {
+      gdWarning( "ArticleView::highlightFTSResults(): Too long match - skipped (matched length %i, allowed %i)",
+                 match.capturedLength(), FTS::MaxMatchLengthForHighlightResults );
+    }
+    else
+    if( matched > 0 )
+    {
+      matches.append( text.mid( spos, matched ) );
+      ranges.append( spos );
+      ranges.append( matched );
+    }
+  }
+#else
+  int pos = 0;
+
+  while( pos >= 0 && !Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
+  {
+    pos = regexp.indexIn( marksHandler->normalizedText(), pos );
+    if( pos >= 0 )
+    {
+      // Mirror pos and matched length to original string
+      int spos = marksHandler->mirrorPosition( pos );
+      int matched = marksHandler->mirrorPosition( pos + regexp.matchedLength() ) - spos;
+
+      // Add mark pos (if presented)
+      while( spos + matched < text.length()
+             && text[ spos + matched ].category() == QChar::Mark_NonSpacing )
+        matched++;
+
+      if( matched > FTS::MaxMatchLengthForHighlightResults )
+      {
+        gdWarning( "ArticleView::highlightFTSResults(): Too long match - skipped (matched length %i, allowed %i)",
+                   regexp.matchedLength(), FTS::MaxMatchLengthForHighlightResults );
+      }
+      else
+      if( matched > 0 )
+      {
+        matches.append( text.mid( spos, matched ) );
+        ranges.append( spos );
+        ranges.append( matched );
+      }
+
+      pos += regexp.matchedLength() > 0 ? regexp.matchedLength() : 1;
+    }
+  }
+#endif
+
+  finish();
+}
+
 static QVariant evaluateJavaScriptVariableSafe( QWebFrame * frame, const QString & variable )
 {
   return frame->evaluateJavaScript(
@@ -207,6 +394,12 @@ QString scrollToFromUrl( QUrl const & url )
   return QString();
 }
 
+/// Walks the text nodes of the page, apart from the ones of scripts and styles
+char const * const pageTextWalker =
+  "document.createTreeWalker( document.body, NodeFilter.SHOW_TEXT, function( n ) {"
+  "var p = n.parentNode.nodeName;"
+  "return p == 'SCRIPT' || p == 'STYLE' ? NodeFilter.FILTER_REJECT : NodeFilter.FILTER_ACCEPT; }, false )";
+
 } // unnamed namespace
 
 QString ArticleView::scrollToFromDictionaryId( QString const & dictionaryId )
@@ -244,7 +437,9 @@ ArticleView::ArticleView( QWidget * parent, ArticleNetworkAccessManager & nm,
   groupComboBox( groupComboBox_ ),
   ftsSearchIsOpened( false ),
   ftsSearchMatchCase( false ),
-  ftsPosition( 0 )
+  ftsPosition( 0 ),
+  hibernated( false ),
+  hiddenSince( QDateTime::currentDateTime() )
 {
   ui.setupUi( this );
 
@@ -277,6 +472,9 @@ ArticleView::ArticleView( QWidget * parent, ArticleNetworkAccessManager & nm,
   connect( ui.definition, SIGNAL( loadFinished( bool ) ),
            this, SLOT( loadFinished( bool ) ) );
 
+  connect( ui.definition, SIGNAL( loadStarted() ),
+           this, SLOT( cancelArticlePatch() ) );
+
   attachToJavaScript();
   connect( ui.definition->page()->mainFrame(), SIGNAL( javaScriptWindowObjectCleared() ),
            this, SLOT( attachToJavaScript() ) );
@@ -394,6 +592,9 @@ void ArticleView::showDefinition( Config::InputPhrase const & phrase, unsigned g
                                   QString const & scrollTo,
                                   Contexts const & contexts_ )
 {
+  // Keep the history of the released page
+  wakeUp();
+
   // first, let's stop the player
   audioPlayer->stop();
 
@@ -468,6 +669,8 @@ void ArticleView::showDefinition( QString const & word, QStringList const & dict
                                   QRegExp const & searchRegExp, unsigned group,
                                   bool ignoreDiacritics )
 {
+  wakeUp();
+
   if( dictIDs.isEmpty() )
     return;
 
@@ -509,6 +712,8 @@ void ArticleView::showDefinition( QString const & word, QStringList const & dict
 
 void ArticleView::showAnticipation()
 {
+  wakeUp();
+
   ui.definition->setHtml( "" );
   ui.definition->setCursor( Qt::WaitCursor );
   //QApplication::setOverrideCursor( Qt::WaitCursor );
@@ -516,6 +721,9 @@ void ArticleView::showAnticipation()
 
 void ArticleView::loadFinished( bool )
 {
+  if ( hibernated )
+    return; // That's the blank page which replaced the released one
+
   QUrl url = ui.definition->url();
 
   // See if we have any iframes in need of expansion
@@ -680,6 +888,9 @@ void ArticleView::handleTitleChanged( QString const & title )
 
 void ArticleView::handleUrlChanged( QUrl const & url )
 {
+  if ( hibernated )
+    return; // Keep the icon of the released page
+
   QIcon icon;
 
   unsigned group = getGroup( url );
@@ -1184,6 +1395,8 @@ bool ArticleView::openLink( QUrl const & url, QUrl const & ref,
                             QString const & scrollTo,
                             Contexts const & contexts_ )
 {
+  wakeUp();
+
   qDebug() << "clicked" << url;
 
   Contexts contexts( contexts_ );
@@ -1644,11 +1857,18 @@ void ArticleView::updateMutedContents()
   {
     // The list has changed -- update the url
 
+    QStringList oldMuted = Qt4x5::Url::queryItemValue( currentUrl, "muted" )
+                             .split( ',', QString::SkipEmptyParts );
+
     Qt4x5::Url::removeQueryItem( currentUrl, "muted" );
 
     if ( mutedDicts.size() )
     Qt4x5::Url::addQueryItem( currentUrl, "muted", mutedDicts );
 
+    if ( patchMutedContents( currentUrl, group, oldMuted,
+                             mutedDicts.split( ',', QString::SkipEmptyParts ) ) )
+      return;
+
     saveHistoryUserData();
 
     ui.definition->load( currentUrl );
@@ -1658,6 +1878,160 @@ void ArticleView::updateMutedContents()
   }
 }
 
+bool ArticleView::patchMutedContents( QUrl const & newUrl, unsigned group,
+                                      QStringList const & oldMuted,
+                                      QStringList const & newMuted )
+{
+  if ( articlePatchRequest.get() )
+  {
+    // The page isn't in sync with its url yet
+    cancelArticlePatch();
+    return false;
+  }
+
+  QWebFrame * frame = ui.definition->page()->mainFrame();
+
+  if ( Qt4x5::Url::hasQueryItem( newUrl, "dictionaries" ) ||
+       frame->evaluateJavaScript( "document.readyState" ).toString() != "complete" ||
+       frame->evaluateJavaScript( "document.getElementsByClassName( 'gdstemmedsuggestion' ).length" ).toInt() )
+    return false;
+
+  Instances::Group const * groupInstance = groups.findGroup( group );
+
+  if ( !groupInstance )
+    return false;
+
+  QStringList shown = getArticlesList();
+
+  bool anyLeft = false;
+
+  for( int x = 0; x < shown.size(); ++x )
+    if ( !newMuted.contains( shown[ x ] ) )
+    {
+      anyLeft = true;
+      break;
+    }
+
+  // Without any articles the page has to tell nothing was found
+  if ( !anyLeft )
+    return false;
+
+  QStringList added;
+
+  for( int x = 0; x < oldMuted.size(); ++x )
+    if ( !newMuted.contains( oldMuted[ x ] ) )
+      added.append( oldMuted[ x ] );
+
+  // Switch the page to the new url without loading it
+  frame->evaluateJavaScript( QString( "history.replaceState( history.state, document.title, '%1' );" )
+                             .arg( Html::escapeForJavaScript( newUrl.toEncoded().data() ).c_str() ) );
+
+  if ( ui.definition->url() != newUrl )
+    return false;
+
+  for( int x = 0; x < newMuted.size(); ++x )
+    if ( !oldMuted.contains( newMuted[ x ] ) && shown.contains( newMuted[ x ] ) )
+      frame->evaluateJavaScript( QString( "gdRemoveArticle( '%1' );" ).arg( newMuted[ x ] ) );
+
+  if ( added.isEmpty() )
+    return true;
+
+  // Request the articles of the unmuted dictionaries only
+
+  articlePatchOrder.clear();
+
+  QStringList othersMuted;
+
+  for( unsigned x = 0; x < groupInstance->dictionaries.size(); ++x )
+  {
+    QString id = QString::fromStdString( groupInstance->dictionaries[ x ]->getId() );
+
+    articlePatchOrder.append( id );
+
+    if ( !added.contains( id ) )
+      othersMuted.append( id );
+  }
+
+  QUrl req = newUrl;
+
+  Qt4x5::Url::removeQueryItem( req, "muted" );
+  Qt4x5::Url::addQueryItem( req, "muted", othersMuted.join( "," ) );
+
+  QString contentType;
+
+  articlePatchRequest = articleNetMgr.getResource( req, contentType );
+
+  if ( !articlePatchRequest.get() )
+    return false;
+
+  articlePatchUrl = newUrl;
+
+  if ( articlePatchRequest->isFinished() )
+    articlePatchFinished();
+  else
+    connect( articlePatchRequest.get(), SIGNAL( finished() ),
+             this, SLOT( articlePatchFinished() ) );
+
+  return true;
+}
+
+void ArticleView::articlePatchFinished()
+{
+  if ( !articlePatchRequest.get() || !articlePatchRequest->isFinished() )
+    return;
+
+  sptr< Dictionary::DataRequest > req = articlePatchRequest;
+
+  articlePatchRequest.reset();
+
+  // The view may have moved on meanwhile
+  if ( ui.definition->url() != articlePatchUrl )
+    return;
+
+  QString html;
+
+  if ( req->dataSize() > 0 )
+  {
+    std::vector< char > & data = req->getFullData();
+    html = QString::fromUtf8( &data.front(), data.size() );
+  }
+
+  int bodyPos = html.indexOf( "<body>" );
+
+  // The header scripts mention the markup as well, so only the body is
+  // looked at
+  QString body = bodyPos < 0 ? QString() : html.mid( bodyPos + 6 );
+
+  if ( bodyPos < 0 || body.contains( "id=\"gdexpandframe-" ) ||
+       body.contains( "class=\"gdstemmedsuggestion\"" ) )
+  {
+    // Framed and suggested contents need the page to be loaded as a whole
+    saveHistoryUserData();
+
+    ui.definition->load( articlePatchUrl );
+    ui.definition->setCursor( Qt::WaitCursor );
+    return;
+  }
+
+  if ( body.indexOf( QRegExp( "<div class=\"gdarticle[ \"]" ) ) < 0 )
+    return; // Nothing was found in them
+
+  html = QString::fromUtf8( Html::escapeForJavaScript( body.toUtf8().data() ).c_str() );
+  html.replace( QChar( 0x2028 ), "\\u2028" ).replace( QChar( 0x2029 ), "\\u2029" );
+
+  ui.definition->page()->mainFrame()->evaluateJavaScript(
+    QString( "gdInsertArticles( '%1', [ '%2' ] );" ).arg( html, articlePatchOrder.join( "', '" ) ) );
+}
+
+void ArticleView::cancelArticlePatch()
+{
+  if ( articlePatchRequest.get() )
+  {
+    articlePatchRequest->cancel();
+    articlePatchRequest.reset();
+  }
+}
+
 bool ArticleView::canGoBack()
 {
   // First entry in a history is always an empty page,
@@ -2519,6 +2893,13 @@ bool ArticleView::closeSearch()
 
     ui.definition->findText( "", flags );
 
+    // Remove the highlighting of the matches
+    ui.definition->page()->currentFrame()->evaluateJavaScript(
+      "(function() { var h = document.getElementsByClassName( 'gdftshighlight' );"
+      "while ( h.length ) { var e = h[ 0 ]; var p = e.parentNode;"
+      "while ( e.firstChild ) p.insertBefore( e.firstChild, e );"
+      "p.removeChild( e ); p.normalize(); } })();_=0;" );
+
     return true;
   }
   else
@@ -2539,6 +2920,64 @@ void ArticleView::showEvent( QShowEvent * ev )
 
   if( !ftsSearchIsOpened )
     ui.ftsSearchFrame->hide();
+
+  hiddenSince = QDateTime();
+
+  wakeUp();
+}
+
+void ArticleView::wakeUp()
+{
+  if ( !hibernated )
+    return;
+
+  // Restoring the history loads its current item, and loadFinished() puts
+  // the scroll position back
+  hibernated = false;
+
+  QDataStream in( hibernatedHistory );
+  in >> *ui.definition->history();
+
+  hibernatedHistory.clear();
+
+  ui.definition->setCursor( Qt::WaitCursor );
+}
+
+void ArticleView::hideEvent( QHideEvent * ev )
+{
+  QFrame::hideEvent( ev );
+
+  hiddenSince = QDateTime::currentDateTime();
+}
+
+int ArticleView::secondsHidden() const
+{
+  if ( isVisible() || !hiddenSince.isValid() )
+    return -1;
+
+  return hiddenSince.secsTo( QDateTime::currentDateTime() );
+}
+
+void ArticleView::hibernate()
+{
+  if ( hibernated || isVisible() || ui.definition->url().isEmpty() )
+    return;
+
+  saveHistoryUserData();
+
+  hibernatedHistory.clear();
+
+  QDataStream out( &hibernatedHistory, QIODevice::WriteOnly );
+  out << *ui.definition->history();
+
+  hibernated = true;
+
+  cancelArticlePatch();
+  ftsHighlightRequest.reset();
+
+  // Drop the page along with its history
+  ui.definition->setHtml( QString() );
+  ui.definition->history()->clear();
 }
 
 void ArticleView::receiveExpandOptionalParts( bool expand )
@@ -2593,38 +3032,9 @@ void ArticleView::highlightFTSResults()
   else
     regString = regString.remove( AccentMarkHandler::accentMark() );
 
-#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
-  QRegularExpression regexp;
-  if( Qt4x5::Url::hasQueryItem( url, "wildcards" ) )
-    regexp.setPattern( wildcardsToRegexp( regString ) );
-  else
-    regexp.setPattern( regString );
-
-  QRegularExpression::PatternOptions patternOptions = QRegularExpression::DotMatchesEverythingOption
-                                                      | QRegularExpression::UseUnicodePropertiesOption
-                                                      | QRegularExpression::MultilineOption
-                                                      | QRegularExpression::InvertedGreedinessOption;
-  if( !Qt4x5::Url::hasQueryItem( url, "matchcase" ) )
-    patternOptions |= QRegularExpression::CaseInsensitiveOption;
-  regexp.setPatternOptions( patternOptions );
-
-  if( regexp.pattern().isEmpty() || !regexp.isValid() )
-    return;
-#else
-  QRegExp regexp( regString,
-                  Qt4x5::Url::hasQueryItem( url, "matchcase" ) ? Qt::CaseSensitive : Qt::CaseInsensitive,
-                  Qt4x5::Url::hasQueryItem( url, "wildcards" ) ? QRegExp::WildcardUnix : QRegExp::RegExp2 );
-
-
-  if( regexp.pattern().isEmpty() )
+  if( regString.isEmpty() )
     return;
 
-  regexp.setMinimal( true );
-#endif
-
-  sptr< AccentMarkHandler > marksHandler = ignoreDiacritics ?
-                                           new DiacriticsHandler : new AccentMarkHandler;
-
   // Clear any current selection
   if ( ui.definition->selectedText().size() )
   {
@@ -2632,79 +3042,73 @@ void ArticleView::highlightFTSResults()
            evaluateJavaScript( "window.getSelection().removeAllRanges();_=0;" );
   }
 
-  QString pageText = ui.definition->page()->currentFrame()->toPlainText();
-  marksHandler->setText( pageText );
+  QString pageText = ui.definition->page()->currentFrame()->
+                     evaluateJavaScript( QString( "(function() { var w = %1; var t = []; var n;"
+                                                  "while ( ( n = w.nextNode() ) ) t.push( n.nodeValue );"
+                                                  "return t.join( '' ); })();" ).arg( pageTextWalker ) ).toString();
 
-#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
-  QRegularExpressionMatchIterator it = regexp.globalMatch( marksHandler->normalizedText() );
-  while( it.hasNext() )
-  {
-    QRegularExpressionMatch match = it.next();
+  ftsSearchMatchCase = Qt4x5::Url::hasQueryItem( url, "matchcase" );
 
-    // Mirror pos and matched length to original string
-    int pos = match.capturedStart();
-    int spos = marksHandler->mirrorPosition( pos );
-    int matched = marksHandler->mirrorPosition( pos + match.capturedLength() ) - spos;
+  // The matches are looked for off the GUI thread, since the pages can be
+  // large
+  ftsHighlightUrl = url;
+  ftsHighlightRequest = new FtsHighlightRequest( pageText, regString,
+                                                 Qt4x5::Url::hasQueryItem( url, "wildcards" ),
+                                                 ftsSearchMatchCase, ignoreDiacritics );
 
-    // Add mark pos (if presented)
-    while( spos + matched < pageText.length()
-           && pageText[ spos + matched ].category() == QChar::Mark_NonSpacing )
-      matched++;
+  connect( ftsHighlightRequest.get(), SIGNAL( finished() ),
+           this, SLOT( ftsHighlightFinished() ), Qt::QueuedConnection );
 
-    if( matched > FTS::MaxMatchLengthForHighlightResults )
-    {
-      gdWarning( "ArticleView::highlightFTSResults(): Too long match - skipped (matched length %i, allowed %i)",
-                 match.capturedLength(), FTS::MaxMatchLengthForHighlightResults );
-    }
-    else
-      allMatches.append( pageText.mid( spos, matched ) );
-  }
-#else
-  int pos = 0;
+  if ( ftsHighlightRequest->isFinished() )
+    ftsHighlightFinished();
+}
+
+void ArticleView::ftsHighlightFinished()
+{
+  if ( !ftsHighlightRequest.get() || !ftsHighlightRequest->isFinished() )
+    return;
+
+  sptr< FtsHighlightRequest > req = ftsHighlightRequest;
+
+  ftsHighlightRequest.reset();
+
+  if ( ui.definition->url() != ftsHighlightUrl || req->getErrorString().size() )
+    return;
 
-  while( pos >= 0 )
+  allMatches = req->getMatches();
+
+  // Highlight all the matches at once, splitting the text nodes they are in
+  QVector< int > const & ranges = req->getRanges();
+
+  if ( !ranges.isEmpty() )
   {
-    pos = regexp.indexIn( marksHandler->normalizedText(), pos );
-    if( pos >= 0 )
-    {
-      // Mirror pos and matched length to original string
-      int spos = marksHandler->mirrorPosition( pos );
-      int matched = marksHandler->mirrorPosition( pos + regexp.matchedLength() ) - spos;
+    QStringList list;
 
-      // Add mark pos (if presented)
-      while( spos + matched < pageText.length()
-             && pageText[ spos + matched ].category() == QChar::Mark_NonSpacing )
-        matched++;
+    list.reserve( ranges.size() );
 
-      if( matched > FTS::MaxMatchLengthForHighlightResults )
-      {
-        gdWarning( "ArticleView::highlightFTSResults(): Too long match - skipped (matched length %i, allowed %i)",
-                   regexp.matchedLength(), FTS::MaxMatchLengthForHighlightResults );
-      }
-      else
-        allMatches.append( pageText.mid( spos, matched ) );
+    for( int x = 0; x < ranges.size(); ++x )
+      list.append( QString::number( ranges[ x ] ) );
 
-      pos += regexp.matchedLength();
-    }
+    ui.definition->page()->currentFrame()->evaluateJavaScript(
+      QString( "(function( r ) { var w = %1; var nodes = []; var starts = []; var pos = 0; var n;"
+               "while ( ( n = w.nextNode() ) ) { nodes.push( n ); starts.push( pos ); pos += n.nodeValue.length; }"
+               // Going backwards keeps the positions of the matches left valid
+               "var k = nodes.length - 1;"
+               "for ( var i = r.length - 2; i >= 0; i -= 2 ) { var s = r[ i ]; var e = s + r[ i + 1 ];"
+               "while ( k >= 0 && starts[ k ] >= e ) k--;"
+               "for ( var j = k; j >= 0 && starts[ j ] + nodes[ j ].nodeValue.length > s; j-- ) {"
+               "var a = Math.max( s - starts[ j ], 0 ); var b = Math.min( e - starts[ j ], nodes[ j ].nodeValue.length );"
+               "var m = nodes[ j ].splitText( a ); m.splitText( b - a );"
+               "var h = document.createElement( 'span' ); h.className = 'gdftshighlight';"
+               "m.parentNode.replaceChild( h, m ); h.appendChild( m ); } } })( [ %2 ] );_=0;" )
+      .arg( pageTextWalker, list.join( "," ) ) );
   }
-#endif
-
-  ftsSearchMatchCase = Qt4x5::Url::hasQueryItem( url, "matchcase" );
 
   QWebPage::FindFlags flags ( 0 );
 
   if( ftsSearchMatchCase )
     flags |= QWebPage::FindCaseSensitively;
 
-#if QT_VERSION >= 0x040600
-  flags |= QWebPage::HighlightAllOccurrences;
-
-  for( int x = 0; x < allMatches.size(); x++ )
-    ui.definition->findText( allMatches.at( x ), flags );
-
-  flags &= ~QWebPage::HighlightAllOccurrences;
-#endif
-
   if( !allMatches.isEmpty() )
   {
     if( ui.definition->findText( allMatches.at( 0 ), flags ) )
@@ -8,6 +8,7 @@
 #include <QMap>
 #include <QUrl>
 #include <QSet>
+#include <QDateTime>
 #include <list>
 #include "article_netmgr.hh"
 #include "audioplayerinterface.hh"
@@ -16,6 +17,7 @@
 #include "ui_articleview.h"
 
 class ResourceToSaveHandler;
+class FtsHighlightRequest;
 
 /// A widget with the web view tailored to view and handle articles -- it
 /// uses the appropriate netmgr, handles link clicks, rmb clicks etc
@@ -48,6 +50,14 @@ class ArticleView: public QFrame
   /// Url of the resourceDownloadRequests
   QUrl resourceDownloadUrl;
 
+  /// The articles of the dictionaries just unmuted, to be inserted into the
+  /// page in place instead of reloading it.
+  sptr< Dictionary::DataRequest > articlePatchRequest;
+  /// Url of the page the articlePatchRequest is for
+  QUrl articlePatchUrl;
+  /// Ids of the group's dictionaries, in the order of their articles
+  QStringList articlePatchOrder;
+
   /// For resources opened via desktop services
   QSet< QString > desktopOpenedTempFiles;
 
@@ -60,6 +70,18 @@ class ArticleView: public QFrame
   bool ftsSearchIsOpened, ftsSearchMatchCase;
   int ftsPosition;
 
+  /// Looks for the matches to highlight in the page text
+  sptr< FtsHighlightRequest > ftsHighlightRequest;
+  /// Url of the page the ftsHighlightRequest is for
+  QUrl ftsHighlightUrl;
+
+  /// Set when the page was released by hibernate(). The history, which has
+  /// the url and the scroll position, is kept serialized to restore it.
+  bool hibernated;
+  QByteArray hibernatedHistory;
+  /// When the view got hidden, invalid if it's visible
+  QDateTime hiddenSince;
+
   void highlightFTSResults();
   void performFtsFindOperation( bool backwards );
   void showFindButtons();
@@ -154,7 +176,18 @@ public:
 
   /// Reloads the view
   void reload()
-  { ui.definition->reload(); }
+  { if ( !hibernated ) ui.definition->reload(); }
+
+  /// Releases the page of a hidden view, keeping only its history. The page
+  /// is brought back when the view gets shown again.
+  void hibernate();
+
+  bool isHibernated() const
+  { return hibernated; }
+
+  /// Returns the number of seconds the view has been hidden for, or -1 if
+  /// it's shown.
+  int secondsHidden() const;
 
   /// Returns true if there's an audio reference on the page, false otherwise.
   bool hasSound();
@@ -285,6 +318,15 @@ private slots:
   /// Returns false if all requests are finished and none has any data; true otherwise.
   bool resourceDownloadFinished();
 
+  /// Inserts the articles brought by articlePatchRequest into the page.
+  void articlePatchFinished();
+
+  /// Highlights the matches found by ftsHighlightRequest.
+  void ftsHighlightFinished();
+
+  /// Drops the pending articlePatchRequest, if any.
+  void cancelArticlePatch();
+
   /// We handle pasting by attempting to define the word in clipboard.
   void pasteTriggered();
 
@@ -362,15 +404,28 @@ private:
 
   void reloadStyleSheet();
 
+  /// Brings back the page released by hibernate(), if it was.
+  void wakeUp();
+
   /// Returns the comma-separated list of dictionary ids which should be muted
   /// for the given group. If there are none, returns empty string.
   QString getMutedForGroup( unsigned group );
 
+  /// Brings the page to the newly muted dictionaries in place: the articles
+  /// of the muted ones are removed, and the ones of the unmuted are requested
+  /// and inserted once they arrive. Returns false if the page has to be
+  /// reloaded instead.
+  bool patchMutedContents( QUrl const & newUrl, unsigned group,
+                           QStringList const & oldMuted,
+                           QStringList const & newMuted );
+
 protected:
 
   // We need this to hide the search bar when we're showed
   void showEvent( QShowEvent * );
 
+  void hideEvent( QHideEvent * );
+
 #ifdef Q_OS_WIN32
 
   /// Search inside web page for word under cursor
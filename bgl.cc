@@ -3,6 +3,7 @@
 
 #include "bgl.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "bgl_babylon.hh"
 #include "file.hh"
 #include "folding.hh"
@@ -756,19 +757,10 @@ void BglArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   static Language::Id hebrew = LangCoder::code2toInt( "he" ); // Hebrew support
 
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
-
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
   set< uint32_t > articlesIncluded; // Some synonims make it that the articles
@@ -1245,6 +1237,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
     if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
          indexIsOldOrBad( indexFile ) )
     {
+      IndexingStats::EndOfBuild endOfBuild;
+
       // Building the index
 
       gdDebug( "Bgl: Building the index for dictionary: %s\n", i->c_str() );
@@ -0,0 +1,91 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "bloomfilter.hh"
+
+namespace {
+
+/// Ten bits and seven hashes per string give about one percent of false
+/// positives
+enum
+{
+  BitsPerItem = 10,
+  HashesPerItem = 7
+};
+
+}
+
+BloomFilter::BloomFilter(): hashes( 0 )
+{
+}
+
+BloomFilter::BloomFilter( size_t expectedItems ): hashes( HashesPerItem )
+{
+  size_t bitCount = expectedItems * BitsPerItem;
+
+  if ( bitCount < 64 )
+    bitCount = 64;
+
+  bits.resize( ( bitCount + 31 ) / 32 );
+}
+
+BloomFilter::BloomFilter( std::vector< uint32_t > const & bits_, uint32_t hashes_ ):
+  bits( bits_ ), hashes( hashes_ )
+{
+}
+
+void BloomFilter::hash( std::string const & str, uint32_t & h1, uint32_t & h2 )
+{
+  // 64-bit FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+
+  for( size_t x = 0; x < str.size(); ++x )
+  {
+    h ^= (unsigned char) str[ x ];
+    h *= 1099511628211ULL;
+  }
+
+  h1 = (uint32_t) h;
+  h2 = (uint32_t)( h >> 32 ) | 1; // Never zero, so the hashes differ
+}
+
+void BloomFilter::add( std::string const & str )
+{
+  if ( bits.empty() )
+    return;
+
+  uint32_t h1, h2;
+
+  hash( str, h1, h2 );
+
+  uint32_t bitCount = bits.size() * 32;
+
+  for( uint32_t x = 0; x < hashes; ++x )
+  {
+    uint32_t bit = ( h1 + x * h2 ) % bitCount;
+
+    bits[ bit / 32 ] |= 1u << ( bit % 32 );
+  }
+}
+
+bool BloomFilter::mayContain( std::string const & str ) const
+{
+  if ( bits.empty() )
+    return true;
+
+  uint32_t h1, h2;
+
+  hash( str, h1, h2 );
+
+  uint32_t bitCount = bits.size() * 32;
+
+  for( uint32_t x = 0; x < hashes; ++x )
+  {
+    uint32_t bit = ( h1 + x * h2 ) % bitCount;
+
+    if ( !( bits[ bit / 32 ] & ( 1u << ( bit % 32 ) ) ) )
+      return false;
+  }
+
+  return true;
+}
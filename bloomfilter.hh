@@ -0,0 +1,61 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __BLOOMFILTER_HH_INCLUDED__
+#define __BLOOMFILTER_HH_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#if defined( _MSC_VER ) && _MSC_VER < 1800 // VS2012 and older
+#include <stdint_msvc.h>
+#else
+#include <stdint.h>
+#endif
+
+/// A compact set of strings which can only tell for sure that a string is
+/// not there. About one percent of the strings not added are reported as
+/// present as well.
+class BloomFilter
+{
+public:
+
+  /// Makes an empty filter which reports any string as present
+  BloomFilter();
+
+  /// Makes a filter sized for the given number of strings
+  explicit BloomFilter( size_t expectedItems );
+
+  /// Makes a filter out of the data of the one saved before, see getBits()
+  /// and getHashes()
+  BloomFilter( std::vector< uint32_t > const & bits, uint32_t hashes );
+
+  void add( std::string const & );
+
+  /// Returns false if the string was never added
+  bool mayContain( std::string const & ) const;
+
+  /// Returns true if the filter wasn't sized, i.e. can't tell anything
+  bool empty() const
+  { return bits.empty(); }
+
+  size_t getSize() const
+  { return bits.size() * sizeof( uint32_t ); }
+
+  std::vector< uint32_t > const & getBits() const
+  { return bits; }
+
+  uint32_t getHashes() const
+  { return hashes; }
+
+private:
+
+  std::vector< uint32_t > bits;
+  uint32_t hashes;
+
+  /// Returns the two halves of the hash of the string, which are combined
+  /// to get as many hashes as needed
+  static void hash( std::string const &, uint32_t & h1, uint32_t & h2 );
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "gddebug.hh"
 #include "wstring_qt.hh"
 #include "qt4x5.hh"
+#include "indexingstats.hh"
 
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
 #include <QRegularExpression>
@@ -53,7 +54,8 @@ enum
 };
 
 BtreeIndex::BtreeIndex():
-  idxFile( 0 ), rootNodeLoaded( false )
+  idxFile( 0 ), rootNodeLoaded( false ), wordFilterOffset( 0 ),
+  wordFilterWanted( false ), wordFilterLoading( false )
 {
 }
 
@@ -63,6 +65,15 @@ BtreeDictionary::BtreeDictionary( string const & id,
 {
 }
 
+Dictionary::Class::MemoryUsage BtreeDictionary::getMemoryUsage()
+{
+  MemoryUsage result = Dictionary::Class::getMemoryUsage();
+
+  result.resident += getIndexMemoryUsage() + ftsIdxName.capacity();
+
+  return result;
+}
+
 string const & BtreeDictionary::ensureInitDone()
 {
   static string empty;
@@ -83,8 +94,139 @@ void BtreeIndex::openIndex( IndexInfo const & indexInfo,
   rootNode.clear();
 }
 
+bool BtreeIndex::mayContainWord( wstring const & word )
+{
+  wstring folded = Folding::apply( word );
+  if( folded.empty() )
+    folded = Folding::applyWhitespaceOnly( word );
+
+  Mutex::Lock _( wordFilterMutex );
+
+  if ( wordFilter.empty() )
+  {
+    wordFilterWanted = true;
+    return true;
+  }
+
+  return wordFilter.mayContain( Utf8::encode( folded ) );
+}
+
+quint64 BtreeIndex::getIndexMemoryUsage()
+{
+  quint64 result = 0;
+
+  if ( idxFile )
+  {
+    Mutex::Lock _( *idxFileMutex );
+
+    result += rootNode.capacity();
+  }
+
+  Mutex::Lock _( wordFilterMutex );
+
+  return result + wordFilter.getSize();
+}
+
+bool BtreeIndex::isSurelyAbsent( wstring const & folded )
+{
+  Mutex::Lock _( wordFilterMutex );
+
+  return !wordFilter.empty() && !wordFilter.mayContain( Utf8::encode( folded ) );
+}
+
+void BtreeIndex::loadRootNode()
+{
+  readNode( rootOffset, rootNode );
+
+  // The filter of the words follows the root, which is the last node
+  // written. The older indices have none.
+
+  wordFilterOffset = 0;
+
+  try
+  {
+    if ( *(uint32_t *)&rootNode.front() != 0xffffFFFF )
+      idxFile->read< uint32_t >(); // The root is a leaf, skip its next leaf link
+
+    if ( idxFile->read< uint32_t >() == WordFilterSignature )
+      wordFilterOffset = idxFile->tell();
+  }
+  catch( File::exReadError & )
+  {
+    // Nothing follows the root
+  }
+
+  rootNodeLoaded = true;
+}
+
+bool BtreeIndex::readWordFilter( BloomFilter & filter )
+{
+  if ( !wordFilterOffset )
+    return false;
+
+  idxFile->seek( wordFilterOffset );
+
+  uint32_t hashes = idxFile->read< uint32_t >();
+  uint32_t size = idxFile->read< uint32_t >();
+
+  if ( !hashes || !size || size > ( 1u << 26 ) )
+    return false; // Doesn't look like a filter
+
+  vector< uint32_t > bits( size );
+
+  idxFile->read( &bits.front(), bits.size() * sizeof( uint32_t ) );
+
+  filter = BloomFilter( bits, hashes );
+
+  return true;
+}
+
+void BtreeIndex::loadWordFilterIfWanted()
+{
+  {
+    Mutex::Lock _( wordFilterMutex );
+
+    if ( !wordFilterWanted || wordFilterLoading || !wordFilter.empty() )
+      return;
+
+    wordFilterLoading = true;
+  }
+
+  BloomFilter filter;
+
+  try
+  {
+    Mutex::Lock _( *idxFileMutex );
+
+    if ( !rootNodeLoaded )
+      loadRootNode();
+
+    // An older index has none. Building one would mean reading all of its
+    // leaves within the lookup, so such dictionaries are just always looked
+    // up, until their indices get rebuilt. The loading state is kept so
+    // that it isn't tried again.
+    if ( !readWordFilter( filter ) )
+      return;
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "Failed to load the word filter, error: %s\n", e.what() );
+
+    // The loading state is kept so it isn't tried again. The filter stays
+    // empty, reporting any word as present
+    return;
+  }
+
+  Mutex::Lock _( wordFilterMutex );
+
+  wordFilter = filter;
+  wordFilterLoading = false;
+}
+
 vector< WordArticleLink > BtreeIndex::findArticles( wstring const & word, bool ignoreDiacritics )
 {
+  loadWordFilterIfWanted();
+
   vector< WordArticleLink > result;
 
   try
@@ -93,6 +235,9 @@ vector< WordArticleLink > BtreeIndex::findArticles( wstring const & word, bool i
     if( folded.empty() )
       folded = Folding::applyWhitespaceOnly( word );
 
+    if ( isSurelyAbsent( folded ) )
+      return result;
+
     bool exactMatch;
 
     vector< char > leaf;
@@ -125,6 +270,166 @@ vector< WordArticleLink > BtreeIndex::findArticles( wstring const & word, bool i
   return result;
 }
 
+vector< vector< WordArticleLink > > BtreeIndex::findArticlesBatch( vector< wstring > const & words,
+                                                                   bool ignoreDiacritics )
+{
+  loadWordFilterIfWanted();
+
+  vector< vector< WordArticleLink > > result( words.size() );
+
+  // Sort the folded keys, so the adjacent lookups would mostly walk through
+  // the same nodes. The ones the filter rules out aren't looked up at all.
+
+  vector< pair< wstring, size_t > > keys;
+
+  keys.reserve( words.size() );
+
+  for( size_t x = 0; x < words.size(); ++x )
+  {
+    wstring folded = Folding::apply( words[ x ] );
+    if( folded.empty() )
+      folded = Folding::applyWhitespaceOnly( words[ x ] );
+
+    if ( !isSurelyAbsent( folded ) )
+      keys.push_back( pair< wstring, size_t >( folded, x ) );
+  }
+
+  if ( keys.empty() )
+    return result;
+
+  std::sort( keys.begin(), keys.end() );
+
+  try
+  {
+    if ( !idxFile )
+      throw exIndexWasNotOpened();
+
+    NodeCache nodeCache;
+
+    Mutex::Lock _( *idxFileMutex );
+
+    vector< WordArticleLink > chain;
+
+    for( size_t x = 0; x < keys.size(); ++x )
+    {
+      if ( !x || keys[ x ].first != keys[ x - 1 ].first )
+      {
+        chain.clear();
+
+        bool exactMatch;
+
+        vector< char > leaf;
+        uint32_t nextLeaf;
+
+        char const * leafEnd;
+
+        char const * chainOffset = findChainOffsetExactOrPrefixLocked( keys[ x ].first, exactMatch,
+                                                                       leaf, nextLeaf,
+                                                                       leafEnd, &nodeCache );
+
+        if ( chainOffset && exactMatch )
+          chain = readChain( chainOffset );
+      }
+
+      // The words folded to the same key may still differ in case
+
+      vector< WordArticleLink > & links = result[ keys[ x ].second ];
+
+      links = chain;
+
+      antialias( words[ keys[ x ].second ], links, ignoreDiacritics );
+    }
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "Articles searching failed, error: %s\n", e.what() );
+    result.assign( words.size(), vector< WordArticleLink >() );
+  }
+  catch(...)
+  {
+    qWarning( "Articles searching failed\n" );
+    result.assign( words.size(), vector< WordArticleLink >() );
+  }
+
+  return result;
+}
+
+vector< WordArticleLink > BtreeIndex::findArticles( wstring const & word,
+                                                    vector< wstring > const & alts,
+                                                    bool ignoreDiacritics )
+{
+  if ( alts.empty() )
+    return findArticles( word, ignoreDiacritics );
+
+  vector< wstring > words;
+
+  words.reserve( alts.size() + 1 );
+  words.push_back( word );
+  words.insert( words.end(), alts.begin(), alts.end() );
+
+  vector< vector< WordArticleLink > > links = findArticlesBatch( words, ignoreDiacritics );
+
+  vector< WordArticleLink > result;
+
+  for( size_t x = 0; x < links.size(); ++x )
+    result.insert( result.end(), links[ x ].begin(), links[ x ].end() );
+
+  return result;
+}
+
+namespace {
+
+/// The folded prefixes a stemmed search looks the word up by, the longest
+/// one first. A stemmed search runs the same word through all the
+/// dictionaries at once, so the plan is made once and shared by them.
+struct StemmedSearchPlan
+{
+  wstring word;
+  unsigned minLength;
+  int maxSuffixVariation;
+
+  vector< wstring > prefixes;
+};
+
+StemmedSearchPlan getStemmedSearchPlan( wstring const & word, unsigned minLength,
+                                        int maxSuffixVariation )
+{
+  static Mutex mutex;
+  static StemmedSearchPlan lastPlan;
+
+  Mutex::Lock _( mutex );
+
+  if ( lastPlan.prefixes.empty() || lastPlan.word != word
+       || lastPlan.minLength != minLength
+       || lastPlan.maxSuffixVariation != maxSuffixVariation )
+  {
+    wstring folded = Folding::apply( word );
+
+    if ( folded.empty() )
+      folded = Folding::applyWhitespaceOnly( word );
+
+    int charsLeftToChop = (int)folded.size() - (int)minLength;
+
+    if ( charsLeftToChop < 0 )
+      charsLeftToChop = 0;
+    else
+    if ( charsLeftToChop > maxSuffixVariation )
+      charsLeftToChop = maxSuffixVariation;
+
+    lastPlan.word = word;
+    lastPlan.minLength = minLength;
+    lastPlan.maxSuffixVariation = maxSuffixVariation;
+    lastPlan.prefixes.clear();
+
+    for( int x = 0; x <= charsLeftToChop; ++x )
+      lastPlan.prefixes.push_back( folded.substr( 0, folded.size() - x ) );
+  }
+
+  return lastPlan;
+}
+
+}
+
 class BtreeWordSearchRunnable: public QRunnable
 {
   BtreeWordSearchRequest & r;
@@ -197,12 +502,15 @@ void BtreeWordSearchRequest::findMatches()
                      str.find( '[' ) != wstring::npos ||
                      str.find( ']' ) != wstring::npos );
 
-  wstring folded = Folding::apply( str );
+  wstring folded;
+  vector< wstring > candidates;
 
   int minMatchLength = 0;
 
   if( useWildcards )
   {
+    folded = Folding::apply( str );
+
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
     regexp.setPattern( wildcardsToRegexp( gd::toQString( Folding::applyDiacriticsOnly( Folding::applySimpleCaseOnly( str ) ) ) ) );
     if( !regexp.isValid() )
@@ -295,32 +603,39 @@ void BtreeWordSearchRequest::findMatches()
 
       folded.push_back( ch );
     }
+
+    candidates.push_back( folded );
   }
   else
+  if ( maxSuffixVariation >= 0 )
+    candidates = getStemmedSearchPlan( str, minLength, maxSuffixVariation ).prefixes;
+  else
   {
+    folded = Folding::apply( str );
+
     if( folded.empty() )
       folded = Folding::applyWhitespaceOnly( str );
-  }
 
-  int initialFoldedSize = folded.size();
+    candidates.push_back( folded );
+  }
 
-  int charsLeftToChop = 0;
+  int initialFoldedSize = candidates.front().size();
 
-  if ( maxSuffixVariation >= 0 )
-  {
-    charsLeftToChop = initialFoldedSize - (int)minLength;
-
-    if ( charsLeftToChop < 0 )
-      charsLeftToChop = 0;
-    else
-    if ( charsLeftToChop > maxSuffixVariation )
-      charsLeftToChop = maxSuffixVariation;
-  }
+  // Each candidate is a prefix of the previous one, so the chains matched by
+  // the previous candidate lie inside the range of the current one. They are
+  // not scanned again: once the scan reaches them, it resumes from the chain
+  // which has ended the previous scan.
+  wstring scannedPrefix;
+  vector< char > resumeLeaf;
+  uint32_t resumeNextLeaf = 0;
+  bool resumeAtEnd = false;
 
   try
   {
-    for( ; ; )
+    for( size_t c = 0; c < candidates.size(); ++c )
     {
+      folded = candidates[ c ];
+
       bool exactMatch;
       vector< char > leaf;
       uint32_t nextLeaf;
@@ -330,14 +645,28 @@ void BtreeWordSearchRequest::findMatches()
                                                                     leaf, nextLeaf,
                                                                     leafEnd );
 
-      if ( chainOffset )
+      if ( !chainOffset )
+      {
+        // Nothing to match past the end of the index
+        scannedPrefix.clear();
+        continue;
+      }
+
+      bool stopped = false;
+      bool atEnd = false;
+
       for( ; ; )
       {
         if ( Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
+        {
+          stopped = true;
           break;
+        }
 
         //DPRINTF( "offset = %u, size = %u\n", chainOffset - &leaf.front(), leaf.size() );
 
+        char const * thisChain = chainOffset;
+
         vector< WordArticleLink > chain = dict.readChain( chainOffset );
 
         wstring chainHead = Utf8::decode( chain[ 0 ].word );
@@ -346,6 +675,27 @@ void BtreeWordSearchRequest::findMatches()
         if( resultFolded.empty() )
           resultFolded = Folding::applyWhitespaceOnly( chainHead );
 
+        if ( scannedPrefix.size() && resultFolded.size() >= scannedPrefix.size()
+             && !resultFolded.compare( 0, scannedPrefix.size(), scannedPrefix ) )
+        {
+          // Reached the chains of the previous candidate, skip them
+
+          scannedPrefix.clear();
+
+          if ( resumeAtEnd )
+          {
+            atEnd = true;
+            break;
+          }
+
+          leaf.swap( resumeLeaf );
+          nextLeaf = resumeNextLeaf;
+          chainOffset = &leaf.front();
+          leafEnd = &leaf.front() + leaf.size();
+
+          continue;
+        }
+
         if ( ( useWildcards && folded.empty() ) ||
              ( resultFolded.size() >= folded.size()
                && !resultFolded.compare( 0, folded.size(), folded ) ) )
@@ -388,20 +738,23 @@ void BtreeWordSearchRequest::findMatches()
             }
           }
 
-          if( Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
-            break;
-
           if ( matches.size() >= maxResults )
           {
             // For now we actually allow more than maxResults if the last
             // chain yield more than one result. That's ok and maybe even more
             // desirable.
+            stopped = true;
             break;
           }
         }
         else
-          // Neither exact nor a prefix match, end this
+        {
+          // Neither exact nor a prefix match, end this. The next candidate
+          // would resume from this chain.
+          resumeLeaf.assign( thisChain, leafEnd );
+          resumeNextLeaf = nextLeaf;
           break;
+        }
 
         // Fetch new leaf if we're out of chains here
 
@@ -430,17 +783,18 @@ void BtreeWordSearchRequest::findMatches()
             }
           }
           else
+          {
+            atEnd = true;
             break; // That was the last leaf
+          }
         }
       }
 
-      if ( charsLeftToChop && !Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
-      {
-        --charsLeftToChop;
-        folded.resize( folded.size() - 1 );
-      }
-      else
+      if ( stopped )
         break;
+
+      scannedPrefix = folded;
+      resumeAtEnd = atEnd;
     }
   }
   catch( std::exception & e )
@@ -496,6 +850,119 @@ sptr< Dictionary::WordSearchRequest > BtreeDictionary::stemmedMatch(
                                      false, maxResults );
 }
 
+namespace {
+
+class BtreeHeadwordsRequest;
+
+class BtreeHeadwordsRunnable: public QRunnable
+{
+  BtreeHeadwordsRequest & r;
+  QSemaphore & hasExited;
+
+public:
+
+  BtreeHeadwordsRunnable( BtreeHeadwordsRequest & r_,
+                          QSemaphore & hasExited_ ): r( r_ ),
+                                                     hasExited( hasExited_ )
+  {}
+
+  ~BtreeHeadwordsRunnable()
+  {
+    hasExited.release();
+  }
+
+  virtual void run();
+};
+
+class BtreeHeadwordsRequest: public Dictionary::WordSearchRequest
+{
+  friend class BtreeHeadwordsRunnable;
+
+  BtreeDictionary & dict;
+  vector< wstring > words;
+  QAtomicInt isCancelled;
+  QSemaphore hasExited;
+
+public:
+
+  BtreeHeadwordsRequest( BtreeDictionary & dict_,
+                         vector< wstring > const & words_ ):
+    dict( dict_ ), words( words_ )
+  {
+    QThreadPool::globalInstance()->start(
+      new BtreeHeadwordsRunnable( *this, hasExited ) );
+  }
+
+  void run(); // Run from another thread by BtreeHeadwordsRunnable
+
+  virtual void cancel()
+  {
+    isCancelled.ref();
+  }
+
+  ~BtreeHeadwordsRequest()
+  {
+    isCancelled.ref();
+    hasExited.acquire();
+  }
+};
+
+void BtreeHeadwordsRunnable::run()
+{
+  r.run();
+}
+
+void BtreeHeadwordsRequest::run()
+{
+  if ( Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
+  {
+    finish();
+    return;
+  }
+
+  if ( dict.ensureInitDone().size() )
+  {
+    setErrorString( QString::fromUtf8( dict.ensureInitDone().c_str() ) );
+    finish();
+    return;
+  }
+
+  try
+  {
+    vector< vector< WordArticleLink > > links = dict.findArticlesBatch( words );
+
+    Mutex::Lock _( dataMutex );
+
+    for( size_t x = 0; x < words.size(); ++x )
+    {
+      if ( !links[ x ].empty() )
+        addMatch( words[ x ] );
+    }
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "Headwords searching failed: \"%s\", error: %s\n",
+               dict.getName().c_str(), e.what() );
+    setErrorString( QString::fromUtf8( e.what() ) );
+  }
+  catch(...)
+  {
+    gdWarning( "Headwords searching failed: \"%s\"\n", dict.getName().c_str() );
+    setErrorString( "Headwords searching failed" );
+  }
+
+  finish();
+}
+
+}
+
+sptr< Dictionary::WordSearchRequest > BtreeDictionary::findHeadwords(
+  vector< wstring > const & words )
+  THROW_SPEC( std::exception )
+{
+  return new BtreeHeadwordsRequest( *this, words );
+}
+
 void BtreeIndex::readNode( uint32_t offset, vector< char > & out )
 {
   idxFile->seek( offset );
@@ -533,6 +1000,52 @@ void BtreeIndex::readNode( uint32_t offset, vector< char > & out )
   #endif
 }
 
+/// Tells whether the given decompressed node is a leaf. The nodes start
+/// with 0xffffFFFF instead of the number of the entries.
+static bool isLeaf( vector< char > const & node )
+{
+  return node.size() >= sizeof( uint32_t ) && *(uint32_t const *) &node.front() != 0xffffFFFF;
+}
+
+char const * BtreeIndex::readNode( uint32_t offset, vector< char > & out,
+                                   char const * & nodeEnd, uint32_t & nextLeaf,
+                                   NodeCache * nodeCache )
+{
+  // Only the leaves are followed by the offset of the next one
+
+  if ( !nodeCache )
+  {
+    readNode( offset, out );
+    nextLeaf = isLeaf( out ) ? idxFile->read< uint32_t >() : 0;
+    nodeEnd = &out.front() + out.size();
+
+    return &out.front();
+  }
+
+  NodeCache::iterator i = nodeCache->find( offset );
+
+  if ( i == nodeCache->end() )
+  {
+    i = nodeCache->insert( NodeCache::value_type( offset, NodeCache::mapped_type() ) ).first;
+
+    try
+    {
+      readNode( offset, i->second.first );
+      i->second.second = isLeaf( i->second.first ) ? idxFile->read< uint32_t >() : 0;
+    }
+    catch( ... )
+    {
+      nodeCache->erase( i );
+      throw;
+    }
+  }
+
+  nextLeaf = i->second.second;
+  nodeEnd = &i->second.first.front() + i->second.first.size();
+
+  return &i->second.first.front();
+}
+
 char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
                                                        bool & exactMatch,
                                                        vector< char > & extLeaf,
@@ -543,7 +1056,18 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
     throw exIndexWasNotOpened();
   
   Mutex::Lock _( *idxFileMutex );
-  
+
+  return findChainOffsetExactOrPrefixLocked( target, exactMatch, extLeaf,
+                                             nextLeaf, leafEnd, 0 );
+}
+
+char const * BtreeIndex::findChainOffsetExactOrPrefixLocked( wstring const & target,
+                                                             bool & exactMatch,
+                                                             vector< char > & extLeaf,
+                                                             uint32_t & nextLeaf,
+                                                             char const * & leafEnd,
+                                                             NodeCache * nodeCache )
+{
   // Lookup the index by traversing the index btree
 
   vector< wchar > wcharBuffer;
@@ -557,8 +1081,7 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
   if ( !rootNodeLoaded )
   {
     // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
+    loadRootNode();
   }
 
   char const * leaf = &rootNode.front();
@@ -575,10 +1098,7 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
       {
         // A node
         currentNodeOffset = *( (uint32_t *)leaf + 1 );
-        readNode( currentNodeOffset, extLeaf );
-        leaf = &extLeaf.front();
-        leafEnd = leaf + extLeaf.size();
-        nextLeaf = idxFile->read< uint32_t >();
+        leaf = readNode( currentNodeOffset, extLeaf, leafEnd, nextLeaf, nodeCache );
       }
       else
       {
@@ -731,9 +1251,7 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
       }
 
       //DPRINTF( "reading node at %x\n", currentNodeOffset );
-      readNode( currentNodeOffset, extLeaf );
-      leaf = &extLeaf.front();
-      leafEnd = leaf + extLeaf.size();
+      leaf = readNode( currentNodeOffset, extLeaf, leafEnd, nextLeaf, nodeCache );
     }
     else
     {
@@ -741,9 +1259,9 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
       // A leaf
 
       // If this leaf is the root, there's no next leaf, it just can't be.
-      // We do this check because the file's position indicator just won't
-      // be in the right place for root node anyway, since we precache it.
-      nextLeaf = ( currentNodeOffset != rootOffset ? idxFile->read< uint32_t >() : 0 );
+      // Otherwise, it was read along with the leaf.
+      if ( currentNodeOffset == rootOffset )
+        nextLeaf = 0;
 
       if ( !leafEntries )
       {
@@ -852,13 +1370,9 @@ char const * BtreeIndex::findChainOffsetExactOrPrefix( wstring const & target,
             {
               if ( nextLeaf )
               {
-                readNode( nextLeaf, extLeaf );
-  
-                leafEnd = &extLeaf.front() + extLeaf.size();
-  
-                nextLeaf = idxFile->read< uint32_t >();
-  
-                return &extLeaf.front() + sizeof( uint32_t );
+                char const * next = readNode( nextLeaf, extLeaf, leafEnd, nextLeaf, nodeCache );
+
+                return next + sizeof( uint32_t );
               }
               else
                 return 0; // This was the last leaf
@@ -1110,6 +1624,8 @@ static uint32_t buildBtreeNode( IndexedWords::const_iterator & nextIndex,
 
 void IndexedWords::addWord( wstring const & word, uint32_t articleOffset, unsigned int maxHeadwordSize )
 {
+  IndexingStats::addArticleAt( articleOffset );
+
   wchar const * wordBegin = word.c_str();
   string::size_type wordSize = word.size();
 
@@ -1133,6 +1649,8 @@ void IndexedWords::addWord( wstring const & word, uint32_t articleOffset, unsign
 #undef MAX_LOG_WORD_SIZE
   }
 
+  IndexingStats::add( IndexingStats::Headwords );
+
   // Skip any leading whitespace
   while( *wordBegin && Folding::isWhitespace( *wordBegin ) )
   {
@@ -1223,6 +1741,8 @@ void IndexedWords::addWord( wstring const & word, uint32_t articleOffset, unsign
 
 void IndexedWords::addSingleWord( wstring const & word, uint32_t articleOffset )
 {
+  IndexingStats::add( IndexingStats::Headwords );
+
   wstring folded = Folding::apply( word );
   if( folded.empty() )
       folded = Folding::applyWhitespaceOnly( word );
@@ -1260,10 +1780,26 @@ IndexInfo buildIndex( IndexedWords const & indexedWords, File::Class & file )
 
   uint32_t lastLeafOffset = 0;
 
+  IndexedWords::const_iterator firstIndex = nextIndex;
+
   uint32_t rootOffset = buildBtreeNode( nextIndex, indexSize,
                                         file, btreeMaxElements,
                                         lastLeafOffset );
 
+  // The root is written last, so the filter goes right after it
+
+  BloomFilter filter( indexSize );
+
+  for( IndexedWords::const_iterator i = firstIndex; i != indexedWords.end(); ++i )
+    filter.add( i->first );
+
+  file.write< uint32_t >( WordFilterSignature );
+  file.write< uint32_t >( filter.getHashes() );
+  file.write< uint32_t >( filter.getBits().size() );
+  file.write( &filter.getBits().front(), filter.getBits().size() * sizeof( uint32_t ) );
+
+  IndexingStats::add( IndexingStats::IndexEntries, indexSize );
+
   return IndexInfo( btreeMaxElements, rootOffset );
 }
 
@@ -1299,8 +1835,7 @@ void BtreeIndex::findArticleLinks( QVector< WordArticleLink > * articleLinks,
   if ( !rootNodeLoaded )
   {
     // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
+    loadRootNode();
   }
 
   char const * leaf = &rootNode.front();
@@ -1425,8 +1960,7 @@ void BtreeIndex::getHeadwordsFromOffsets( QList<uint32_t> & offsets,
   if ( !rootNodeLoaded )
   {
     // Time to load our root node. We do it only once, at the first request.
-    readNode( rootOffset, rootNode );
-    rootNodeLoaded = true;
+    loadRootNode();
   }
 
   char const * leaf = &rootNode.front();
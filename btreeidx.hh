@@ -6,6 +6,7 @@
 
 #include "dictionary.hh"
 #include "file.hh"
+#include "bloomfilter.hh"
 
 #include <string>
 #include <vector>
@@ -36,9 +37,12 @@ enum
   /// This is to be bumped up each time the internal format changes.
   /// The value isn't used here by itself, it is supposed to be added
   /// to each dictionary's internal format version.
-  FormatVersion = 4
+  FormatVersion = 5
 };
 
+/// Marks the filter of the folded words stored after the root node
+uint32_t const WordFilterSignature = 0x46574447; // GDWF on little-endian
+
 // These exceptions which might be thrown during the index traversal
 
 DEF_EX( exIndexWasNotOpened, "The index wasn't opened", Dictionary::Ex )
@@ -88,6 +92,19 @@ public:
   /// is performed.
   vector< WordArticleLink > findArticles( wstring const &, bool ignoreDiacritics = false );
 
+  /// Finds articles for each of the given words at once, returning a vector
+  /// of links for each word, in the same order. The words are looked up in
+  /// their folded order with the index file locked once, and the nodes met on
+  /// the way are only decompressed once for all of them.
+  vector< vector< WordArticleLink > > findArticlesBatch( vector< wstring > const &,
+                                                         bool ignoreDiacritics = false );
+
+  /// Finds articles for the given word and its alternate writings, which is
+  /// what getArticle() usually needs. The links for the word go first, then
+  /// the ones for each of the alternate writings.
+  vector< WordArticleLink > findArticles( wstring const &, vector< wstring > const & alts,
+                                          bool ignoreDiacritics = false );
+
   /// Find all unique article links in the index
   void findAllArticleLinks( QVector< WordArticleLink > & articleLinks );
 
@@ -100,6 +117,17 @@ public:
                          QSet< QString > * headwords,
                          QAtomicInt * isCancelled = 0 );
 
+  /// Returns false if the word is surely absent from the index, which is
+  /// told by the filter of its folded words. The filter is loaded by the
+  /// first lookup made after it was asked for here, so until then any word
+  /// is reported as possibly present. Once loaded, the lookups consult it
+  /// as well. Cheap, can be called from any thread.
+  bool mayContainWord( wstring const & );
+
+  /// Returns the memory held by the index, i.e. by its root node and its
+  /// filter of the words, which are kept once loaded.
+  quint64 getIndexMemoryUsage();
+
   /// Retrieve headwords for presented article addresses
   void getHeadwordsFromOffsets( QList< uint32_t > & offsets,
                                 QVector< QString > & headwords,
@@ -125,6 +153,29 @@ protected:
                                              uint32_t & nextLeaf,
                                              char const * & leafEnd );
 
+  /// The nodes decompressed during a batch lookup, by their offsets. Each
+  /// leaf is stored along with the offset of the leaf following it, the
+  /// other nodes have none, so zero is stored for them.
+  typedef map< uint32_t, std::pair< vector< char >, uint32_t > > NodeCache;
+
+  /// Same as above, but expects idxFileMutex to be already locked. If the
+  /// node cache is given, the nodes are taken from it, and the returned
+  /// pointer belongs to it rather than to 'leaf'.
+  char const * findChainOffsetExactOrPrefixLocked( wstring const & target,
+                                                   bool & exactMatch,
+                                                   vector< char > & leaf,
+                                                   uint32_t & nextLeaf,
+                                                   char const * & leafEnd,
+                                                   NodeCache * nodeCache );
+
+  /// Reads a node or leaf at the given offset, along with the offset of the
+  /// next leaf if it's a leaf (zero otherwise), taking it from the node
+  /// cache if one is given. Returns the
+  /// pointer to its data, which either belongs to 'out' or to the cache.
+  char const * readNode( uint32_t offset, vector< char > & out,
+                         char const * & nodeEnd, uint32_t & nextLeaf,
+                         NodeCache * nodeCache );
+
   /// Reads a node or leaf at the given offset. Just uncompresses its data
   /// to the given vector and does nothing more.
   void readNode( uint32_t offset, vector< char > & out );
@@ -137,6 +188,25 @@ protected:
   /// are left.
   void antialias( wstring const &, vector< WordArticleLink > &, bool ignoreDiactitics );
 
+  /// Loads the filter of the folded words if mayContainWord() asked for it.
+  /// It's stored in the index right after the root node. The indices built
+  /// before the filter was added have none, and never get one, so any word
+  /// is reported as possibly present for them. Done by the lookups, since
+  /// they run in the threads the dictionary waits for before going away.
+  void loadWordFilterIfWanted();
+
+  /// Returns true if the filter is loaded and rules out the given folded
+  /// word. The lookups check this before touching the tree.
+  bool isSurelyAbsent( wstring const & folded );
+
+  /// Loads the root node, finding out whether the filter follows it.
+  /// Expects idxFileMutex to be locked.
+  void loadRootNode();
+
+  /// Reads the filter stored in the index, if there's one. Expects
+  /// idxFileMutex to be locked, and the root node to be loaded.
+  bool readWordFilter( BloomFilter & );
+
 protected:
 
   Mutex * idxFileMutex;
@@ -149,6 +219,12 @@ private:
   bool rootNodeLoaded;
   vector< char > rootNode; // We load root note here and keep it at all times,
                            // since all searches always start with it.
+
+  uint32_t wordFilterOffset; // Zero if there's no filter stored
+
+  Mutex wordFilterMutex; // Guards the filter and its state
+  BloomFilter wordFilter;
+  bool wordFilterWanted, wordFilterLoading;
 };
 
 /// A base for the dictionary that utilizes a btree index build using
@@ -175,9 +251,21 @@ public:
                                                               unsigned long maxResults )
     THROW_SPEC( std::exception );
 
+  /// Checks all the words against the btree index in a separate thread.
+  virtual sptr< Dictionary::WordSearchRequest > findHeadwords( vector< wstring > const & )
+    THROW_SPEC( std::exception );
+
   virtual bool isLocalDictionary()
   { return true; }
 
+  /// Consults the filter of the index words. Only the dictionaries which
+  /// rarely have the words asked for are supposed to be checked, since the
+  /// filter is loaded into memory on the first check.
+  virtual bool mayHaveArticles( wstring const & word )
+  { return mayContainWord( word ); }
+
+  virtual MemoryUsage getMemoryUsage();
+
   virtual bool getHeadwords( QStringList &headwords );
 
   virtual void getArticleText( uint32_t articleAddress, QString & headword, QString & text );
@@ -268,7 +356,8 @@ struct IndexedWords: public map< string, vector< WordArticleLink > >
 
 /// Builds the index, as a compressed btree. Returns IndexInfo.
 /// All the data is stored to the given file, beginning from its current
-/// position.
+/// position. The btree is followed by a filter of its folded words, which
+/// tells the words which are surely absent.
 IndexInfo buildIndex( IndexedWords const &, File::Class & file );
 
 }
@@ -4,6 +4,8 @@
 #include "chinese.hh"
 #include <stdexcept>
 #include <QCoreApplication>
+#include <QCache>
+#include <QByteArray>
 #ifdef Q_OS_MAC
 #include <opencc/opencc.h>
 #endif
@@ -11,11 +13,19 @@
 #include <opencc/SimpleConverter.hpp>
 #include "folding.hh"
 #include "gddebug.hh"
+#include "mutex.hh"
 #include "transliteration.hh"
 #include "utf8.hh"
 
 namespace Chinese {
 
+namespace {
+
+/// The number of converted strings each converter remembers
+enum { ConversionCacheSize = 2048 };
+
+}
+
 class CharacterConversionDictionary: public Transliteration::BaseTransliterationDictionary
 {
 #ifdef Q_OS_MAC
@@ -24,6 +34,20 @@ class CharacterConversionDictionary: public Transliteration::BaseTransliteration
   opencc::SimpleConverter* converter;
 #endif
 
+  /// Maps utf8-encoded folded input to the utf8-encoded OpenCC output. QCache
+  /// evicts the least recently used entries once it is full.
+  QCache< QByteArray, std::string > conversionCache;
+  Mutex cacheMutex;
+
+  bool isConverterValid() const;
+
+  /// Runs OpenCC on the given utf8 string. Returns false on failure.
+  bool convert( std::string const & input, std::string & output );
+
+  /// Converts all the given utf8 strings, running OpenCC only once for the
+  /// ones which aren't cached yet. The results are stored in the cache.
+  void convertBatch( std::vector< std::string > const & inputs );
+
 public:
 
   CharacterConversionDictionary( std::string const & id, std::string const & name,
@@ -32,6 +56,9 @@ public:
 
   std::vector< gd::wstring > getAlternateWritings( gd::wstring const & )
     throw();
+
+  void prepareAlternateWritings( std::vector< gd::wstring > const & )
+    throw();
 };
 
 CharacterConversionDictionary::CharacterConversionDictionary( std::string const & id,
@@ -39,7 +66,8 @@ CharacterConversionDictionary::CharacterConversionDictionary( std::string const
                                                               QIcon icon_,
                                                               QString const & openccConfig):
   Transliteration::BaseTransliterationDictionary( id, name_, icon_, false ),
-  converter( NULL )
+  converter( NULL ),
+  conversionCache( ConversionCacheSize )
 {
   try {
 #ifdef Q_OS_MAC
@@ -69,33 +97,140 @@ CharacterConversionDictionary::~CharacterConversionDictionary()
 #endif
 }
 
+bool CharacterConversionDictionary::isConverterValid() const
+{
+#ifdef Q_OS_MAC
+  return converter != NULL && converter != reinterpret_cast< opencc_t >( -1 );
+#else
+  return converter != NULL;
+#endif
+}
+
+bool CharacterConversionDictionary::convert( std::string const & input, std::string & output )
+{
+  try {
+#ifdef Q_OS_MAC
+    char * tmp = opencc_convert_utf8( converter, input.c_str(), input.length() );
+    if( !tmp )
+    {
+      gdWarning( "OpenCC: conversion failed %s\n", opencc_error() );
+      return false;
+    }
+    output = std::string( tmp );
+    opencc_convert_utf8_free( tmp );
+#else
+    output = converter->Convert( input );
+#endif
+    return true;
+  } catch ( std::exception& ex ) {
+    gdWarning( "OpenCC: conversion failed %s\n", ex.what() );
+  }
+
+  return false;
+}
+
+void CharacterConversionDictionary::convertBatch( std::vector< std::string > const & inputs )
+{
+  // Collect the strings not converted yet. They are joined with newlines and
+  // passed to OpenCC in one call, since its per-call overhead dominates the
+  // conversion time of short strings. OpenCC never converts newlines, and
+  // segments don't cross them, so the output splits back unambiguously.
+  std::vector< std::string > pending;
+  std::string joined;
+
+  {
+    Mutex::Lock _( cacheMutex );
+
+    for( size_t x = 0; x < inputs.size(); ++x )
+    {
+      std::string const & input = inputs[ x ];
+
+      if ( input.empty() || input.find( '\n' ) != std::string::npos
+           || conversionCache.contains( QByteArray( input.data(), input.size() ) ) )
+        continue;
+
+      if ( !pending.empty() )
+        joined.push_back( '\n' );
+
+      joined += input;
+      pending.push_back( input );
+    }
+  }
+
+  if ( pending.empty() )
+    return;
+
+  std::vector< std::string > outputs;
+
+  std::string output;
+
+  if ( convert( joined, output ) )
+  {
+    for( size_t pos = 0; ; )
+    {
+      size_t next = output.find( '\n', pos );
+      outputs.push_back( output.substr( pos, next == std::string::npos ? next : next - pos ) );
+
+      if ( next == std::string::npos )
+        break;
+
+      pos = next + 1;
+    }
+  }
+
+  if ( outputs.size() != pending.size() )
+  {
+    // Shouldn't normally happen -- fall back to converting one by one
+    outputs.clear();
+
+    for( size_t x = 0; x < pending.size(); ++x )
+    {
+      outputs.push_back( std::string() );
+      convert( pending[ x ], outputs.back() );
+    }
+  }
+
+  Mutex::Lock _( cacheMutex );
+
+  for( size_t x = 0; x < pending.size(); ++x )
+    conversionCache.insert( QByteArray( pending[ x ].data(), pending[ x ].size() ),
+                            new std::string( outputs[ x ] ) );
+}
+
 std::vector< gd::wstring > CharacterConversionDictionary::getAlternateWritings( gd::wstring const & str )
   throw()
 {
   std::vector< gd::wstring > results;
 
-  if ( converter != NULL ) {
+  if ( isConverterValid() ) {
     gd::wstring folded = Folding::applySimpleCaseOnly( str );
     std::string input = Utf8::encode( folded );
+    QByteArray key( input.data(), input.size() );
     std::string output;
-    gd::wstring result;
+    bool cached = false;
 
-    try {
-#ifdef Q_OS_MAC
-      if ( converter != NULL && converter != reinterpret_cast< opencc_t >( -1 ) )
+    {
+      Mutex::Lock _( cacheMutex );
+
+      if ( std::string const * hit = conversionCache.object( key ) )
       {
-        char * tmp = opencc_convert_utf8( converter, input.c_str(), input.length() );
-        if( tmp )
-        {
-          output = std::string( tmp );
-          opencc_convert_utf8_free( tmp );
-        }
-        else
-          gdWarning( "OpenCC: conversion failed %s\n", opencc_error() );
+        output = *hit;
+        cached = true;
       }
-#else
-      output = converter->Convert( input );
-#endif
+    }
+
+    if ( !cached )
+    {
+      if ( !convert( input, output ) )
+        return results;
+
+      Mutex::Lock _( cacheMutex );
+      conversionCache.insert( key, new std::string( output ) );
+    }
+
+    gd::wstring result;
+
+    try {
       result = Utf8::decode( output );
     } catch ( std::exception& ex ) {
       gdWarning( "OpenCC: conversion failed %s\n", ex.what() );
@@ -108,6 +243,21 @@ std::vector< gd::wstring > CharacterConversionDictionary::getAlternateWritings(
   return results;
 }
 
+void CharacterConversionDictionary::prepareAlternateWritings( std::vector< gd::wstring > const & words )
+  throw()
+{
+  if ( !isConverterValid() )
+    return;
+
+  std::vector< std::string > inputs;
+  inputs.reserve( words.size() );
+
+  for( size_t x = 0; x < words.size(); ++x )
+    inputs.push_back( Utf8::encode( Folding::applySimpleCaseOnly( words[ x ] ) ) );
+
+  convertBatch( inputs );
+}
+
 std::vector< sptr< Dictionary::Class > > makeDictionaries( Config::Chinese const & cfg )
   THROW_SPEC( std::exception )
 {
@@ -2,6 +2,7 @@
  * Part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
 
 #include "chunkedstorage.hh"
+#include "indexingstats.hh"
 #include <zlib.h>
 #include <string.h>
 
@@ -57,6 +58,8 @@ void Writer::addToBlock( void const * data, size_t size )
   bufferUsed += size;
 
   chunkStarted = false;
+
+  IndexingStats::add( IndexingStats::StoredBytes, size );
 }
 
 void Writer::saveCurrentChunk()
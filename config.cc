@@ -227,6 +227,7 @@ Preferences::Preferences():
   disallowContentFromOtherSites( false ),
   enableWebPlugins( false ),
   hideGoldenDictHeader( false ),
+  prefetchWebSites( false ),
   maxNetworkCacheSize( 50 ),
   clearNetworkCacheOnExit( true ),
   zoomFactor( 1 ),
@@ -240,6 +241,8 @@ Preferences::Preferences():
 , confirmFavoritesDeletion( true )
 , collapseBigArticles( false )
 , articleSizeLimit( 2000 )
+, hibernateTabs( true )
+, hibernateTabsAfter( 30 )
 , limitInputPhraseLength( false )
 , inputPhraseLengthLimit( 1000 )
 , maxDictionaryRefsInContextMenu ( 20 )
@@ -936,6 +939,9 @@ Class load() THROW_SPEC( exError )
     if ( !preferences.namedItem( "hideGoldenDictHeader" ).isNull() )
       c.preferences.hideGoldenDictHeader = ( preferences.namedItem( "hideGoldenDictHeader" ).toElement().text() == "1" );
 
+    if ( !preferences.namedItem( "prefetchWebSites" ).isNull() )
+      c.preferences.prefetchWebSites = ( preferences.namedItem( "prefetchWebSites" ).toElement().text() == "1" );
+
     if ( !preferences.namedItem( "maxNetworkCacheSize" ).isNull() )
       c.preferences.maxNetworkCacheSize = preferences.namedItem( "maxNetworkCacheSize" ).toElement().text().toInt();
 
@@ -969,6 +975,12 @@ Class load() THROW_SPEC( exError )
     if ( !preferences.namedItem( "articleSizeLimit" ).isNull() )
       c.preferences.articleSizeLimit = preferences.namedItem( "articleSizeLimit" ).toElement().text().toInt();
 
+    if ( !preferences.namedItem( "hibernateTabs" ).isNull() )
+      c.preferences.hibernateTabs = ( preferences.namedItem( "hibernateTabs" ).toElement().text() == "1" );
+
+    if ( !preferences.namedItem( "hibernateTabsAfter" ).isNull() )
+      c.preferences.hibernateTabsAfter = preferences.namedItem( "hibernateTabsAfter" ).toElement().text().toInt();
+
     if ( !preferences.namedItem( "limitInputPhraseLength" ).isNull() )
       c.preferences.limitInputPhraseLength = ( preferences.namedItem( "limitInputPhraseLength" ).toElement().text() == "1" );
 
@@ -1174,6 +1186,24 @@ Class load() THROW_SPEC( exError )
       c.headwordsDialog.headwordsDialogGeometry = QByteArray::fromBase64( headwordsDialog.namedItem( "headwordsDialogGeometry" ).toElement().text().toLatin1() );
   }
 
+  QDomNode queryServer = root.namedItem( "queryServer" );
+
+  if ( !queryServer.isNull() )
+  {
+    if ( !queryServer.namedItem( "enabled" ).isNull() )
+      c.queryServer.enabled = ( queryServer.namedItem( "enabled" ).toElement().text() == "1" );
+
+    if ( !queryServer.namedItem( "name" ).isNull() )
+      c.queryServer.name = queryServer.namedItem( "name" ).toElement().text();
+
+    if ( !queryServer.namedItem( "maxPendingRequests" ).isNull() )
+    {
+      unsigned value = queryServer.namedItem( "maxPendingRequests" ).toElement().text().toUInt();
+      if ( value != 0 ) // Nothing would ever be answered
+        c.queryServer.maxPendingRequests = value;
+    }
+  }
+
   return c;
 }
 
@@ -1913,6 +1943,10 @@ void save( Class const & c ) THROW_SPEC( exError )
     opt.appendChild( dd.createTextNode( c.preferences.hideGoldenDictHeader ? "1" : "0" ) );
     preferences.appendChild( opt );
 
+    opt = dd.createElement( "prefetchWebSites" );
+    opt.appendChild( dd.createTextNode( c.preferences.prefetchWebSites ? "1" : "0" ) );
+    preferences.appendChild( opt );
+
     opt = dd.createElement( "maxNetworkCacheSize" );
     opt.appendChild( dd.createTextNode( QString::number( c.preferences.maxNetworkCacheSize ) ) );
     preferences.appendChild( opt );
@@ -1945,6 +1979,14 @@ void save( Class const & c ) THROW_SPEC( exError )
     opt.appendChild( dd.createTextNode( QString::number( c.preferences.articleSizeLimit ) ) );
     preferences.appendChild( opt );
 
+    opt = dd.createElement( "hibernateTabs" );
+    opt.appendChild( dd.createTextNode( c.preferences.hibernateTabs ? "1" : "0" ) );
+    preferences.appendChild( opt );
+
+    opt = dd.createElement( "hibernateTabsAfter" );
+    opt.appendChild( dd.createTextNode( QString::number( c.preferences.hibernateTabsAfter ) ) );
+    preferences.appendChild( opt );
+
     opt = dd.createElement( "limitInputPhraseLength" );
     opt.appendChild( dd.createTextNode( c.preferences.limitInputPhraseLength ? "1" : "0" ) );
     preferences.appendChild( opt );
@@ -2196,6 +2238,23 @@ void save( Class const & c ) THROW_SPEC( exError )
     hd.appendChild( opt );
   }
 
+  {
+    QDomNode qs = dd.createElement( "queryServer" );
+    root.appendChild( qs );
+
+    QDomElement opt = dd.createElement( "enabled" );
+    opt.appendChild( dd.createTextNode( c.queryServer.enabled ? "1" : "0" ) );
+    qs.appendChild( opt );
+
+    opt = dd.createElement( "name" );
+    opt.appendChild( dd.createTextNode( c.queryServer.name ) );
+    qs.appendChild( opt );
+
+    opt = dd.createElement( "maxPendingRequests" );
+    opt.appendChild( dd.createTextNode( QString::number( c.queryServer.maxPendingRequests ) ) );
+    qs.appendChild( opt );
+  }
+
   QByteArray result( dd.toByteArray() );
 
   if ( configFile.write( result ) != result.size() )
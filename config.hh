@@ -336,6 +336,8 @@ struct Preferences
   bool disallowContentFromOtherSites;
   bool enableWebPlugins;
   bool hideGoldenDictHeader;
+  /// Fetch web site articles for the recent history words in background
+  bool prefetchWebSites;
   int maxNetworkCacheSize;
   bool clearNetworkCacheOnExit;
 
@@ -355,6 +357,9 @@ struct Preferences
   bool collapseBigArticles;
   int articleSizeLimit;
 
+  bool hibernateTabs; // Release the pages of the tabs not viewed for a while
+  int hibernateTabsAfter; // In minutes
+
   bool limitInputPhraseLength;
   int inputPhraseLengthLimit;
   InputPhrase sanitizeInputPhrase( QString const & inputPhrase ) const;
@@ -654,6 +659,18 @@ struct HeadwordsDialog
   {}
 };
 
+/// The local server answering the dictionary queries of other programs,
+/// such as editors and scripts
+struct QueryServer
+{
+  bool enabled;
+  QString name; // Of the local socket, a per-user one is used if empty
+  unsigned maxPendingRequests; // Per connection, the rest wait unread
+
+  QueryServer(): enabled( false ), maxPendingRequests( 16 )
+  {}
+};
+
 struct Class
 {
   Paths paths;
@@ -713,6 +730,8 @@ struct Class
 
   HeadwordsDialog headwordsDialog;
 
+  QueryServer queryServer;
+
 #ifdef Q_OS_WIN
   QRect maximizedMainWindowGeometry;
   QRect normalMainWindowGeometry;
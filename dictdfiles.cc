@@ -3,6 +3,7 @@
 
 #include "dictdfiles.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "utf8.hh"
 #include "dictzip.h"
@@ -264,16 +265,7 @@ sptr< Dictionary::DataRequest > DictdDictionary::getArticle( wstring const & wor
 {
   try
   {
-    vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-    for( unsigned x = 0; x < alts.size(); ++x )
-    {
-      /// Make an additional query for each alt
-
-      vector< WordArticleLink > altChain = findArticles( alts[ x ], ignoreDiacritics );
-
-      chain.insert( chain.end(), altChain.begin(), altChain.end() );
-    }
+    vector< WordArticleLink > chain = findArticles( word, alts, ignoreDiacritics );
 
     multimap< wstring, string > mainArticles, alternateArticles;
 
@@ -646,6 +638,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         // Building the index
         string dictionaryName = nameFromFileName( dictFiles[ 0 ] );
 
@@ -45,14 +45,35 @@ void DictInfo::showInfo( sptr<Dictionary::Class> dict )
 
   ui.dictionaryFileList->setPlainText( filenamesText );
 
-  QString info = dict->getDescription();
+  // The description may take a while to load, so the dialog is shown
+  // without waiting for it
+  ui.infoLabel->clear();
+
+  descriptionRequest = Dictionary::requestDescription( dict );
+
+  connect( descriptionRequest.get(), SIGNAL( finished() ),
+           this, SLOT( descriptionLoaded() ), Qt::QueuedConnection );
+
+  setWindowIcon( dict->getIcon() );
+}
+
+void DictInfo::descriptionLoaded()
+{
+  if( !descriptionRequest || !descriptionRequest->isFinished() || sender() != descriptionRequest.get() )
+    return;
+
+  QString info;
+
+  if( descriptionRequest->dataSize() > 0 )
+  {
+    std::vector< char > const & data = descriptionRequest->getFullData();
+    info = QString::fromUtf8( &data.front(), data.size() );
+  }
 
   if( !info.isEmpty() && info.compare( "NONE" ) != 0 )
     ui.infoLabel->setPlainText( info );
   else
     ui.infoLabel->clear();
-
-  setWindowIcon( dict->getIcon() );
 }
 
 void DictInfo::savePos( int )
@@ -26,8 +26,10 @@ public:
 private:
   Ui::DictInfo ui;
   Config::Class &cfg;
+  sptr< Dictionary::DataRequest > descriptionRequest;
 private slots:
   void savePos( int );
+  void descriptionLoaded();
   void on_editDictionary_clicked();
   void on_openFolder_clicked();
   void on_OKButton_clicked();
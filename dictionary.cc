@@ -18,10 +18,14 @@
 #include <QCryptographicHash>
 #include <QDateTime>
 #include "fsencoding.hh"
+#include "utf8.hh"
 #include "langcoder.hh"
 
 #include <QImage>
 #include <QPainter>
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
 #include <QRegularExpression>
 #else
@@ -33,6 +37,41 @@
 
 namespace Dictionary {
 
+namespace {
+
+/// getDescription() implementations fill in the description on the first
+/// call without any locking, so all the calls are made under this mutex
+Mutex & descriptionMutex()
+{
+  static Mutex mutex;
+  return mutex;
+}
+
+quint64 stringMemory( string const & str )
+{
+  return sizeof( str ) + str.capacity();
+}
+
+quint64 stringMemory( QString const & str )
+{
+  return sizeof( str ) + str.capacity() * sizeof( QChar );
+}
+
+/// Counts the pixmaps the icon has, or would have once painted
+quint64 iconMemory( QIcon const & icon )
+{
+  quint64 result = 0;
+
+  QList< QSize > sizes = icon.availableSizes();
+
+  for( int x = 0; x < sizes.size(); ++x )
+    result += (quint64) sizes[ x ].width() * sizes[ x ].height() * 4;
+
+  return result;
+}
+
+}
+
 bool Request::isFinished()
 {
   return Qt4x5::AtomicInt::loadAcquire( isFinishedFlag );
@@ -139,7 +178,9 @@ vector< char > & DataRequest::getFullData() THROW_SPEC( exRequestUnfinished )
 }
 
 Class::Class( string const & id_, vector< string > const & dictionaryFiles_ ):
-  id( id_ ), dictionaryFiles( dictionaryFiles_ ), dictionaryIconLoaded( false )
+  id( id_ ), dictionaryFiles( dictionaryFiles_ ),
+  metadataUsedAt( QDateTime::currentMSecsSinceEpoch() ), metadataReleased( false ),
+  dictionaryIconLoaded( false )
   , can_FTS( false), FTS_index_completed( false )
 {
 }
@@ -163,12 +204,23 @@ sptr< WordSearchRequest > Class::findHeadwordsForSynonym( wstring const & )
   return new WordSearchRequestInstant();
 }
 
+sptr< WordSearchRequest > Class::findHeadwords( vector< wstring > const & )
+  THROW_SPEC( std::exception )
+{
+  return new WordSearchRequestInstant();
+}
+
 vector< wstring > Class::getAlternateWritings( wstring const & )
   throw()
 {
   return vector< wstring >();
 }
 
+void Class::prepareAlternateWritings( vector< wstring > const & )
+  throw()
+{
+}
+
 sptr< DataRequest > Class::getResource( string const & /*name*/ )
   THROW_SPEC( std::exception )
 {
@@ -190,10 +242,91 @@ QString Class::getMainFilename()
   return QString();
 }
 
+Class::MemoryUsage Class::getMemoryUsage()
+{
+  MemoryUsage result;
+
+  result.resident += stringMemory( id );
+
+  for( size_t x = 0; x < dictionaryFiles.size(); ++x )
+    result.resident += stringMemory( dictionaryFiles[ x ] );
+
+  {
+    Mutex::Lock _( descriptionMutex() );
+
+    result.evictable += stringMemory( dictionaryDescription );
+  }
+
+  {
+    Mutex::Lock _( isolatedCSSMutex );
+
+    for( QHash< QByteArray, QString >::const_iterator i = isolatedCSS.constBegin();
+         i != isolatedCSS.constEnd(); ++i )
+      result.evictable += i.key().size() + stringMemory( i.value() );
+  }
+
+  // The icons are only touched by the GUI thread, and so is this. The ones
+  // made from the resources are shared, but we count them anyway.
+  result.evictable += iconMemory( dictionaryIcon ) + iconMemory( dictionaryNativeIcon );
+
+  return result;
+}
+
+void Class::touchMetadata()
+{
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  Mutex::Lock _( metadataMutex );
+
+  metadataUsedAt = now;
+  metadataReleased = false;
+}
+
+bool Class::releaseIdleMetadata( int idleSecs, quint64 * releasedBytes )
+{
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  {
+    Mutex::Lock _( metadataMutex );
+
+    if ( metadataReleased || now - metadataUsedAt < (qint64) idleSecs * 1000 )
+      return false;
+
+    metadataReleased = true;
+  }
+
+  // Counting takes the locks the lookups use, so it's only done when needed
+  if ( releasedBytes )
+    *releasedBytes = getMemoryUsage().evictable;
+
+  releaseMetadata();
+
+  return true;
+}
+
+void Class::releaseMetadata()
+{
+  {
+    Mutex::Lock _( descriptionMutex() );
+
+    dictionaryDescription.clear();
+  }
+
+  {
+    Mutex::Lock _( isolatedCSSMutex );
+
+    isolatedCSS.clear();
+  }
+
+  dictionaryIcon = dictionaryNativeIcon = QIcon();
+  dictionaryIconLoaded = false;
+}
+
 QIcon const & Class::getIcon() throw()
 {
   if( !dictionaryIconLoaded )
     loadIcon();
+  touchMetadata();
   return dictionaryIcon;
 }
 
@@ -201,6 +334,7 @@ QIcon const & Class::getNativeIcon() throw()
 {
   if( !dictionaryIconLoaded )
     loadIcon();
+  touchMetadata();
   return dictionaryNativeIcon;
 }
 
@@ -282,6 +416,42 @@ void Class::isolateCSS( QString & css, QString const & wrapperSelector )
   if( css.isEmpty() )
     return;
 
+  // Dictionaries only have a few stylesheets, so keeping them all is cheap,
+  // but don't let some pathological dictionary grow the cache indefinitely
+  int const maxIsolatedCSS = 32;
+
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  hash.addData( wrapperSelector.toUtf8() );
+  hash.addData( "\0", 1 );
+  hash.addData( reinterpret_cast< char const * >( css.constData() ), css.size() * sizeof( QChar ) );
+  QByteArray key = hash.result();
+
+  touchMetadata();
+
+  {
+    Mutex::Lock _( isolatedCSSMutex );
+
+    QHash< QByteArray, QString >::const_iterator i = isolatedCSS.constFind( key );
+
+    if ( i != isolatedCSS.constEnd() )
+    {
+      css = i.value();
+      return;
+    }
+  }
+
+  css = makeIsolatedCSS( css, wrapperSelector );
+
+  Mutex::Lock _( isolatedCSSMutex );
+
+  if ( isolatedCSS.size() >= maxIsolatedCSS )
+    isolatedCSS.clear();
+
+  isolatedCSS.insert( key, css );
+}
+
+QString Class::makeIsolatedCSS( QString css, QString const & wrapperSelector )
+{
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
   QRegularExpression reg1( "\\/\\*(?:.(?!\\*\\/))*.?\\*\\/",
                            QRegularExpression::DotMatchesEverythingOption );
@@ -429,7 +599,309 @@ void Class::isolateCSS( QString & css, QString const & wrapperSelector )
     newCSS.append( ch );
     ++currentPos;
   }
-  css = newCSS;
+  return newCSS;
+}
+
+SharedDataRequests::SharedDataRequests( unsigned maxFinished_ ):
+  maxFinished( maxFinished_ )
+{
+}
+
+sptr< DataRequest > SharedDataRequests::acquire( string const & key )
+{
+  prune();
+
+  for( std::list< Entry >::iterator i = entries.begin(); i != entries.end(); ++i )
+  {
+    if ( i->key.empty() || i->key != key )
+      continue;
+
+    if ( i->request->isFinished() && !i->request->getErrorString().isEmpty() )
+    {
+      // Might succeed if asked again
+      if ( !i->users )
+        entries.erase( i );
+      else
+        i->key.clear();
+
+      return sptr< DataRequest >();
+    }
+
+    ++i->users;
+    entries.splice( entries.begin(), entries, i );
+
+    return i->request;
+  }
+
+  return sptr< DataRequest >();
+}
+
+void SharedDataRequests::add( string const & key, sptr< DataRequest > const & request )
+{
+  entries.push_front( Entry() );
+
+  Entry & entry = entries.front();
+
+  entry.key = key;
+  entry.request = request;
+  entry.users = 1;
+  entry.releasedAt = 0;
+}
+
+void SharedDataRequests::release( sptr< DataRequest > const & request )
+{
+  std::list< Entry >::iterator i;
+
+  for( i = entries.begin(); i != entries.end(); ++i )
+    if ( i->request.get() == request.get() )
+      break;
+
+  if ( i == entries.end() )
+  {
+    // Never shared
+    request->cancel();
+    return;
+  }
+
+  if ( --i->users )
+    return;
+
+  if ( !i->request->isFinished() )
+  {
+    // No one needs it anymore
+    i->request->cancel();
+    entries.erase( i );
+    return;
+  }
+
+  i->releasedAt = QDateTime::currentMSecsSinceEpoch();
+
+  prune();
+}
+
+void SharedDataRequests::clear()
+{
+  for( std::list< Entry >::iterator i = entries.begin(); i != entries.end(); )
+  {
+    if ( i->users )
+    {
+      // Still in use, would go once released
+      i->key.clear();
+      ++i;
+    }
+    else
+      entries.erase( i++ );
+  }
+}
+
+void SharedDataRequests::prune()
+{
+  qint64 oldest = QDateTime::currentMSecsSinceEpoch() - MaxFinishedAge * 1000;
+
+  unsigned finished = 0;
+
+  for( std::list< Entry >::iterator i = entries.begin(); i != entries.end(); )
+  {
+    if ( !i->users &&
+         ( i->key.empty() || i->releasedAt < oldest || ++finished > maxFinished ) )
+      entries.erase( i++ );
+    else
+      ++i;
+  }
+}
+
+string SharedDataRequests::makeArticleKey( Class & dict, wstring const & word,
+                                           vector< wstring > const & alts,
+                                           wstring const & context,
+                                           bool ignoreDiacritics )
+{
+  string key = dict.getId();
+
+  key.push_back( ignoreDiacritics ? '1' : '0' );
+  key.push_back( 0 );
+  key += Utf8::encode( word );
+
+  for( unsigned x = 0; x < alts.size(); ++x )
+  {
+    key.push_back( 0 );
+    key += Utf8::encode( alts[ x ] );
+  }
+
+  // The context is rarely given, so it goes last, after a separator which
+  // can't be confused with an alternate writing
+  key.push_back( 0 );
+  key.push_back( 1 );
+  key += Utf8::encode( context );
+
+  return key;
+}
+
+namespace {
+
+class DescriptionRequest;
+
+/// The state a description load shares with its request. It is owned by
+/// both the request and the runnable, and whichever of them is done last
+/// has it deleted on the GUI thread, so that the dictionary it keeps alive
+/// is released there. The request only detaches itself when destroyed, so
+/// it never has to wait for the load.
+class DescriptionLoad: public QObject
+{
+  QAtomicInt refs; // Of the request and the runnable
+
+public:
+
+  sptr< Class > dict; // Only copied and released on the GUI thread
+  Class * dictPtr; // What the runnable uses
+
+  QAtomicInt isCancelled;
+
+  Mutex requestMutex;
+  DescriptionRequest * request; // Zero once the request is gone
+
+  DescriptionLoad( sptr< Class > const & dict_, DescriptionRequest * request_ ):
+    refs( 2 ), dict( dict_ ), dictPtr( dict_.get() ), request( request_ )
+  {}
+
+  /// Drops the reference of the caller, the last one deletes the load
+  void release()
+  {
+    if ( !refs.deref() )
+      deleteLater();
+  }
+};
+
+class DescriptionRequestRunnable: public QRunnable
+{
+  DescriptionLoad * load;
+
+public:
+
+  DescriptionRequestRunnable( DescriptionLoad * load_ ): load( load_ )
+  {}
+
+  ~DescriptionRequestRunnable()
+  {
+    load->release();
+  }
+
+  virtual void run();
+};
+
+class DescriptionRequest: public DataRequest
+{
+  DescriptionLoad * load;
+
+public:
+
+  DescriptionRequest( sptr< Class > const & dict ):
+    load( new DescriptionLoad( dict, this ) )
+  {
+    QThreadPool::globalInstance()->start( new DescriptionRequestRunnable( load ) );
+  }
+
+  /// Called from the runnable with the description loaded
+  void deliver( QByteArray const & description )
+  {
+    {
+      Mutex::Lock _( dataMutex );
+
+      data.assign( description.constData(), description.constData() + description.size() );
+      hasAnyData = true;
+    }
+
+    finish();
+  }
+
+  virtual void cancel()
+  {
+    load->isCancelled.ref();
+  }
+
+  ~DescriptionRequest()
+  {
+    load->isCancelled.ref();
+
+    {
+      Mutex::Lock _( load->requestMutex );
+      load->request = 0;
+    }
+
+    load->release();
+  }
+};
+
+/// The descriptions are cached next to the indices, since loading some of
+/// them means parsing the dictionary files. Returns an empty string for the
+/// dictionaries having no files of their own.
+QString descriptionCacheName( Class & dict )
+{
+  if ( dict.getDictionaryFilenames().empty() )
+    return QString();
+
+  try
+  {
+    return Config::getIndexDir() + QString::fromUtf8( dict.getId().c_str() ) + "_DESC";
+  }
+  catch( std::exception & )
+  {
+    return QString();
+  }
+}
+
+void DescriptionRequestRunnable::run()
+{
+  QByteArray description;
+
+  if ( !Qt4x5::AtomicInt::loadAcquire( load->isCancelled ) )
+  {
+    Class & dict = *load->dictPtr;
+
+    dict.touchMetadata();
+
+    QString cacheName = descriptionCacheName( dict );
+
+    Mutex::Lock _( descriptionMutex() );
+
+    bool cached = !cacheName.isEmpty()
+                  && !needToRebuildIndex( dict.getDictionaryFilenames(),
+                                          FsEncoding::encode( cacheName ) );
+
+    if ( cached )
+    {
+      QFile file( cacheName );
+
+      if ( file.open( QFile::ReadOnly ) )
+        description = file.readAll();
+      else
+        cached = false;
+    }
+
+    if ( !cached )
+    {
+      description = dict.getDescription().toUtf8();
+
+      if ( !cacheName.isEmpty() )
+      {
+        QFile file( cacheName );
+
+        if ( file.open( QFile::WriteOnly | QFile::Truncate ) )
+          file.write( description );
+      }
+    }
+  }
+
+  Mutex::Lock _( load->requestMutex );
+
+  if ( load->request )
+    load->request->deliver( description );
+}
+
+}
+
+sptr< DataRequest > requestDescription( sptr< Class > const & dict )
+{
+  return new DescriptionRequest( dict );
 }
 
 string makeDictionaryId( vector< string > const & dictionaryFiles ) throw()
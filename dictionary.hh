@@ -7,8 +7,11 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <list>
 #include <QObject>
 #include <QIcon>
+#include <QHash>
+#include <QByteArray>
 #include "cpp_features.hh"
 #include "sptr.hh"
 #include "ex.hh"
@@ -279,6 +282,18 @@ class Class
   string id;
   vector< string > dictionaryFiles;
 
+  /// Results of isolateCSS(), keyed by the hash of its arguments
+  Mutex isolatedCSSMutex;
+  QHash< QByteArray, QString > isolatedCSS;
+
+  /// Does the actual work of isolateCSS()
+  QString makeIsolatedCSS( QString css, QString const & wrapperSelector );
+
+  /// When the metadata was last used, see touchMetadata()
+  Mutex metadataMutex;
+  qint64 metadataUsedAt; // Msecs since epoch
+  bool metadataReleased;
+
 protected:
   QString dictionaryDescription;
   QIcon dictionaryIcon, dictionaryNativeIcon;
@@ -295,11 +310,32 @@ protected:
   // else treat filename as name without extension
   bool loadIconFromFile( QString const & filename, bool isFullName = false );
 
-  /// Make css content usable only for articles from this dictionary
+  /// Make css content usable only for articles from this dictionary.
+  /// The results are remembered, so each distinct stylesheet is only
+  /// rewritten once during the dictionary's lifetime.
   void isolateCSS( QString & css, QString const & wrapperSelector = QString() );
 
+  /// Does the actual work of releaseIdleMetadata(), dropping the
+  /// description, the icons and the isolated stylesheets. The backends
+  /// keeping rarely used data of their own, loaded on demand, override this
+  /// to drop it as well, calling the base implementation.
+  virtual void releaseMetadata();
+
 public:
 
+  /// The memory held by a dictionary, in bytes
+  struct MemoryUsage
+  {
+    quint64 resident; // Kept for as long as the dictionary lives
+    quint64 evictable; // Loaded on demand, dropped by releaseIdleMetadata()
+
+    MemoryUsage(): resident( 0 ), evictable( 0 )
+    {}
+
+    quint64 total() const
+    { return resident + evictable; }
+  };
+
   /// Creates a dictionary. The id should be made using
   /// Format::makeDictionaryId(), the dictionaryFiles is the file names the
   /// dictionary consists of.
@@ -387,6 +423,14 @@ public:
   virtual sptr< WordSearchRequest > findHeadwordsForSynonym( wstring const & )
     THROW_SPEC( std::exception );
 
+  /// Looks up all the given words at once and returns those of them which are
+  /// headwords of the dictionary, ignoring the case. The matches are the very
+  /// words passed, so the caller could tell which ones were found. Used by the
+  /// compound expressions search to check all the candidates in one pass.
+  /// The default implementation always returns an empty result.
+  virtual sptr< WordSearchRequest > findHeadwords( vector< wstring > const & )
+    THROW_SPEC( std::exception );
+
   /// For a given word, provides alternate writings of it which are to be looked
   /// up alongside with it. Transliteration dictionaries implement this. The
   /// default implementation returns an empty list. Note that this function is
@@ -394,6 +438,13 @@ public:
   /// synchronously.
   virtual vector< wstring > getAlternateWritings( wstring const & )
     throw();
+
+  /// Hints that getAlternateWritings() is about to be called for each of the
+  /// given words. Dictionaries with a costly per-call conversion use this to
+  /// process the whole list at once and cache the results. The default
+  /// implementation does nothing.
+  virtual void prepareAlternateWritings( vector< wstring > const & )
+    throw();
   
   /// Returns a definition for the given word. The definition should
   /// be an html fragment (without html/head/body tags) in an utf8 encoding.
@@ -408,6 +459,13 @@ public:
                                           bool ignoreDiacritics = false )
     THROW_SPEC( std::exception )=0;
 
+  /// Returns false if the dictionary is known to have no articles for the
+  /// given word, so that getArticle() could be skipped. This is a quick
+  /// check which can't be sure the word is there. The default implementation
+  /// always returns true.
+  virtual bool mayHaveArticles( wstring const & )
+  { return true; }
+
   /// Loads contents of a resource named 'name' into the 'data' vector. This is
   /// usually a picture file referenced in the article or something like that.
   /// The default implementation always returns the non-existing resource
@@ -429,6 +487,24 @@ public:
   // Return dictionary main file name
   virtual QString getMainFilename();
 
+  /// Returns an estimate of the memory held by the dictionary itself, not
+  /// counting its requests and the files it has mapped. The backends add
+  /// what they keep to what the base implementation counts.
+  virtual MemoryUsage getMemoryUsage();
+
+  /// Tells that the metadata was just used, so that it isn't released too
+  /// soon. The icons and the description count themselves; the backends
+  /// call this when they use the metadata of their own.
+  void touchMetadata();
+
+  /// Releases the rarely used data loaded on demand, such as the
+  /// description, the icons, the stylesheets and the abbreviations, unless
+  /// it was used within the given number of seconds. It gets loaded again
+  /// once needed. Must be called from the GUI thread, since the icons are
+  /// used there without any locking. Returns true if anything was released,
+  /// storing the estimate of the memory released to releasedBytes if given.
+  bool releaseIdleMetadata( int idleSecs, quint64 * releasedBytes = 0 );
+
   /// Check text direction
   bool isFromLanguageRTL()
   { return LangCoder::isLanguageRTL( getLangFrom() ); }
@@ -482,6 +558,74 @@ public:
   {}
 };
 
+/// Shares the data requests made with the same parameters, as told by their
+/// keys, among their users, so that the identical lookups made at once,
+/// e.g. by the main window and the popup, are only done once. A request
+/// still running is cancelled once no one needs it anymore. A few of the
+/// finished ones are kept for a short while, since the same things are often
+/// asked for again soon. The requests which failed are never reused. Not
+/// thread-safe, meant to be used from the GUI thread.
+class SharedDataRequests
+{
+public:
+
+  /// The finished requests no one uses are dropped after this many seconds
+  enum { MaxFinishedAge = 60 };
+
+  /// At most maxFinished finished requests no one uses are kept
+  explicit SharedDataRequests( unsigned maxFinished );
+
+  /// Returns the request with the given key, if there's one running or
+  /// recently finished, counting the caller as its user. Returns an empty
+  /// pointer otherwise.
+  sptr< DataRequest > acquire( string const & key );
+
+  /// Stores the request just made under the given key, with the caller
+  /// being its only user.
+  void add( string const & key, sptr< DataRequest > const & );
+
+  /// Tells that the request acquired or added before is no longer needed by
+  /// its user. The requests not stored here are cancelled right away.
+  void release( sptr< DataRequest > const & );
+
+  /// Drops all the requests no one uses, and makes sure the ones in use
+  /// won't be reused. Should be called when the dictionaries get reloaded.
+  void clear();
+
+  /// Makes the key for the article request with the given parameters
+  static string makeArticleKey( Class &, wstring const & word,
+                                vector< wstring > const & alts,
+                                wstring const & context,
+                                bool ignoreDiacritics );
+
+private:
+
+  struct Entry
+  {
+    string key;
+    sptr< DataRequest > request;
+    unsigned users;
+    qint64 releasedAt; // msecs since epoch
+  };
+
+  unsigned maxFinished;
+  std::list< Entry > entries; // Most recently used first
+
+  /// Drops the finished requests no one uses which are too old or too many
+  void prune();
+};
+
+/// Loads the description of the given dictionary in the thread pool, since
+/// some dictionaries have to read and parse their files to provide it, which
+/// would otherwise block the GUI. The request's data is the utf8-encoded
+/// description, as returned by Class::getDescription(). Since the
+/// dictionaries load their descriptions lazily, the calls made through this
+/// function are serialized, and the GUI code should always use it instead of
+/// calling getDescription() directly. The descriptions are also cached in the
+/// index directory, so they are only loaded again when the dictionary files
+/// change. Destroying the request doesn't wait for the load to end.
+sptr< DataRequest > requestDescription( sptr< Class > const & );
+
 /// Generates an id based on the set of file names which the dictionary
 /// consists of. The resulting id is an alphanumeric hex value made by
 /// hashing the file names. This id should be used to identify dictionary
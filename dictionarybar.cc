@@ -3,6 +3,7 @@
 #include <QApplication>
 #include <QMenu>
 #include <QContextMenuEvent>
+#include <QSet>
 #include <QProcess>
 #include "gddebug.hh"
 #include "fsencoding.hh"
@@ -50,43 +51,111 @@ static QString elideDictName( QString const & name )
 void DictionaryBar::setDictionaries( vector< sptr< Dictionary::Class > >
                                      const & dictionaries )
 {
-  setUpdatesEnabled( false );
+  // The dictionaries may have been reloaded since the actions were made, in
+  // which case their names and icons are to be refreshed
+  QSet< Dictionary::Class const * > knownDicts;
+
+  for( unsigned x = 0; x < allDictionaries.size(); ++x )
+    knownDicts.insert( allDictionaries[ x ].get() );
 
-  allDictionaries.clear();
   allDictionaries = dictionaries;
 
-  clear();
-  dictActions.clear();
+  QList< QAction * > newActions;
+  QSet< QString > newIds;
 
-  use14x21 = false;
+  bool sameActions = dictActions.size() == (int)dictionaries.size();
 
   for( unsigned x = 0; x < dictionaries.size(); ++x )
   {
-    QIcon icon = dictionaries[ x ]->getNativeIcon();
+    QString id = QString::fromStdString( dictionaries[ x ]->getId() );
 
-    QString dictName = QString::fromUtf8( dictionaries[ x ]->
-                                            getName().c_str() );
+    QAction * action = dictActionsById.value( id );
 
-    QAction * action = addAction( icon, elideDictName( dictName ) );
+    if ( !action || !knownDicts.contains( dictionaries[ x ].get() ) )
+    {
+      if ( !action )
+      {
+        action = new QAction( this );
 
-    action->setToolTip( dictName ); // Tooltip need not be shortened
+        action->setData( id );
 
-    QString id = QString::fromStdString( dictionaries[ x ]->getId() );
+        action->setCheckable( true );
 
-    action->setData( id );
+        dictActionsById.insert( id, action );
+      }
 
-    action->setCheckable( true );
+      QString dictName = QString::fromUtf8( dictionaries[ x ]->
+                                              getName().c_str() );
+
+      action->setIcon( dictionaries[ x ]->getNativeIcon() );
+
+      action->setText( elideDictName( dictName ) );
+
+      action->setToolTip( dictName ); // Tooltip need not be shortened
+
+      sameActions = false;
+    }
 
     action->setChecked( mutedDictionaries ? !mutedDictionaries->contains( id ) : true );
 
-    QList< QSize > sizes = icon.availableSizes();
+    if ( sameActions && dictActions[ x ] != action )
+      sameActions = false;
 
-    for( QList< QSize >::iterator i = sizes.begin(); i != sizes.end();
-         ++i )
-      if ( i->width() == 14 && i->height() == 21 )
-        use14x21 = true;
+    newActions.append( action );
+    newIds.insert( id );
+  }
+
+  if ( sameActions )
+    return; // Only the checked states could have changed
+
+  setUpdatesEnabled( false );
+
+  // Drop the actions of the dictionaries which aren't shown anymore
 
-    dictActions.append( action );
+  for( QList< QAction * >::iterator i = dictActions.begin();
+       i != dictActions.end(); ++i )
+  {
+    QString id = (*i)->data().toString();
+
+    if ( !newIds.contains( id ) )
+    {
+      removeAction( *i );
+      dictActionsById.remove( id );
+      delete *i;
+    }
+  }
+
+  // Arrange the actions in the new order. The ones already in their places
+  // are left alone, so the toolbar doesn't recreate their buttons.
+
+  QList< QAction * > current = actions();
+
+  for( int x = 0; x < newActions.size(); ++x )
+  {
+    QAction * action = newActions[ x ];
+
+    if ( x < current.size() && current[ x ] == action )
+      continue;
+
+    insertAction( x < current.size() ? current[ x ] : 0, action );
+
+    current.removeOne( action );
+    current.insert( x, action );
+  }
+
+  dictActions = newActions;
+
+  use14x21 = false;
+
+  for( QList< QAction * >::iterator i = dictActions.begin();
+       i != dictActions.end() && !use14x21; ++i )
+  {
+    QList< QSize > sizes = (*i)->icon().availableSizes();
+
+    for( QList< QSize >::iterator j = sizes.begin(); j != sizes.end();
+         ++j )
+      if ( j->width() == 14 && j->height() == 21 )
+        use14x21 = true;
   }
 
   setDictionaryIconSize( 21 );
@@ -351,16 +420,10 @@ void DictionaryBar::dictsPaneClicked( const QString & id )
   if ( !isVisible() )
     return;
 
-  for( QList< QAction * >::iterator i = dictActions.begin();
-       i != dictActions.end(); ++i )
-  {
-    QString dictId = (*i)->data().toString();
-    if ( dictId == id )
-    {
-      (*i)->activate( QAction::Trigger );
-      break;
-    }
-  }
+  QAction * action = dictActionsById.value( id );
+
+  if ( action )
+    action->activate( QAction::Trigger );
 }
 
 bool DictionaryBar::eventFilter( QObject * obj, QEvent * ev )
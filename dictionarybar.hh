@@ -4,6 +4,7 @@
 #include <QToolBar>
 #include <QSize>
 #include <QList>
+#include <QHash>
 #include <QString>
 #include <QTimer>
 #include "dictionary.hh"
@@ -22,7 +23,9 @@ public:
                  Config::Events &, QString const & _editDictionaryCommand, unsigned short const & maxDictionaryRefsInContextMenu_ );
 
   /// Sets dictionaries to be displayed in the bar. Their statuses (enabled/
-  /// disabled) are taken from the configuration data.
+  /// disabled) are taken from the configuration data. The actions of the
+  /// dictionaries which were already displayed are kept, so only the
+  /// difference between the old and the new set is created or destroyed.
   void setDictionaries( std::vector< sptr< Dictionary::Class > > const & );
   void setMutedDictionaries( Config::MutedDictionaries * mutedDictionaries_ )
   { mutedDictionaries = mutedDictionaries_; }
@@ -59,6 +62,8 @@ private:
   std::vector< sptr< Dictionary::Class > > allDictionaries;
   /// All the actions we have added to the toolbar
   QList< QAction * > dictActions;
+  /// The same actions, indexed by the dictionary ids
+  QHash< QString, QAction * > dictActionsById;
   QAction * maxDictionaryRefsAction;
 
   bool use14x21;
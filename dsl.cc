@@ -4,6 +4,7 @@
 #include "dsl.hh"
 #include "dsl_details.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "utf8.hh"
 #include "chunkedstorage.hh"
@@ -159,7 +160,9 @@ class DslDictionary: public BtreeIndexing::BtreeDictionary
   sptr< ChunkedStorage::Reader > chunks;
   string dictionaryName;
   string preferredSoundDictionary;
-  map< string, string > abrv;
+  Mutex abrvMutex; // Guards abrv and abrvLoaded
+  map< string, string > abrv; // Loaded on demand, see findAbrv()
+  bool abrvLoaded;
   Mutex dzMutex;
   dictData * dz;
   Mutex resourceZipMutex;
@@ -258,15 +261,27 @@ public:
   virtual uint32_t getFtsIndexVersion()
   { return CurrentFtsIndexVersion; }
 
+  virtual MemoryUsage getMemoryUsage();
+
 protected:
 
   virtual void loadIcon() throw();
 
+  virtual void releaseMetadata();
+
 private:
 
   virtual string const & ensureInitDone();
   void doDeferredInit();
 
+  /// Looks up the given abbreviation, loading the abbreviations from the
+  /// index on first use. Returns false if there's no such one. The caller
+  /// touches the metadata, once per article.
+  bool findAbrv( string const & key, string & value );
+
+  /// Loads the abbreviations. Expects abrvMutex to be locked.
+  void loadAbrv();
+
   /// Loads the article. Does not process the DSL language.
   void loadArticle( uint32_t address,
                     wstring const & requestedHeadwordFolded,
@@ -299,6 +314,7 @@ DslDictionary::DslDictionary( string const & id,
   BtreeDictionary( id, dictionaryFiles ),
   idx( indexFile, "rb" ),
   idxHeader( idx.read< IdxHeader >() ),
+  abrvLoaded( false ),
   dz( 0 ),
   deferredInitRunnableStarted( false ),
   optionalPartNom( 0 ),
@@ -433,39 +449,7 @@ void DslDictionary::doDeferredInit()
         throw exDictzipError( string( dz_error_str( error ) )
                               + "(" + getDictionaryFilenames()[ 0 ] + ")" );
 
-      // Read the abrv, if any
-
-      if ( idxHeader.hasAbrv )
-      {
-        vector< char > chunk;
-
-        char * abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
-
-        uint32_t total;
-        memcpy( &total, abrvBlock, sizeof( uint32_t ) );
-        abrvBlock += sizeof( uint32_t );
-
-        GD_DPRINTF( "Loading %u abbrv\n", total );
-
-        while( total-- )
-        {
-          uint32_t keySz;
-          memcpy( &keySz, abrvBlock, sizeof( uint32_t ) );
-          abrvBlock += sizeof( uint32_t );
-
-          char * key = abrvBlock;
-
-          abrvBlock += keySz;
-
-          uint32_t valueSz;
-          memcpy( &valueSz, abrvBlock, sizeof( uint32_t ) );
-          abrvBlock += sizeof( uint32_t );
-
-          abrv[ string( key, keySz ) ] = string( abrvBlock, valueSz );
-
-          abrvBlock += valueSz;
-        }
-      }
+      // The abrv, if any, is read once needed, see findAbrv()
 
       // Initialize the index
 
@@ -528,6 +512,92 @@ void DslDictionary::loadIcon() throw()
   dictionaryIconLoaded = true;
 }
 
+bool DslDictionary::findAbrv( string const & key, string & value )
+{
+  if ( !idxHeader.hasAbrv )
+    return false;
+
+  Mutex::Lock _( abrvMutex );
+
+  if ( !abrvLoaded )
+    loadAbrv();
+
+  map< string, string >::const_iterator i = abrv.find( key );
+
+  if ( i == abrv.end() )
+    return false;
+
+  value = i->second;
+
+  return true;
+}
+
+void DslDictionary::loadAbrv()
+{
+  vector< char > chunk;
+
+  char * abrvBlock;
+
+  {
+    Mutex::Lock _( idxMutex );
+
+    abrvBlock = chunks->getBlock( idxHeader.abrvAddress, chunk );
+  }
+
+  uint32_t total;
+  memcpy( &total, abrvBlock, sizeof( uint32_t ) );
+  abrvBlock += sizeof( uint32_t );
+
+  GD_DPRINTF( "Loading %u abbrv\n", total );
+
+  while( total-- )
+  {
+    uint32_t keySz;
+    memcpy( &keySz, abrvBlock, sizeof( uint32_t ) );
+    abrvBlock += sizeof( uint32_t );
+
+    char * key = abrvBlock;
+
+    abrvBlock += keySz;
+
+    uint32_t valueSz;
+    memcpy( &valueSz, abrvBlock, sizeof( uint32_t ) );
+    abrvBlock += sizeof( uint32_t );
+
+    abrv[ string( key, keySz ) ] = string( abrvBlock, valueSz );
+
+    abrvBlock += valueSz;
+  }
+
+  abrvLoaded = true;
+}
+
+void DslDictionary::releaseMetadata()
+{
+  BtreeDictionary::releaseMetadata();
+
+  Mutex::Lock _( abrvMutex );
+
+  abrv.clear();
+  abrvLoaded = false;
+}
+
+Dictionary::Class::MemoryUsage DslDictionary::getMemoryUsage()
+{
+  MemoryUsage result = BtreeDictionary::getMemoryUsage();
+
+  result.resident += dictionaryName.capacity() + preferredSoundDictionary.capacity()
+                     + resourceDir1.capacity() + resourceDir2.capacity();
+
+  Mutex::Lock _( abrvMutex );
+
+  for( map< string, string >::const_iterator i = abrv.begin(); i != abrv.end(); ++i )
+    result.evictable += sizeof( *i ) + i->first.capacity() + i->second.capacity()
+                        + 4 * sizeof( void * ); // The tree node
+
+  return result;
+}
+
 /// Determines whether or not this char is treated as whitespace for dsl
 /// parsing or not. We can't rely on any Unicode standards here, since the
 /// only standard that matters here is the original Dsl compiler's insides.
@@ -791,6 +861,9 @@ string DslDictionary::dslToHtml( wstring const & str, wstring const & headword )
 
   optionalPartNom = 0;
 
+  if ( idxHeader.hasAbrv )
+    touchMetadata(); // For findAbrv()
+
   string html = processNodeChildren( dom.root );
 
   return html;
@@ -1061,19 +1134,19 @@ string DslDictionary::nodeToHtml( ArticleDom::Node const & node )
 
     // If we have such a key, display a title
 
-    map< string, string >::const_iterator i = abrv.find( val );
+    string abrvValue;
 
-    if ( i != abrv.end() )
+    if ( findAbrv( val, abrvValue ) )
     {
       string title;
 
-      if ( Utf8::decode( i->second ).size() < 70 )
+      if ( Utf8::decode( abrvValue ).size() < 70 )
       {
         // Replace all spaces with non-breakable ones, since that's how
         // Lingvo shows tooltips
-        title.reserve( i->second.size() );
+        title.reserve( abrvValue.size() );
 
-        for( char const * c = i->second.c_str(); *c; ++c )
+        for( char const * c = abrvValue.c_str(); *c; ++c )
         {
           if ( *c == ' ' || *c == '\t' )
           {
@@ -1093,7 +1166,7 @@ string DslDictionary::nodeToHtml( ArticleDom::Node const & node )
         }
       }
       else
-        title = i->second;
+        title = abrvValue;
 
       result += " title=\"" + Html::escape( title ) + "\"";
     }
@@ -1695,16 +1768,7 @@ void DslArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   // Some synonyms make it that the articles appear several times. We combat
   // this by only allowing them to appear once. Dsl treats different headwords
@@ -2121,6 +2185,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile, zipFileName.size() ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         DslScanner scanner( *i );
 
         try { // Here we intercept any errors during the read to save line at
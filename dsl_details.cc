@@ -9,6 +9,10 @@
 #include "ufile.hh"
 #include "wstring_qt.hh"
 #include "utf8.hh"
+#include "fsencoding.hh"
+#include "indexingstats.hh"
+
+#include <QFileInfo>
 
 #include <stdio.h>
 #include <wctype.h>
@@ -824,7 +828,9 @@ bool ArticleDom::atSignFirstInLine()
 
 DslScanner::DslScanner( string const & fileName ) THROW_SPEC( Ex, Iconv::Ex ):
   encoding( Windows1252 ), iconv( encoding ), readBufferPtr( readBuffer ),
-  readBufferLeft( 0 ), wcharBuffer( 64 ), linesRead( 0 )
+  readBufferLeft( 0 ), wcharBuffer( 64 ), linesRead( 0 ),
+  fileSize( QFileInfo( FsEncoding::decode( fileName.c_str() ) ).size() ),
+  inputCounted( 0 ), fileCounted( false )
 {
   // Since .dz is backwards-compatible with .gz, we use gz- functions to
   // read it -- they are much nicer than the dict_data- ones.
@@ -994,6 +1000,32 @@ DslScanner::~DslScanner() throw()
   gzclose( f );
 }
 
+void DslScanner::countInput()
+{
+  // The scanner is made before the indexing begins, so the file is only
+  // counted once it's read for the index
+  if ( !IndexingStats::isCounting() )
+    return;
+
+  if ( !fileCounted )
+  {
+    IndexingStats::addSourceFile( fileSize );
+    fileCounted = true;
+  }
+
+#if ZLIB_VERNUM >= 0x1240
+  z_off_t offset = gzoffset( f ); // Of the compressed data, as is the size
+#else
+  z_off_t offset = gztell( f );
+#endif
+
+  if ( offset > inputCounted )
+  {
+    IndexingStats::add( IndexingStats::BytesRead, offset - inputCounted );
+    inputCounted = offset;
+  }
+}
+
 bool DslScanner::readNextLine( wstring & out, size_t & offset ) THROW_SPEC( Ex,
                                                                        Iconv::Ex )
 {
@@ -1026,6 +1058,8 @@ bool DslScanner::readNextLine( wstring & out, size_t & offset ) THROW_SPEC( Ex,
 
         readBufferPtr = readBuffer;
         readBufferLeft += (size_t) result;
+
+        countInput();
       }
     }
 
@@ -128,6 +128,12 @@ class DslScanner
   size_t readBufferLeft;
   vector< wchar > wcharBuffer;
   unsigned linesRead;
+  qint64 fileSize;
+  z_off_t inputCounted; // The part of the file counted as read
+  bool fileCounted;
+
+  /// Counts the file input read so far for the indexing stats
+  void countInput();
 
 public:
 
@@ -14,6 +14,7 @@
 #include <string>
 
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "gddebug.hh"
 #include "fsencoding.hh"
@@ -500,16 +501,7 @@ void EpwingArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1023,6 +1015,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
           if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
                  indexIsOldOrBad( indexFile ) )
           {
+            IndexingStats::EndOfBuild endOfBuild;
+
             gdDebug( "Epwing: Building the index for dictionary in directory %s\n", dir.toUtf8().data() );
 
             QString str = dict.title();
@@ -20,6 +20,7 @@
 #include "ufile.hh"
 #include "fsencoding.hh"
 #include "zipfile.hh"
+#include "indexingstats.hh"
 
 namespace File {
 
@@ -108,6 +109,9 @@ void Class::open( char const * filename, char const * mode ) THROW_SPEC( exCantO
 
   if ( !f.open( openMode ) )
     throw exCantOpen( std::string( filename ) + ": " + f.errorString().toUtf8().data() );
+
+  if ( !( openMode & QIODevice::WriteOnly ) )
+    IndexingStats::addSourceFile( f.size() );
 }
 
 Class::Class( char const * filename, char const * mode ) THROW_SPEC( exCantOpen ):
@@ -134,6 +138,8 @@ void Class::read( void * buf, qint64 size ) THROW_SPEC( exReadError, exWriteErro
 
   if ( result != size )
     throw exReadError();
+
+  IndexingStats::add( IndexingStats::BytesRead, size );
 }
 
 size_t Class::readRecords( void * buf, qint64 size, size_t count ) THROW_SPEC( exWriteError )
@@ -142,6 +148,10 @@ size_t Class::readRecords( void * buf, qint64 size, size_t count ) THROW_SPEC( e
     flushWriteBuffer();
 
   qint64 result = f.read( reinterpret_cast<char *>( buf ), size * count );
+
+  if ( result > 0 )
+    IndexingStats::add( IndexingStats::BytesRead, result );
+
   return result < 0 ? result : result / size;
 }
 
@@ -210,6 +220,9 @@ char * Class::gets( char * s, int size, bool stripNl )
   qint64 len = f.readLine( s, size );
   char * result = len > 0 ? s : NULL;
 
+  if ( result )
+    IndexingStats::add( IndexingStats::BytesRead, len );
+
   if ( result && stripNl )
   {
     
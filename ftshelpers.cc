@@ -8,6 +8,7 @@
 #include "gddebug.hh"
 #include "folding.hh"
 #include "qt4x5.hh"
+#include "indexingstats.hh"
 
 #include <vector>
 #include <string>
@@ -302,6 +303,8 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
   if( Qt4x5::AtomicInt::loadAcquire( isCancelled ) )
     throw exUserAbort();
 
+  IndexingStats::Scope stats( dict->getName(), "fts" );
+
   File::Class ftsIdx( dict->ftsIndexName(), "wb" );
 
   FtsIdxHeader ftsIdxHeader;
@@ -343,6 +346,8 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
 
   dict->sortArticlesOffsetsForFTS( offsets, isCancelled );
 
+  IndexingStats::setExpectedArticles( offsets.size() );
+
   QMap< QString, QVector< uint32_t > > ftsWords;
 
   bool needHandleBrackets;
@@ -362,6 +367,8 @@ void makeFTSIndex( BtreeIndexing::BtreeDictionary * dict, QAtomicInt & isCancell
     dict->getArticleText( offsets.at( i ), headword, articleStr );
 
     parseArticleForFts( offsets.at( i ), articleStr, ftsWords, needHandleBrackets );
+
+    IndexingStats::add( IndexingStats::Articles );
   }
 
   // Free memory
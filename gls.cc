@@ -7,6 +7,7 @@
 #include "dictionary.hh"
 #include "ufile.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "gddebug.hh"
 #include "utf8.hh"
@@ -1207,16 +1208,7 @@ void GlsArticleRequest::run()
   }
   try
   {
-    vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-    for( unsigned x = 0; x < alts.size(); ++x )
-    {
-      /// Make an additional query for each alt
-
-      vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-      chain.insert( chain.end(), altChain.begin(), altChain.end() );
-    }
+    vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
     multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1611,6 +1603,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile, zipFileName.size() ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         GlsScanner scanner( *i );
 
         try { // Here we intercept any errors during the read to save line at
@@ -376,7 +376,12 @@ HEADERS += folding.hh \
     splitfile.hh \
     favoritespanewidget.hh \
     cpp_features.hh \
-    treeview.hh
+    treeview.hh \
+    bloomfilter.hh \
+    indexingstats.hh \
+    lookupstats.hh \
+    lookuptrace.hh \
+    lookupreplay.hh
 
 FORMS += groups.ui \
     dictgroupwidget.ui \
@@ -411,6 +416,7 @@ SOURCES += folding.cc \
     stardict.cc \
     chunkedstorage.cc \
     xdxf2html.cc \
+    xdxf2html_dom.cc \
     iconv.cc \
     lsa.cc \
     htmlescape.cc \
@@ -506,7 +512,12 @@ SOURCES += folding.cc \
     gls.cc \
     splitfile.cc \
     favoritespanewidget.cc \
-    treeview.cc
+    treeview.cc \
+    bloomfilter.cc \
+    indexingstats.cc \
+    lookupstats.cc \
+    lookuptrace.cc \
+    lookupreplay.cc
 
 win32 {
     FORMS   += texttospeechsource.ui
@@ -544,8 +555,10 @@ unix:!mac {
 }
 
 greaterThan(QT_MAJOR_VERSION, 4) {
-    HEADERS += wildcard.hh
-    SOURCES += wildcard.cc
+    HEADERS += wildcard.hh \
+               queryserver.hh
+    SOURCES += wildcard.cc \
+               queryserver.cc
 }
 
 CONFIG( zim_support ) {
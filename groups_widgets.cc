@@ -20,6 +20,8 @@
 #include <QFileDialog>
 #include <QMessageBox>
 
+#include <set>
+
 using std::vector;
 
 /// DictGroupWidget
@@ -170,6 +172,9 @@ void DictListModel::populate(
   dictionaries = active;
   allDicts = &available;
 
+  itemsData.clear();
+  allDictsIndex.clear();
+
   beginResetModel();
   endResetModel();
 }
@@ -178,6 +183,7 @@ void DictListModel::populate(
   std::vector< sptr< Dictionary::Class > > const & active )
 {
   dictionaries = active;
+  itemsData.clear();
   beginResetModel();
   endResetModel();
 }
@@ -208,6 +214,64 @@ int DictListModel::rowCount( QModelIndex const & ) const
   return dictionaries.size();
 }
 
+DictListModel::ItemData & DictListModel::itemData( Dictionary::Class * item ) const
+{
+  QHash< Dictionary::Class const *, ItemData >::iterator i = itemsData.find( item );
+
+  if ( i == itemsData.end() )
+  {
+    i = itemsData.insert( item, ItemData() );
+    i->name = QString::fromUtf8( item->getName().c_str() );
+  }
+
+  return *i;
+}
+
+sptr< Dictionary::Class > DictListModel::findAvailable( std::string const & id ) const
+{
+  if ( !allDicts )
+    return sptr< Dictionary::Class >();
+
+  // The vector is owned by someone else and may change at any time, e.g.
+  // while the dictionaries are still being loaded, so the positions are
+  // checked and found anew once they don't match
+
+  bool rebuilt = false;
+
+  if ( allDictsIndex.isEmpty() || allDictsIndexSize != allDicts->size() )
+  {
+    rebuildAllDictsIndex();
+    rebuilt = true;
+  }
+
+  QString key = QString::fromStdString( id );
+
+  for( ; ; )
+  {
+    QHash< QString, int >::const_iterator i = allDictsIndex.constFind( key );
+
+    if ( i != allDictsIndex.constEnd() && (size_t) i.value() < allDicts->size()
+         && (*allDicts)[ i.value() ]->getId() == id )
+      return (*allDicts)[ i.value() ];
+
+    if ( rebuilt )
+      return sptr< Dictionary::Class >();
+
+    rebuildAllDictsIndex();
+    rebuilt = true;
+  }
+}
+
+void DictListModel::rebuildAllDictsIndex() const
+{
+  allDictsIndex.clear();
+
+  for( unsigned x = 0; x < allDicts->size(); ++x )
+    allDictsIndex.insert( QString::fromStdString( (*allDicts)[ x ]->getId() ), x );
+
+  allDictsIndexSize = allDicts->size();
+}
+
 QVariant DictListModel::data( QModelIndex const & index, int role ) const
 {
   if( index.row() < 0 )
@@ -222,7 +286,12 @@ QVariant DictListModel::data( QModelIndex const & index, int role ) const
   {
     case Qt::ToolTipRole:
     {
-      QString tt = "<b>" + QString::fromUtf8( item->getName().c_str() ) + "</b>";
+      ItemData & d = itemData( item.get() );
+
+      if ( d.hasToolTip )
+        return d.toolTip;
+
+      QString tt = "<b>" + d.name + "</b>";
 
       QString lfrom( Language::localizedNameForId( item->getLangFrom() ) );
       QString lto( Language::localizedNameForId( item->getLangTo() ) );
@@ -249,18 +318,32 @@ QVariant DictListModel::data( QModelIndex const & index, int role ) const
       }
 
       tt.replace( " ", "&nbsp;" );
+
+      d.toolTip = tt;
+      d.hasToolTip = true;
+
       return tt;
     }
 
     case Qt::DisplayRole :
-      return QString::fromUtf8( item->getName().c_str() );
+      return itemData( item.get() ).name;
 
     case Qt::EditRole :
       return QString::fromUtf8( item->getId().c_str() );
 
     case Qt::DecorationRole:
-      // make all icons of the same size to avoid visual size/alignment problems
-      return item->getIcon().pixmap( 32 ).scaledToHeight( 21, Qt::SmoothTransformation );
+    {
+      ItemData & d = itemData( item.get() );
+
+      if ( !d.hasIcon )
+      {
+        // make all icons of the same size to avoid visual size/alignment problems
+        d.icon = item->getIcon().pixmap( 32 ).scaledToHeight( 21, Qt::SmoothTransformation );
+        d.hasIcon = true;
+      }
+
+      return d.icon;
+    }
 
     default:;
   }
@@ -324,16 +407,12 @@ bool DictListModel::setData( QModelIndex const & index, const QVariant & value,
 
   if ( role == Qt::EditRole )
   {
-    Config::Group g;
-
-    g.dictionaries.push_back( Config::DictionaryRef( value.toString(), QString() ) );
-
-    Instances::Group i( g, *allDicts, Config::Group() );
+    sptr< Dictionary::Class > dict = findAvailable( value.toString().toStdString() );
 
-    if ( i.dictionaries.size() == 1 )
+    if ( dict )
     {
       // Found that dictionary
-      dictionaries[ index.row() ] = i.dictionaries.front();
+      dictionaries[ index.row() ] = dict;
 
       emit dataChanged( index, index );
 
@@ -396,17 +475,20 @@ void DictListModel::addSelectedUniqueFromModel( QItemSelectionModel * source )
     return;
 
   QVector< std::string > list;
-  QVector< std::string > dicts;
+  std::set< std::string > dicts;
   for ( unsigned i = 0; i < dictionaries.size(); i++ )
-    dicts.append( dictionaries.at( i )->getId() );
+    dicts.insert( dictionaries.at( i )->getId() );
 
   for ( int i = 0; i < rows.count(); i++ )
   {
     QModelIndex idx = proxyModel ? proxyModel->mapToSource(rows.at( i )) : rows.at( i );
     std::string id = baseModel->dictionaries.at( idx.row() )->getId();
 
-    if ( !dicts.contains( id ) )
+    if ( dicts.find( id ) == dicts.end() )
+    {
       list.append( id );
+      dicts.insert( id );
+    }
   }
 
   if ( list.empty() )
@@ -414,14 +496,10 @@ void DictListModel::addSelectedUniqueFromModel( QItemSelectionModel * source )
 
   for ( int j = 0; j < list.size(); j++ )
   {
-    for ( unsigned i = 0; i < allDicts->size(); i++ )
-    {
-      if ( allDicts->at( i )->getId() == list.at( j ) )
-      {
-        dictionaries.push_back( allDicts->at( i ) );
-        break;
-      }
-    }
+    sptr< Dictionary::Class > dict = findAvailable( list.at( j ) );
+
+    if ( dict )
+      dictionaries.push_back( dict );
   }
 
   beginResetModel();
@@ -463,6 +541,10 @@ DictListWidget::DictListWidget( QWidget * parent ): QListView( parent ),
 {
   setModel( &model );
 
+  // All the rows have the same height, so the view doesn't need to query
+  // each dictionary's icon and name to lay out the list
+  setUniformItemSizes( true );
+
   setSelectionMode( ExtendedSelection );
 
   setDragEnabled( true );
@@ -9,7 +9,9 @@
 #include <vector>
 
 #include <QAction>
+#include <QHash>
 #include <QListWidget>
+#include <QPixmap>
 #include <QSortFilterProxyModel>
 
 #include "config.hh"
@@ -24,7 +26,7 @@ class DictListModel: public QAbstractListModel
 public:
 
   DictListModel( QWidget * parent ):
-    QAbstractListModel( parent ), isSource( false ), allDicts( 0 )
+    QAbstractListModel( parent ), isSource( false ), allDicts( 0 ), allDictsIndexSize( 0 )
   {}
 
   /// Populates the current model with the given dictionaries. This is
@@ -58,10 +60,36 @@ public:
 
 private:
 
+  /// Display data of a single dictionary. Each field is made on the first
+  /// request only, so that the views would only pay for the rows actually
+  /// shown, which matters with large dictionary collections.
+  struct ItemData
+  {
+    QString name, toolTip;
+    QPixmap icon;
+    bool hasToolTip, hasIcon;
+
+    ItemData(): hasToolTip( false ), hasIcon( false )
+    {}
+  };
+
+  ItemData & itemData( Dictionary::Class * ) const;
+
+  /// Finds the dictionary with the given id among allDicts. Returns null
+  /// if there's no such dictionary.
+  sptr< Dictionary::Class > findAvailable( std::string const & id ) const;
+
+  /// Maps the ids of allDicts to their positions anew
+  void rebuildAllDictsIndex() const;
+
   bool isSource;
   std::vector< sptr< Dictionary::Class > > dictionaries;
   std::vector< sptr< Dictionary::Class > > const * allDicts;
 
+  mutable QHash< Dictionary::Class const *, ItemData > itemsData;
+  mutable QHash< QString, int > allDictsIndex; // Id -> index in allDicts
+  mutable size_t allDictsIndexSize; // The size of allDicts it was built for
+
 signals:
   void contentChanged();
 };
@@ -0,0 +1,336 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "indexingstats.hh"
+#include "config.hh"
+#include "mutex.hh"
+#include "gddebug.hh"
+#include "qt4x5.hh"
+
+#include <list>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QFile>
+#include <QThreadStorage>
+
+using std::string;
+
+namespace IndexingStats {
+
+namespace {
+
+enum
+{
+  /// The log starts anew once it grows larger than this
+  MaxLogSize = 1024 * 1024,
+  /// The time left isn't told before this many msecs of work
+  MinElapsedForTimeLeft = 2000,
+  /// The counts are handed over to the progress once per this many additions
+  AddsPerFlush = 256
+};
+
+struct Build
+{
+  Progress progress;
+  qint64 startedAt;
+
+  // Only the build's own thread touches these, so they're counted without
+  // the lock and merely handed over to the progress now and then
+  quint64 pending[ CounterCount ];
+  unsigned pendingAdds;
+  uint32_t lastArticleOffset;
+  bool hasArticle;
+
+  Build( string const & dictionaryName, char const * kind );
+
+  /// Adds the pending counts to the progress. Must be called with the mutex
+  /// held.
+  void flush();
+
+  /// Unregisters the build, it's deleted when ended or when its thread exits
+  ~Build();
+};
+
+Mutex mutex; // Protects the list and the builds' contents
+std::list< Build * > builds; // Latest ones last
+QAtomicInt buildCount;
+
+QThreadStorage< Build * > & currentBuild()
+{
+  static QThreadStorage< Build * > storage;
+
+  return storage;
+}
+
+Build::Build( string const & dictionaryName, char const * kind ):
+  startedAt( QDateTime::currentMSecsSinceEpoch() ),
+  pendingAdds( 0 ),
+  lastArticleOffset( 0 ),
+  hasArticle( false )
+{
+  progress.dictionaryName = dictionaryName;
+  progress.kind = kind;
+
+  for( int x = 0; x < CounterCount; ++x )
+    pending[ x ] = 0;
+
+  Mutex::Lock _( mutex );
+
+  builds.push_back( this );
+  buildCount.ref();
+}
+
+Build::~Build()
+{
+  Mutex::Lock _( mutex );
+
+  builds.remove( this );
+  buildCount.deref();
+}
+
+void Build::flush()
+{
+  for( int x = 0; x < CounterCount; ++x )
+  {
+    progress.counters[ x ] += pending[ x ];
+    pending[ x ] = 0;
+  }
+
+  pendingAdds = 0;
+}
+
+/// Returns the build of the current thread, or 0
+Build * getCurrent()
+{
+  if ( !Qt4x5::AtomicInt::loadAcquire( buildCount ) )
+    return 0;
+
+  QThreadStorage< Build * > & storage = currentBuild();
+
+  return storage.hasLocalData() ? storage.localData() : 0;
+}
+
+string escapeJson( string const & str )
+{
+  string result;
+
+  result.reserve( str.size() );
+
+  for( size_t x = 0; x < str.size(); ++x )
+  {
+    unsigned char ch = str[ x ];
+
+    if ( ch == '"' || ch == '\\' )
+    {
+      result.push_back( '\\' );
+      result.push_back( ch );
+    }
+    else
+    if ( ch < 0x20 )
+    {
+      char buf[ 8 ];
+      qsnprintf( buf, sizeof( buf ), "\\u%04x", ch );
+      result += buf;
+    }
+    else
+      result.push_back( ch );
+  }
+
+  return result;
+}
+
+/// Appends the summary of the finished build to the log
+void writeLog( Progress const & p )
+{
+  QString fileName;
+
+  try
+  {
+    fileName = Config::getConfigDir() + "indexing.log";
+  }
+  catch( std::exception & )
+  {
+    return;
+  }
+
+  QFile file( fileName );
+
+  QIODevice::OpenMode mode = QIODevice::WriteOnly;
+
+  mode |= file.size() > MaxLogSize ? QIODevice::Truncate : QIODevice::Append;
+
+  if ( !file.open( mode ) )
+  {
+    gdWarning( "Can't write the indexing log: %s\n", file.errorString().toUtf8().data() );
+    return;
+  }
+
+  double seconds = p.elapsed / 1000.0;
+
+  QString line = QString( "{\"time\":\"%1\",\"dictionary\":\"%2\",\"kind\":\"%3\","
+                          "\"seconds\":%4,\"sourceSize\":%5,\"bytesRead\":%6,"
+                          "\"articles\":%7,\"headwords\":%8,\"storedBytes\":%9,"
+                          "\"indexEntries\":%10,\"bytesReadPerSecond\":%11,"
+                          "\"articlesPerSecond\":%12,\"headwordsPerSecond\":%13}\n" )
+                 .arg( QDateTime::currentDateTime().toString( Qt::ISODate ) )
+                 .arg( QString::fromUtf8( escapeJson( p.dictionaryName ).c_str() ) )
+                 .arg( QString::fromLatin1( p.kind.c_str() ) )
+                 .arg( seconds, 0, 'f', 3 )
+                 .arg( p.sourceSize )
+                 .arg( p.counters[ BytesRead ] )
+                 .arg( p.counters[ Articles ] )
+                 .arg( p.counters[ Headwords ] )
+                 .arg( p.counters[ StoredBytes ] )
+                 .arg( p.counters[ IndexEntries ] )
+                 .arg( p.getRate( BytesRead ), 0, 'f', 0 )
+                 .arg( p.getRate( Articles ), 0, 'f', 0 )
+                 .arg( p.getRate( Headwords ), 0, 'f', 0 );
+
+  file.write( line.toUtf8() );
+}
+
+}
+
+Progress::Progress(): sourceSize( 0 ), expectedArticles( 0 ), elapsed( 0 )
+{
+  for( int x = 0; x < CounterCount; ++x )
+    counters[ x ] = 0;
+}
+
+double Progress::getDone() const
+{
+  double done = -1;
+
+  if ( expectedArticles )
+    done = (double) counters[ Articles ] / expectedArticles;
+  else
+  if ( sourceSize )
+    done = (double) counters[ BytesRead ] / sourceSize;
+
+  // The files may be read more than once
+  return done > 1 ? 1 : done;
+}
+
+qint64 Progress::getTimeLeft() const
+{
+  double done = getDone();
+
+  if ( done <= 0 || elapsed < MinElapsedForTimeLeft )
+    return -1;
+
+  return (qint64)( elapsed * ( 1 - done ) / done );
+}
+
+double Progress::getRate( Counter counter ) const
+{
+  return elapsed > 0 ? counters[ counter ] * 1000.0 / elapsed : 0;
+}
+
+void begin( string const & dictionaryName, char const * kind )
+{
+  end();
+
+  currentBuild().setLocalData( new Build( dictionaryName, kind ) );
+}
+
+void end()
+{
+  Build * build = getCurrent();
+
+  if ( !build )
+    return;
+
+  Progress progress;
+
+  {
+    Mutex::Lock _( mutex );
+
+    build->flush();
+
+    progress = build->progress;
+    progress.elapsed = QDateTime::currentMSecsSinceEpoch() - build->startedAt;
+  }
+
+  // Nothing was built if nothing was done
+  if ( progress.counters[ Headwords ] || progress.counters[ Articles ] )
+    writeLog( progress );
+
+  currentBuild().setLocalData( 0 ); // Deletes the build
+}
+
+bool isCounting()
+{
+  return getCurrent() != 0;
+}
+
+void add( Counter counter, quint64 value )
+{
+  Build * build = getCurrent();
+
+  if ( !build )
+    return;
+
+  build->pending[ counter ] += value;
+
+  if ( ++build->pendingAdds >= AddsPerFlush )
+  {
+    Mutex::Lock _( mutex );
+
+    build->flush();
+  }
+}
+
+void addArticleAt( uint32_t offset )
+{
+  Build * build = getCurrent();
+
+  if ( !build || ( build->hasArticle && build->lastArticleOffset == offset ) )
+    return;
+
+  // Only this thread touches these
+  build->hasArticle = true;
+  build->lastArticleOffset = offset;
+
+  add( Articles );
+}
+
+void addSourceFile( quint64 size )
+{
+  Build * build = getCurrent();
+
+  if ( !build )
+    return;
+
+  Mutex::Lock _( mutex );
+
+  build->progress.sourceSize += size;
+}
+
+void setExpectedArticles( quint64 count )
+{
+  Build * build = getCurrent();
+
+  if ( !build )
+    return;
+
+  Mutex::Lock _( mutex );
+
+  build->progress.expectedArticles = count;
+}
+
+bool getLatestProgress( Progress & progress )
+{
+  Mutex::Lock _( mutex );
+
+  if ( builds.empty() )
+    return false;
+
+  Build const & build = *builds.back();
+
+  progress = build.progress;
+  progress.elapsed = QDateTime::currentMSecsSinceEpoch() - build.startedAt;
+
+  return true;
+}
+
+}
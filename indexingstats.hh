@@ -0,0 +1,107 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __INDEXINGSTATS_HH_INCLUDED__
+#define __INDEXINGSTATS_HH_INCLUDED__
+
+#include <string>
+#include <QtGlobal>
+
+#if defined( _MSC_VER ) && _MSC_VER < 1800 // VS2012 and older
+#include <stdint_msvc.h>
+#else
+#include <stdint.h>
+#endif
+
+/// Counts the work done while the indices of a dictionary are being built,
+/// so that the rate and the time left could be shown while waiting, and the
+/// builds taking too long could be spotted in the log. The builders merely
+/// report what they do; the counts go to the build begun in the same thread,
+/// and are dropped if there's none. Each finished build is logged as a JSON
+/// line to indexing.log in the configuration directory.
+namespace IndexingStats {
+
+enum Counter
+{
+  BytesRead,    // From the source files
+  Articles,     // Processed
+  Headwords,    // Inserted into the index
+  StoredBytes,  // Of the articles and the other data put into the index
+  IndexEntries, // Written to the btrees
+  CounterCount
+};
+
+struct Progress
+{
+  std::string dictionaryName;
+  std::string kind; // "index" or "fts"
+  quint64 counters[ CounterCount ];
+  quint64 sourceSize; // Of the source files read from, 0 if unknown
+  quint64 expectedArticles; // 0 if unknown
+  qint64 elapsed; // Msecs of work so far
+
+  Progress();
+
+  /// Returns the share of the work done, from 0 to 1, or -1 if unknown
+  double getDone() const;
+
+  /// Returns the msecs left, or -1 if it can't be told yet
+  qint64 getTimeLeft() const;
+
+  /// Returns how much of the given counter is done per second
+  double getRate( Counter ) const;
+};
+
+/// Begins counting the build of the indices of the given dictionary in the
+/// current thread, ending the one begun before, if any.
+void begin( std::string const & dictionaryName, char const * kind );
+
+/// Ends the build begun in the current thread, if any, and logs it.
+void end();
+
+/// Counts a build for the lifetime of the object
+class Scope
+{
+public:
+
+  Scope( std::string const & dictionaryName, char const * kind )
+  { begin( dictionaryName, kind ); }
+
+  ~Scope()
+  { end(); }
+};
+
+/// Ends the build begun in the current thread, if any, on leaving the scope.
+/// The formats put it into the blocks building their indices, so that the
+/// dictionaries opened after a build aren't counted as a part of it.
+class EndOfBuild
+{
+public:
+
+  ~EndOfBuild()
+  { end(); }
+};
+
+/// Returns true if there's a build being counted in any thread. The
+/// builders may check this to skip any preparations for the counting.
+bool isCounting();
+
+void add( Counter, quint64 value = 1 );
+
+/// Counts the article with the given offset unless it was the one counted
+/// last, since all the headwords of an article are added in a row.
+void addArticleAt( uint32_t offset );
+
+/// Tells that a source file of the given size was opened for reading
+void addSourceFile( quint64 size );
+
+/// Tells the number of the articles to be processed, if known beforehand
+void setExpectedArticles( quint64 );
+
+/// Returns the progress of the latest build begun among the running ones.
+/// Returns false if there's none.
+bool getLatestProgress( Progress & );
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <QIcon>
 #include "initializing.hh"
+#include "indexingstats.hh"
 #include <QCloseEvent>
 
 #if ( QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ) ) && defined( Q_OS_WIN32 )
@@ -56,6 +57,11 @@ Initializing::Initializing( QWidget * parent, bool showOnStartup ): QDialog( par
 
 #endif
 
+  ui.stats->hide();
+
+  statsTimer.setInterval( 500 );
+  connect( &statsTimer, SIGNAL( timeout() ), this, SLOT( updateStats() ) );
+
   if ( showOnStartup )
   {
     ui.operation->setText( tr( "Please wait..." ) );
@@ -70,9 +76,56 @@ void Initializing::indexing( QString const & dictionaryName )
   ui.operation->setText( tr( "Please wait while indexing dictionary" ) );
   ui.dictionary->setText( dictionaryName );
   ui.dictionary->show();
+  ui.progressBar->setMaximum( 0 ); // Until the progress is known
   ui.progressBar->show();
+  ui.stats->clear();
+  ui.stats->show();
   adjustSize();
   show();
+
+  statsTimer.start();
+}
+
+void Initializing::updateStats()
+{
+  IndexingStats::Progress progress;
+
+  if ( !IndexingStats::getLatestProgress( progress ) )
+    return;
+
+  double done = progress.getDone();
+
+  if ( done >= 0 )
+  {
+    ui.progressBar->setMaximum( 1000 );
+    ui.progressBar->setValue( (int)( done * 1000 ) );
+  }
+
+  QString text;
+
+  if ( progress.expectedArticles )
+    text = tr( "%1 of %2 articles" ).arg( progress.counters[ IndexingStats::Articles ] )
+                                    .arg( progress.expectedArticles );
+  else
+    text = tr( "%1 headwords" ).arg( progress.counters[ IndexingStats::Headwords ] );
+
+  if ( progress.counters[ IndexingStats::BytesRead ] )
+    text += ", " + tr( "%1 MiB/s" ).arg( progress.getRate( IndexingStats::BytesRead ) / 1048576,
+                                          0, 'f', 1 );
+  else
+    text += ", " + tr( "%1 headwords/s" ).arg( progress.getRate( IndexingStats::Headwords ), 0, 'f', 0 );
+
+  qint64 left = progress.getTimeLeft();
+
+  if ( left >= 0 )
+  {
+    int secs = (int)( left / 1000 );
+
+    text += ", " + tr( "about %1:%2 left" ).arg( secs / 60 )
+                                           .arg( secs % 60, 2, 10, QChar( '0' ) );
+  }
+
+  ui.stats->setText( text );
 }
 
 void Initializing::closeEvent( QCloseEvent * ev )
@@ -5,6 +5,7 @@
 #define __INITIALIZING_HH_INCLUDED__
 
 #include <QDialog>
+#include <QTimer>
 #include "ui_initializing.h"
 
 #if ( QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ) ) && defined( Q_OS_WIN32 )
@@ -42,8 +43,15 @@ public slots:
 
   void indexing( QString const & dictionaryName );
 
+private slots:
+
+  /// Shows the progress of the index being built, see IndexingStats
+  void updateStats();
+
 private:
 
+  QTimer statsTimer;
+
   virtual void closeEvent( QCloseEvent * );
   virtual void reject();
 #if ( QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ) ) && defined( Q_OS_WIN32 )
@@ -10,6 +10,30 @@ namespace Instances {
 using std::set;
 using std::string;
 
+DictionaryIndex::DictionaryIndex( vector< sptr< Dictionary::Class > > const & dictionaries_ ):
+  dictionaries( dictionaries_ )
+{
+  positions.reserve( dictionaries.size() );
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+  {
+    string const & id = dictionaries[ x ]->getId();
+
+    positions.insert( QByteArray( id.data(), id.size() ), x );
+  }
+}
+
+sptr< Dictionary::Class > const * DictionaryIndex::find( string const & id ) const
+{
+  QHash< QByteArray, unsigned >::const_iterator i =
+    positions.constFind( QByteArray::fromRawData( id.data(), id.size() ) );
+
+  if ( i == positions.constEnd() )
+    return 0;
+
+  return &dictionaries[ i.value() ];
+}
+
 Group::Group( Config::Group const & cfgGroup,
               vector< sptr< Dictionary::Class > > const & allDictionaries,
               Config::Group const & inactiveGroup ):
@@ -18,27 +42,41 @@ Group::Group( Config::Group const & cfgGroup,
   icon( cfgGroup.icon ),
   favoritesFolder( cfgGroup.favoritesFolder ),
   shortcut( cfgGroup.shortcut )
+{
+  init( cfgGroup, DictionaryIndex( allDictionaries ), inactiveGroup );
+}
+
+Group::Group( Config::Group const & cfgGroup,
+              DictionaryIndex const & allDictionaries,
+              Config::Group const & inactiveGroup ):
+  id( cfgGroup.id ),
+  name( cfgGroup.name ),
+  icon( cfgGroup.icon ),
+  favoritesFolder( cfgGroup.favoritesFolder ),
+  shortcut( cfgGroup.shortcut )
+{
+  init( cfgGroup, allDictionaries, inactiveGroup );
+}
+
+void Group::init( Config::Group const & cfgGroup,
+                  DictionaryIndex const & index,
+                  Config::Group const & inactiveGroup )
 {
   if ( !cfgGroup.iconData.isEmpty() )
     iconData = iconFromData( cfgGroup.iconData );
 
+  vector< sptr< Dictionary::Class > > const & allDictionaries = index.getDictionaries();
+
   vector< sptr< Dictionary::Class > > groupDicts;
 
   for( unsigned x = 0; x < (unsigned)cfgGroup.dictionaries.size(); ++x )
   {
-    std::string id = cfgGroup.dictionaries[ x ].id.toStdString();
+    sptr< Dictionary::Class > const * dict =
+      index.find( cfgGroup.dictionaries[ x ].id.toStdString() );
 
-    bool added = false;
-
-    for( unsigned y = allDictionaries.size(); y--; )
-      if ( allDictionaries[ y ]->getId() == id )
-      {
-        groupDicts.push_back( allDictionaries[ y ] );
-        added = true;
-        break;
-      }
-
-    if ( !added )
+    if ( dict )
+      groupDicts.push_back( *dict );
+    else
     {
       // Try matching by name instead
       QString qname = cfgGroup.dictionaries[ x ].name;
@@ -179,36 +217,48 @@ void complementDictionaryOrder( Group & group,
   }
 }
 
-void updateNames( Config::Group & group,
-                  vector< sptr< Dictionary::Class > > const & allDictionaries )
-{
+namespace {
 
+void updateNames( Config::Group & group, DictionaryIndex const & index )
+{
   for( unsigned x = group.dictionaries.size(); x--; )
   {
-    std::string id = group.dictionaries[ x ].id.toStdString();
+    sptr< Dictionary::Class > const * dict =
+      index.find( group.dictionaries[ x ].id.toStdString() );
 
-    for( unsigned y = allDictionaries.size(); y--; )
-      if ( allDictionaries[ y ]->getId() == id )
-      {
-        group.dictionaries[ x ].name = QString::fromUtf8( allDictionaries[ y ]->getName().c_str() );
-        break;
-      }
+    if ( dict )
+      group.dictionaries[ x ].name = QString::fromUtf8( (*dict)->getName().c_str() );
   }
 }
 
+void updateNames( Config::Groups & groups, DictionaryIndex const & index )
+{
+  for( int x = 0; x < groups.size(); ++x )
+    updateNames( groups[ x ], index );
+}
+
+}
+
+void updateNames( Config::Group & group,
+                  vector< sptr< Dictionary::Class > > const & allDictionaries )
+{
+  updateNames( group, DictionaryIndex( allDictionaries ) );
+}
+
 void updateNames( Config::Groups & groups,
                   vector< sptr< Dictionary::Class > > const & allDictionaries )
 {
-  for( int x = 0; x < groups.size(); ++x )
-    updateNames( groups[ x ], allDictionaries );
+  updateNames( groups, DictionaryIndex( allDictionaries ) );
 }
 
 void updateNames( Config::Class & cfg,
                   vector< sptr< Dictionary::Class > > const & allDictionaries )
 {
-  updateNames( cfg.dictionaryOrder, allDictionaries );
-  updateNames( cfg.inactiveDictionaries, allDictionaries );
-  updateNames( cfg.groups, allDictionaries );
+  DictionaryIndex index( allDictionaries );
+
+  updateNames( cfg.dictionaryOrder, index );
+  updateNames( cfg.inactiveDictionaries, index );
+  updateNames( cfg.groups, index );
 }
 
 QIcon iconFromData( QByteArray const & iconData )
@@ -7,6 +7,7 @@
 #include "config.hh"
 #include "dictionary.hh"
 #include <QIcon>
+#include <QHash>
 #include <limits.h>
 
 // This complements Config, providing instances for the stored configurations.
@@ -18,6 +19,26 @@ namespace Instances {
 
 using std::vector;
 
+/// Finds dictionaries by their ids without scanning all of them. Making one
+/// and using it for all the groups being instantiated saves going through
+/// all the dictionaries for each dictionary of each group.
+class DictionaryIndex
+{
+  vector< sptr< Dictionary::Class > > const & dictionaries;
+  QHash< QByteArray, unsigned > positions;
+
+public:
+
+  explicit DictionaryIndex( vector< sptr< Dictionary::Class > > const & );
+
+  /// Returns the dictionary with the given id, or 0 if there's no such
+  /// dictionary. With duplicate ids, the last dictionary is returned.
+  sptr< Dictionary::Class > const * find( std::string const & id ) const;
+
+  vector< sptr< Dictionary::Class > > const & getDictionaries() const
+  { return dictionaries; }
+};
+
 struct Group
 {
   unsigned id;
@@ -32,6 +53,11 @@ struct Group
          vector< sptr< Dictionary::Class > > const & allDictionaries,
          Config::Group const & inactiveGroup );
 
+  /// Same as above, but looks the dictionaries up in the index given.
+  Group( Config::Group const & cfgGroup,
+         DictionaryIndex const & allDictionaries,
+         Config::Group const & inactiveGroup );
+
   /// Creates an empty group.
   Group( QString const & name_ );
 
@@ -54,6 +80,12 @@ struct Group
 
   /// Invalid value, used to specify that no group id is specified at all.
   static const unsigned NoGroupId = 0;
+
+private:
+
+  void init( Config::Group const & cfgGroup,
+             DictionaryIndex const & allDictionaries,
+             Config::Group const & inactiveGroup );
 };
 
 struct Groups: public vector< Group >
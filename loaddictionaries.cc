@@ -22,6 +22,7 @@
 #include "voiceengines.hh"
 #include "gddebug.hh"
 #include "fsencoding.hh"
+#include "indexingstats.hh"
 #include "xdxf.hh"
 #include "sdict.hh"
 #include "aard.hh"
@@ -31,6 +32,7 @@
 #include "dictserver.hh"
 #include "slob.hh"
 #include "gls.hh"
+#include "qt4x5.hh"
 
 #ifndef NO_EPWING_SUPPORT
 #include "epwing.hh"
@@ -44,12 +46,20 @@
 #include <QDir>
 
 #include <set>
+#include <map>
 
 using std::set;
+using std::map;
 
 using std::string;
 using std::vector;
 
+namespace {
+
+DEF_EX( exCancelled, "Loading dictionaries was cancelled", std::exception )
+
+}
+
 LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
   paths( cfg.paths ), soundDirs( cfg.soundDirs ), hunspell( cfg.hunspell ),
   transliteration( cfg.transliteration ),
@@ -73,6 +83,34 @@ LoadDictionaries::LoadDictionaries( Config::Class const & cfg ):
 ;
 }
 
+void LoadDictionaries::setKnownDictionaries( vector< sptr< Dictionary::Class > > & dicts )
+{
+  string indexDir = FsEncoding::encode( Config::getIndexDir() );
+
+  knownDictionaries.clear();
+  knownDictionaries.resize( dicts.size() );
+  knownReused.assign( dicts.size(), false );
+  knownFiles.clear();
+
+  for( unsigned x = 0; x < dicts.size(); ++x )
+  {
+    vector< string > const & files = dicts[ x ]->getDictionaryFilenames();
+
+    if ( files.empty()
+         || Dictionary::needToRebuildIndex( files, indexDir + dicts[ x ]->getId() ) )
+    {
+      // Not made from the files or changed since
+      dicts[ x ].reset();
+      continue;
+    }
+
+    knownDictionaries[ x ] = files;
+
+    for( unsigned y = 0; y < files.size(); ++y )
+      knownFiles[ files[ y ] ] = x;
+  }
+}
+
 void LoadDictionaries::run()
 {
   try
@@ -85,8 +123,7 @@ void LoadDictionaries::run()
       vector< sptr< Dictionary::Class > > soundDirDictionaries =
         SoundDir::makeDictionaries( soundDirs, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-      dictionaries.insert( dictionaries.end(), soundDirDictionaries.begin(),
-                           soundDirDictionaries.end() );
+      addDictionaries( soundDirDictionaries );
     }
 
     // Make hunspells
@@ -94,8 +131,7 @@ void LoadDictionaries::run()
       vector< sptr< Dictionary::Class > > hunspellDictionaries =
         HunspellMorpho::makeDictionaries( hunspell );
 
-      dictionaries.insert( dictionaries.end(), hunspellDictionaries.begin(),
-                           hunspellDictionaries.end() );
+      addDictionaries( hunspellDictionaries );
     }
 
     exceptionText.clear();
@@ -104,6 +140,8 @@ void LoadDictionaries::run()
   {
     exceptionText = e.what();
   }
+
+  IndexingStats::end(); // In case a format didn't end its build
 }
 
 void LoadDictionaries::handlePath( Config::Path const & path )
@@ -131,28 +169,27 @@ void LoadDictionaries::handlePath( Config::Path const & path )
       allFiles.push_back( FsEncoding::encode( QDir::toNativeSeparators( fullName ) ) );
   }
 
+  reuseKnownDictionaries( allFiles );
+
   {
     vector< sptr< Dictionary::Class > > bglDictionaries =
       Bgl::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), bglDictionaries.begin(),
-                         bglDictionaries.end() );
+    addDictionaries( bglDictionaries );
   }
 
   {
     vector< sptr< Dictionary::Class > > stardictDictionaries =
       Stardict::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this, maxHeadwordToExpand );
 
-    dictionaries.insert( dictionaries.end(), stardictDictionaries.begin(),
-                         stardictDictionaries.end() );
+    addDictionaries( stardictDictionaries );
   }
 
   {
     vector< sptr< Dictionary::Class > > lsaDictionaries =
       Lsa::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), lsaDictionaries.begin(),
-                         lsaDictionaries.end() );
+    addDictionaries( lsaDictionaries );
   }
 
   {
@@ -160,73 +197,63 @@ void LoadDictionaries::handlePath( Config::Path const & path )
       Dsl::makeDictionaries(
           allFiles, FsEncoding::encode( Config::getIndexDir() ), *this, maxPictureWidth, maxHeadwordSize );
 
-    dictionaries.insert( dictionaries.end(), dslDictionaries.begin(),
-                         dslDictionaries.end() );
+    addDictionaries( dslDictionaries );
   }
 
   {
     vector< sptr< Dictionary::Class > > dictdDictionaries =
       DictdFiles::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), dictdDictionaries.begin(),
-                         dictdDictionaries.end() );
+    addDictionaries( dictdDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > xdxfDictionaries =
       Xdxf::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), xdxfDictionaries.begin(),
-                         xdxfDictionaries.end() );
+    addDictionaries( xdxfDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > sdictDictionaries =
       Sdict::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), sdictDictionaries.begin(),
-                         sdictDictionaries.end() );
+    addDictionaries( sdictDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > aardDictionaries =
       Aard::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this, maxHeadwordToExpand );
 
-    dictionaries.insert( dictionaries.end(), aardDictionaries.begin(),
-                         aardDictionaries.end() );
+    addDictionaries( aardDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > zipSoundsDictionaries =
       ZipSounds::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), zipSoundsDictionaries.begin(),
-                         zipSoundsDictionaries.end() );
+    addDictionaries( zipSoundsDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > mdxDictionaries =
       Mdx::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), mdxDictionaries.begin(),
-                         mdxDictionaries.end() );
+    addDictionaries( mdxDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > glsDictionaries =
       Gls::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), glsDictionaries.begin(),
-                         glsDictionaries.end() );
+    addDictionaries( glsDictionaries );
   }
 #ifdef MAKE_ZIM_SUPPORT
   {
     vector< sptr< Dictionary::Class > > zimDictionaries =
       Zim::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this, maxHeadwordToExpand );
 
-    dictionaries.insert( dictionaries.end(), zimDictionaries.begin(),
-                         zimDictionaries.end() );
+    addDictionaries( zimDictionaries );
   }
   {
     vector< sptr< Dictionary::Class > > slobDictionaries =
       Slob::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this, maxHeadwordToExpand );
 
-    dictionaries.insert( dictionaries.end(), slobDictionaries.begin(),
-                         slobDictionaries.end() );
+    addDictionaries( slobDictionaries );
   }
 #endif
 #ifndef NO_EPWING_SUPPORT
@@ -234,55 +261,106 @@ void LoadDictionaries::handlePath( Config::Path const & path )
     vector< sptr< Dictionary::Class > > epwingDictionaries =
       Epwing::makeDictionaries( allFiles, FsEncoding::encode( Config::getIndexDir() ), *this );
 
-    dictionaries.insert( dictionaries.end(), epwingDictionaries.begin(),
-                         epwingDictionaries.end() );
+    addDictionaries( epwingDictionaries );
   }
 #endif
 }
 
-void LoadDictionaries::indexingDictionary( string const & dictionaryName ) throw()
+void LoadDictionaries::reuseKnownDictionaries( vector< string > & files )
 {
-  emit indexingDictionarySignal( QString::fromUtf8( dictionaryName.c_str() ) );
-}
+  if ( knownFiles.empty() )
+    return;
 
+  set< string > reusedFiles;
 
-void loadDictionaries( QWidget * parent, bool showInitially,
-                       Config::Class const & cfg,
-                       std::vector< sptr< Dictionary::Class > > & dictionaries,
-                       QNetworkAccessManager & dictNetMgr,
-                       bool doDeferredInit_ )
-{
-  dictionaries.clear();
+  for( unsigned x = 0; x < files.size(); ++x )
+  {
+    map< string, unsigned >::const_iterator i = knownFiles.find( files[ x ] );
 
-  ::Initializing init( parent, showInitially );
+    if ( i == knownFiles.end() || knownReused[ i->second ] )
+      continue;
 
-  // Start a thread to load all the dictionaries
+    knownReused[ i->second ] = true;
 
-  LoadDictionaries loadDicts( cfg );
+    vector< string > const & known = knownDictionaries[ i->second ];
 
-  QObject::connect( &loadDicts, SIGNAL( indexingDictionarySignal( QString const & ) ),
-                    &init, SLOT( indexing( QString const & ) ) );
+    reusedFiles.insert( known.begin(), known.end() );
 
-  QEventLoop localLoop;
+    // The dictionary itself is put in place by takeDictionaries()
+    Mutex::Lock _( dictionariesMutex );
 
-  QObject::connect( &loadDicts, SIGNAL( finished() ),
-                    &localLoop, SLOT( quit() ) );
+    dictionaries.push_back( sptr< Dictionary::Class >() );
+    reusedFrom.push_back( i->second );
+  }
 
-  loadDicts.start();
+  if ( reusedFiles.empty() )
+    return;
 
-  localLoop.exec();
+  vector< string > otherFiles;
 
-  loadDicts.wait();
+  for( unsigned x = 0; x < files.size(); ++x )
+    if ( reusedFiles.find( files[ x ] ) == reusedFiles.end() )
+      otherFiles.push_back( files[ x ] );
 
-  if ( loadDicts.getExceptionText().size() )
-  {
-    QMessageBox::critical( parent, QCoreApplication::translate( "LoadDictionaries", "Error loading dictionaries" ),
-                           QString::fromUtf8( loadDicts.getExceptionText().c_str() ) );
+  files.swap( otherFiles );
+}
 
+void LoadDictionaries::addDictionaries( vector< sptr< Dictionary::Class > > & dicts )
+{
+  // Called after each format, so this is where the loading stops when asked
+  // to. The dictionaries made are released along with the exception.
+  if ( Qt4x5::AtomicInt::loadAcquire( cancelled ) )
+    throw exCancelled();
+
+  if ( dicts.empty() )
     return;
+
+  {
+    // The pointers are copied and released under the lock, since their
+    // reference counters aren't atomic
+    Mutex::Lock _( dictionariesMutex );
+
+    dictionaries.insert( dictionaries.end(), dicts.begin(), dicts.end() );
+    reusedFrom.resize( dictionaries.size(), -1 );
+
+    dicts.clear();
   }
 
-  dictionaries = loadDicts.getDictionaries();
+  emit dictionariesAdded();
+}
+
+void LoadDictionaries::takeDictionaries( vector< sptr< Dictionary::Class > > & dicts,
+                                         vector< sptr< Dictionary::Class > > const & knownDictionaries )
+{
+  Mutex::Lock _( dictionariesMutex );
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+    dicts.push_back( reusedFrom[ x ] < 0 ? dictionaries[ x ] :
+                                           knownDictionaries[ reusedFrom[ x ] ] );
+
+  dictionaries.clear();
+  reusedFrom.clear();
+}
+
+void LoadDictionaries::indexingDictionary( string const & dictionaryName ) throw()
+{
+  // The format builds the index in this thread right after telling us, and
+  // ends the build once it's done
+  IndexingStats::begin( dictionaryName, "index" );
+
+  emit indexingDictionarySignal( QString::fromUtf8( dictionaryName.c_str() ) );
+}
+
+
+namespace {
+
+/// Makes the dictionaries which don't need the files: transliterations
+/// and the network ones. Common for the foreground and background loading.
+vector< sptr< Dictionary::Class > > makeOtherDictionaries( Dictionary::Initializing & init,
+                                                           Config::Class const & cfg,
+                                                           QNetworkAccessManager & dictNetMgr )
+{
+  vector< sptr< Dictionary::Class > > dictionaries;
 
   ///// We create transliterations synchronously since they are very simple
 
@@ -329,7 +407,7 @@ void loadDictionaries( QWidget * parent, bool showInitially,
 
   {
     vector< sptr< Dictionary::Class > > dicts =
-      MediaWiki::makeDictionaries( loadDicts, cfg.mediawikis, dictNetMgr );
+      MediaWiki::makeDictionaries( init, cfg.mediawikis, dictNetMgr );
 
     dictionaries.insert( dictionaries.end(), dicts.begin(), dicts.end() );
   }
@@ -346,7 +424,7 @@ void loadDictionaries( QWidget * parent, bool showInitially,
 
   {
     vector< sptr< Dictionary::Class > > dicts =
-      Forvo::makeDictionaries( loadDicts, cfg.forvo, dictNetMgr );
+      Forvo::makeDictionaries( init, cfg.forvo, dictNetMgr );
 
     dictionaries.insert( dictionaries.end(), dicts.begin(), dicts.end() );
   }
@@ -374,10 +452,13 @@ void loadDictionaries( QWidget * parent, bool showInitially,
     dictionaries.insert( dictionaries.end(), dicts.begin(), dicts.end() );
   }
 
-  GD_DPRINTF( "Load done\n" );
-
-  // Remove any stale index files
+  return dictionaries;
+}
 
+/// Warns about the duplicate ids and removes any stale index files, i.e.
+/// the ones of the dictionaries not present among the ones given
+void removeStaleIndices( vector< sptr< Dictionary::Class > > const & dictionaries )
+{
   set< string > ids;
   std::pair< std::set< string >::iterator, bool > ret;
 
@@ -414,7 +495,77 @@ void loadDictionaries( QWidget * parent, bool showInitially,
          && i->size() == 36
          && ids.find( FsEncoding::encode( i->left( 32 ) ) ) == ids.end() )
       indexDir.remove( *i );
+    else
+    if ( i->endsWith( "_DESC" )
+         && i->size() == 37
+         && ids.find( FsEncoding::encode( i->left( 32 ) ) ) == ids.end() )
+      indexDir.remove( *i );
   }
+}
+
+}
+
+void loadDictionaries( QWidget * parent, bool showInitially,
+                       Config::Class const & cfg,
+                       std::vector< sptr< Dictionary::Class > > & dictionaries,
+                       QNetworkAccessManager & dictNetMgr,
+                       bool doDeferredInit_,
+                       bool showWindows )
+{
+  // The dictionaries loaded before are kept if their files are unchanged,
+  // the rest of them are released once the new ones are loaded
+  vector< sptr< Dictionary::Class > > knownDictionaries;
+
+  knownDictionaries.swap( dictionaries );
+
+  sptr< ::Initializing > init;
+
+  if ( showWindows )
+    init = new ::Initializing( parent, showInitially );
+
+  // Start a thread to load all the dictionaries
+
+  LoadDictionaries loadDicts( cfg );
+
+  loadDicts.setKnownDictionaries( knownDictionaries );
+
+  if ( init.get() )
+    QObject::connect( &loadDicts, SIGNAL( indexingDictionarySignal( QString const & ) ),
+                      init.get(), SLOT( indexing( QString const & ) ) );
+
+  QEventLoop localLoop;
+
+  QObject::connect( &loadDicts, SIGNAL( finished() ),
+                    &localLoop, SLOT( quit() ) );
+
+  loadDicts.start();
+
+  localLoop.exec();
+
+  loadDicts.wait();
+
+  if ( loadDicts.getExceptionText().size() )
+  {
+    if ( showWindows )
+      QMessageBox::critical( parent, QCoreApplication::translate( "LoadDictionaries", "Error loading dictionaries" ),
+                             QString::fromUtf8( loadDicts.getExceptionText().c_str() ) );
+    else
+      gdWarning( "Error loading dictionaries: %s\n", loadDicts.getExceptionText().c_str() );
+
+    return;
+  }
+
+  loadDicts.takeDictionaries( dictionaries, knownDictionaries );
+
+  vector< sptr< Dictionary::Class > > otherDictionaries =
+    makeOtherDictionaries( loadDicts, cfg, dictNetMgr );
+
+  dictionaries.insert( dictionaries.end(), otherDictionaries.begin(),
+                       otherDictionaries.end() );
+
+  GD_DPRINTF( "Load done\n" );
+
+  removeStaleIndices( dictionaries );
 
   // Run deferred inits
 
@@ -422,6 +573,70 @@ void loadDictionaries( QWidget * parent, bool showInitially,
     doDeferredInit( dictionaries );
 }
 
+BackgroundLoadDictionaries::BackgroundLoadDictionaries( Config::Class const & cfg_,
+                                                        vector< sptr< Dictionary::Class > > const & knownDictionaries_,
+                                                        QNetworkAccessManager & dictNetMgr_ ):
+  cfg( cfg_ ),
+  knownDictionaries( knownDictionaries_ ),
+  dictNetMgr( dictNetMgr_ ),
+  loadDicts( cfg )
+{
+  loadDicts.setKnownDictionaries( knownDictionaries );
+
+  connect( &loadDicts, SIGNAL( indexingDictionarySignal( QString const & ) ),
+           this, SIGNAL( indexingDictionary( QString const & ) ) );
+
+  connect( &loadDicts, SIGNAL( finished() ),
+           this, SIGNAL( finished() ) );
+
+  connect( &loadDicts, SIGNAL( dictionariesAdded() ),
+           this, SIGNAL( dictionariesAdded() ) );
+}
+
+BackgroundLoadDictionaries::~BackgroundLoadDictionaries()
+{
+  loadDicts.cancel();
+  loadDicts.wait();
+}
+
+void BackgroundLoadDictionaries::start( QThread::Priority priority )
+{
+  otherDictionaries = makeOtherDictionaries( loadDicts, cfg, dictNetMgr );
+
+  loadDicts.start( priority );
+}
+
+void BackgroundLoadDictionaries::getAvailableDictionaries( vector< sptr< Dictionary::Class > > & dictionaries )
+{
+  loadDicts.takeDictionaries( fileDictionaries, knownDictionaries );
+
+  dictionaries = fileDictionaries;
+  dictionaries.insert( dictionaries.end(), otherDictionaries.begin(),
+                       otherDictionaries.end() );
+}
+
+bool BackgroundLoadDictionaries::getDictionaries( vector< sptr< Dictionary::Class > > & dictionaries )
+{
+  loadDicts.wait();
+
+  if ( loadDicts.getExceptionText().size() )
+  {
+    gdWarning( "Error loading dictionaries in background: %s\n",
+               loadDicts.getExceptionText().c_str() );
+    return false;
+  }
+
+  getAvailableDictionaries( dictionaries );
+
+  GD_DPRINTF( "Background load done\n" );
+
+  removeStaleIndices( dictionaries );
+
+  doDeferredInit( dictionaries );
+
+  return true;
+}
+
 void doDeferredInit( std::vector< sptr< Dictionary::Class > > & dictionaries )
 {
   for( unsigned x = 0; x < dictionaries.size(); ++x )
@@ -7,10 +7,13 @@
 #include "initializing.hh"
 #include "config.hh"
 #include "dictionary.hh"
+#include "mutex.hh"
 
 #include <QThread>
 #include <QNetworkAccessManager>
 
+#include <map>
+
 /// Use loadDictionaries() function below -- this is a helper thread class
 class LoadDictionaries: public QThread, public Dictionary::Initializing
 {
@@ -21,29 +24,64 @@ class LoadDictionaries: public QThread, public Dictionary::Initializing
   Config::SoundDirs const & soundDirs;
   Config::Hunspell const & hunspell;
   Config::Transliteration const & transliteration;
-  std::vector< sptr< Dictionary::Class > > dictionaries;
   std::string exceptionText;
   int maxPictureWidth;
   unsigned int maxHeadwordSize;
   unsigned int maxHeadwordToExpand;
 
+  /// The files of the dictionaries loaded before. The dictionary objects
+  /// themselves mustn't be touched from this thread.
+  std::vector< std::vector< std::string > > knownDictionaries;
+  std::vector< bool > knownReused;
+  /// Maps the files of the known dictionaries to their positions
+  std::map< std::string, unsigned > knownFiles;
+
+  /// The dictionaries made and not taken yet. The known dictionaries kept
+  /// are present here as null pointers, with their positions among the
+  /// known ones in reusedFrom (-1 for the ones made anew). Both are guarded
+  /// by dictionariesMutex, since they are taken from the other thread.
+  Mutex dictionariesMutex;
+  std::vector< sptr< Dictionary::Class > > dictionaries;
+  std::vector< int > reusedFrom;
+
+  QAtomicInt cancelled;
+
 public:
 
   LoadDictionaries( Config::Class const & cfg );
 
+  /// Makes the given dictionaries, loaded before, be kept instead of being
+  /// made anew when their files are found again. The ones whose files were
+  /// modified since their indices were built are released right away, so
+  /// that the indices could be rebuilt. Must be called before the thread is
+  /// started.
+  void setKnownDictionaries( std::vector< sptr< Dictionary::Class > > & );
+
   virtual void run();
 
-  std::vector< sptr< Dictionary::Class > > const & getDictionaries() const
-  { return dictionaries; }
+  /// Appends the dictionaries made since the last call to the given array,
+  /// putting the known ones kept in their places. Can be called while the
+  /// thread is still running, e.g. upon dictionariesAdded().
+  void takeDictionaries( std::vector< sptr< Dictionary::Class > > &,
+                         std::vector< sptr< Dictionary::Class > > const & knownDictionaries );
 
   /// Empty string means to exception occurred
   std::string const & getExceptionText() const
   { return exceptionText; }
 
+  /// Makes the thread stop once done with the dictionaries of the format
+  /// being loaded, since building an index can't be interrupted. The
+  /// loading counts as failed then.
+  void cancel()
+  { cancelled.ref(); }
+
 signals:
 
   void indexingDictionarySignal( QString const & dictionaryName );
 
+  /// Some more dictionaries are ready to be taken
+  void dictionariesAdded();
+
 public:
 
   virtual void indexingDictionary( std::string const & dictionaryName ) throw();
@@ -51,18 +89,95 @@ public:
 private:
 
   void handlePath( Config::Path const & );
+
+  /// Hands the dictionaries made over to takeDictionaries(), clearing the
+  /// array given.
+  void addDictionaries( std::vector< sptr< Dictionary::Class > > & );
+
+  /// Reuses the known dictionaries the given files belong to, removing all
+  /// their files from the list.
+  void reuseKnownDictionaries( std::vector< std::string > & files );
+};
+
+/// Loads all dictionaries mentioned in the configuration passed in a
+/// separate thread, with no window popping up, so that the dictionaries in
+/// use could be replaced once it's done. The known dictionaries given are
+/// kept if their files are unchanged. The ones loaded so far are available
+/// before the loading is over, which allows to use them right away.
+class BackgroundLoadDictionaries: public QObject
+{
+  Q_OBJECT
+
+  Config::Class cfg;
+  std::vector< sptr< Dictionary::Class > > knownDictionaries;
+  QNetworkAccessManager & dictNetMgr;
+  LoadDictionaries loadDicts;
+
+  /// The ones taken from the thread so far
+  std::vector< sptr< Dictionary::Class > > fileDictionaries;
+  /// The ones made synchronously upon start()
+  std::vector< sptr< Dictionary::Class > > otherDictionaries;
+
+public:
+
+  BackgroundLoadDictionaries( Config::Class const & cfg,
+                              std::vector< sptr< Dictionary::Class > > const & knownDictionaries,
+                              QNetworkAccessManager & dictNetMgr );
+
+  /// Cancels the loading and waits for it to stop
+  ~BackgroundLoadDictionaries();
+
+  /// Makes the dictionaries not needing the files right away and starts
+  /// loading the rest of them with the priority given
+  void start( QThread::Priority = QThread::LowestPriority );
+
+  bool isFinished() const
+  { return loadDicts.isFinished(); }
+
+  /// Makes the loading stop soon, see LoadDictionaries::cancel(). The
+  /// finished() signal is still emitted, and getDictionaries() fails then.
+  void cancel()
+  { loadDicts.cancel(); }
+
+  /// Waits for the loading to stop for at most the given time, returning
+  /// whether it has stopped.
+  bool wait( unsigned long msecs )
+  { return loadDicts.wait( msecs ); }
+
+  /// Fills in the dictionaries loaded, doing deferredInit() on them. Returns
+  /// false if the loading has failed. Should only be called after finished()
+  /// was emitted.
+  bool getDictionaries( std::vector< sptr< Dictionary::Class > > & );
+
+  /// Fills in the dictionaries loaded so far, in the same order they would
+  /// have in getDictionaries(). No deferredInit() is done on them.
+  void getAvailableDictionaries( std::vector< sptr< Dictionary::Class > > & );
+
+signals:
+
+  void finished();
+
+  /// More dictionaries are available from getAvailableDictionaries()
+  void dictionariesAdded();
+
+  void indexingDictionary( QString const & dictionaryName );
 };
 
 /// Loads all dictionaries mentioned in the configuration passed, into the
-/// supplied array. When necessary, a window would pop up describing the process.
+/// supplied array. The dictionaries already in the array are kept there if
+/// their files are unchanged, others are released. When necessary, a window
+/// would pop up describing the process.
 /// If showInitially is passed as true, the window will always popup.
 /// If doDeferredInit is true (default), doDeferredInit() is done on all
 /// dictionaries at the end.
+/// If showWindows is false, neither the window nor the error message would
+/// pop up, the errors are only logged then.
 void loadDictionaries( QWidget * parent, bool showInitially,
                        Config::Class const & cfg,
                        std::vector< sptr< Dictionary::Class > > &,
                        QNetworkAccessManager & dictNetMgr,
-                       bool doDeferredInit = true );
+                       bool doDeferredInit = true,
+                       bool showWindows = true );
 
 /// Runs deferredInit() on all the given dictionaries. Useful when
 /// loadDictionaries() was previously called with doDeferredInit = false.
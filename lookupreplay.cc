@@ -0,0 +1,297 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "lookupreplay.hh"
+#include "lookuptrace.hh"
+#include "article_maker.hh"
+#include "instances.hh"
+#include "loaddictionaries.hh"
+#include "lookupstats.hh"
+#include "wordfinder.hh"
+#include "gddebug.hh"
+
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+#include <map>
+
+using std::string;
+using std::vector;
+using LookupTrace::Entry;
+
+namespace LookupReplay {
+
+namespace {
+
+/// The distribution of the msecs some lookups took
+class Latencies
+{
+  vector< int > msecs;
+  unsigned unanswered;
+  bool sorted;
+
+public:
+
+  Latencies(): unanswered( 0 ), sorted( true )
+  {}
+
+  /// Negative msecs are counted as unanswered
+  void add( int );
+
+  /// Returns the msecs the given share of the lookups took at most
+  int getPercentile( double );
+
+  QString format();
+};
+
+void Latencies::add( int value )
+{
+  if ( value < 0 )
+    ++unanswered;
+  else
+  {
+    msecs.push_back( value );
+    sorted = false;
+  }
+}
+
+int Latencies::getPercentile( double share )
+{
+  if ( msecs.empty() )
+    return 0;
+
+  if ( !sorted )
+  {
+    std::sort( msecs.begin(), msecs.end() );
+    sorted = true;
+  }
+
+  size_t index = (size_t)( share * ( msecs.size() - 1 ) + 0.5 );
+
+  return msecs[ index ];
+}
+
+QString Latencies::format()
+{
+  QString result = QString( "n=%1 p50=%2 p90=%3 p99=%4 max=%5 ms" )
+                     .arg( msecs.size() )
+                     .arg( getPercentile( 0.5 ) )
+                     .arg( getPercentile( 0.9 ) )
+                     .arg( getPercentile( 0.99 ) )
+                     .arg( getPercentile( 1 ) );
+
+  if ( unanswered )
+    result += QString( ", %1 unanswered" ).arg( unanswered );
+
+  return result;
+}
+
+struct Report
+{
+  std::map< QString, Latencies > operations;
+  std::map< string, Latencies > dictionaries;
+
+  void add( vector< Entry > const & );
+};
+
+void Report::add( vector< Entry > const & entries )
+{
+  for( size_t x = 0; x < entries.size(); ++x )
+  {
+    Entry const & entry = entries[ x ];
+
+    operations[ LookupTrace::operationName( entry.operation ) ].add( entry.msecs );
+
+    for( size_t y = 0; y < entry.dictionaries.size(); ++y )
+      dictionaries[ entry.dictionaries[ y ].dictionaryId ].add( entry.dictionaries[ y ].msecs );
+  }
+}
+
+}
+
+int run( Config::Class const & cfg, QString const & traceFileName )
+{
+  vector< Entry > recorded;
+  QString error;
+
+  if ( !LookupTrace::readTrace( traceFileName, recorded, error ) )
+  {
+    gdWarning( "Can't read the lookup trace \"%s\": %s\n",
+               traceFileName.toUtf8().data(), error.toUtf8().data() );
+    return 1;
+  }
+
+  QNetworkAccessManager dictNetMgr;
+  vector< sptr< Dictionary::Class > > dictionaries;
+
+  loadDictionaries( 0, false, cfg, dictionaries, dictNetMgr, true, false );
+
+  std::map< string, sptr< Dictionary::Class > > dictionariesById;
+
+  for( size_t x = 0; x < dictionaries.size(); ++x )
+  {
+    dictionaries[ x ]->setSynonymSearchEnabled( cfg.preferences.synonymSearchEnabled );
+    dictionariesById[ dictionaries[ x ]->getId() ] = dictionaries[ x ];
+  }
+
+  // The groups are made the same way MainWindow::updateGroupList() does
+
+  Instances::Groups groups;
+  Instances::DictionaryIndex dictionaryIndex( dictionaries );
+
+  {
+    Instances::Group g( cfg.dictionaryOrder, dictionaryIndex, Config::Group() );
+
+    Instances::complementDictionaryOrder( g,
+                                          Instances::Group( cfg.inactiveDictionaries, dictionaryIndex, Config::Group() ),
+                                          dictionaries );
+
+    g.id = Instances::Group::AllGroupId;
+
+    groups.push_back( g );
+  }
+
+  for( int x = 0; x < cfg.groups.size(); ++x )
+    groups.push_back( Instances::Group( cfg.groups[ x ], dictionaryIndex, cfg.inactiveDictionaries ) );
+
+  ArticleMaker articleMaker( dictionaries, groups, cfg.preferences.displayStyle,
+                             cfg.preferences.addonStyle );
+
+  unsigned skipped = 0;
+
+  LookupTrace::startCollecting();
+
+  for( size_t x = 0; x < recorded.size(); ++x )
+  {
+    Entry const & entry = recorded[ x ];
+
+    // Only the dictionaries queried back then are queried now
+
+    vector< sptr< Dictionary::Class > > dicts;
+    QSet< QString > dictIds;
+
+    for( size_t y = 0; y < entry.dictionaries.size(); ++y )
+    {
+      std::map< string, sptr< Dictionary::Class > >::const_iterator i =
+        dictionariesById.find( entry.dictionaries[ y ].dictionaryId );
+
+      if ( i != dictionariesById.end() )
+      {
+        dicts.push_back( i->second );
+        dictIds.insert( QString::fromUtf8( i->first.c_str() ) );
+      }
+    }
+
+    if ( dicts.empty() && !entry.dictionaries.empty() )
+    {
+      ++skipped;
+      continue;
+    }
+
+    // Every lookup starts cold, as the repeated ones would otherwise be
+    // answered by the requests and the stats left by the ones before
+
+    articleMaker.clearSharedRequests();
+    LookupStats::instance().clear();
+
+    // The finished() signals are connected before checking, so that they
+    // can't be missed
+
+    QEventLoop loop;
+
+    if ( entry.operation == LookupTrace::Article )
+    {
+      // The rest of the group is muted
+
+      vector< sptr< Dictionary::Class > > const * groupDicts = &dictionaries;
+
+      for( size_t y = 0; y < groups.size(); ++y )
+        if ( groups[ y ].id == entry.groupId )
+          groupDicts = &groups[ y ].dictionaries;
+
+      QSet< QString > mutedDicts;
+
+      for( size_t y = 0; y < groupDicts->size(); ++y )
+      {
+        QString id = QString::fromUtf8( (*groupDicts)[ y ]->getId().c_str() );
+
+        if ( !dictIds.contains( id ) )
+          mutedDicts.insert( id );
+      }
+
+      sptr< Dictionary::DataRequest > r =
+        articleMaker.makeDefinitionFor( Config::InputPhrase::fromPhrase( entry.word ),
+                                        entry.groupId, QMap< QString, QString >(), mutedDicts );
+
+      QObject::connect( r.get(), SIGNAL( finished() ), &loop, SLOT( quit() ),
+                        Qt::QueuedConnection );
+
+      if ( !r->isFinished() )
+        loop.exec();
+    }
+    else
+    {
+      WordFinder finder( 0 );
+
+      QObject::connect( &finder, SIGNAL( finished() ), &loop, SLOT( quit() ),
+                        Qt::QueuedConnection );
+
+      if ( entry.operation == LookupTrace::PrefixMatch )
+        finder.prefixMatch( entry.word, dicts, entry.maxResults );
+      else
+        finder.expressionMatch( entry.word, dicts, entry.maxResults );
+
+      if ( !finder.isSearchFinished() )
+        loop.exec();
+    }
+  }
+
+  LookupTrace::stop();
+
+  vector< Entry > replayed = LookupTrace::takeCollected();
+
+  Report recordedReport, replayedReport;
+
+  recordedReport.add( recorded );
+  replayedReport.add( replayed );
+
+  QTextStream out( stdout );
+
+  out << QString( "Lookups recorded: %1, replayed: %2, skipped for their dictionaries "
+                  "are missing: %3\n\n" ).arg( recorded.size() ).arg( replayed.size() ).arg( skipped );
+
+  for( std::map< QString, Latencies >::iterator i = replayedReport.operations.begin();
+       i != replayedReport.operations.end(); ++i )
+  {
+    out << i->first << ", recorded: " << recordedReport.operations[ i->first ].format() << "\n";
+    out << i->first << ", replayed: " << i->second.format() << "\n";
+  }
+
+  // The slowest dictionaries go first
+
+  vector< std::pair< int, string > > slowest;
+
+  for( std::map< string, Latencies >::iterator i = replayedReport.dictionaries.begin();
+       i != replayedReport.dictionaries.end(); ++i )
+    slowest.push_back( std::make_pair( -i->second.getPercentile( 0.9 ), i->first ) );
+
+  std::sort( slowest.begin(), slowest.end() );
+
+  out << "\nPer dictionary, the slowest first:\n";
+
+  for( size_t x = 0; x < slowest.size(); ++x )
+  {
+    string const & id = slowest[ x ].second;
+
+    out << QString::fromUtf8( dictionariesById[ id ]->getName().c_str() )
+        << " (" << QString::fromUtf8( id.c_str() ) << ")\n";
+    out << "  recorded: " << recordedReport.dictionaries[ id ].format() << "\n";
+    out << "  replayed: " << replayedReport.dictionaries[ id ].format() << "\n";
+  }
+
+  return 0;
+}
+
+}
@@ -0,0 +1,25 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __LOOKUPREPLAY_HH_INCLUDED__
+#define __LOOKUPREPLAY_HH_INCLUDED__
+
+#include <QString>
+#include "config.hh"
+
+/// Replays the lookups of a trace recorded by LookupTrace, so that the
+/// performance problems could be reproduced, and their fixes checked, with
+/// the same lookups made against the same or some other set of dictionaries.
+namespace LookupReplay {
+
+/// Loads the dictionaries of the given configuration, with no windows shown,
+/// and makes the lookups of the trace through the same code the windows
+/// use, one after another and each with no requests or stats left by the
+/// ones before, so that they don't affect each other. The lookups whose dictionaries are all missing are skipped.
+/// Prints the latencies recorded and replayed to stdout, overall and per
+/// dictionary. Returns the exit code for main().
+int run( Config::Class const &, QString const & traceFileName );
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "lookupstats.hh"
+
+#include <algorithm>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+enum
+{
+  /// The counters are halved once this many lookups were made, so that the
+  /// recent lookups would weigh more
+  MaxLookups = 1000,
+  /// The lookups needed to tell that a dictionary is rarely found in
+  MinLookups = 20
+};
+
+/// A dictionary finding less than this share of the words is rarely found in
+double const RareYield = 0.1;
+
+struct YieldGreater
+{
+  vector< double > const & yields;
+
+  YieldGreater( vector< double > const & yields_ ): yields( yields_ )
+  {}
+
+  bool operator () ( unsigned a, unsigned b ) const
+  { return yields[ a ] > yields[ b ]; }
+};
+
+}
+
+LookupStats & LookupStats::instance()
+{
+  static LookupStats stats;
+
+  return stats;
+}
+
+void LookupStats::addLookup( string const & dictionaryId, bool found )
+{
+  Mutex::Lock _( mutex );
+
+  Counters & c = counters[ dictionaryId ];
+
+  ++c.lookups;
+
+  if ( found )
+    ++c.hits;
+
+  if ( c.lookups >= MaxLookups )
+  {
+    c.lookups /= 2;
+    c.hits /= 2;
+  }
+}
+
+vector< unsigned > LookupStats::getQueryOrder( vector< sptr< Dictionary::Class > > const & dictionaries )
+{
+  vector< double > yields( dictionaries.size() );
+  vector< unsigned > order( dictionaries.size() );
+
+  {
+    Mutex::Lock _( mutex );
+
+    for( unsigned x = 0; x < dictionaries.size(); ++x )
+    {
+      std::map< string, Counters >::const_iterator i =
+        counters.find( dictionaries[ x ]->getId() );
+
+      yields[ x ] = i != counters.end() ? i->second.getYield() : Counters().getYield();
+      order[ x ] = x;
+    }
+  }
+
+  std::stable_sort( order.begin(), order.end(), YieldGreater( yields ) );
+
+  return order;
+}
+
+bool LookupStats::isRarelyFound( string const & dictionaryId )
+{
+  Mutex::Lock _( mutex );
+
+  std::map< string, Counters >::const_iterator i = counters.find( dictionaryId );
+
+  return i != counters.end() && i->second.lookups >= MinLookups
+         && i->second.getYield() < RareYield;
+}
+
+void LookupStats::clear()
+{
+  Mutex::Lock _( mutex );
+
+  counters.clear();
+}
@@ -0,0 +1,63 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __LOOKUPSTATS_HH_INCLUDED__
+#define __LOOKUPSTATS_HH_INCLUDED__
+
+#include "dictionary.hh"
+#include "mutex.hh"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// Counts how often the lookups find anything in each dictionary, so that
+/// the dictionaries which are useful the most could be queried first, and
+/// the ones which hardly ever have the words asked for could be checked
+/// before being queried. A single instance is shared by everyone, it can be
+/// used from any thread.
+class LookupStats
+{
+public:
+
+  static LookupStats & instance();
+
+  /// Records a lookup of an article in the given dictionary
+  void addLookup( std::string const & dictionaryId, bool found );
+
+  /// Returns the positions of the given dictionaries in the order they are
+  /// to be queried in: the ones finding the words most often go first. The
+  /// ones which do equally well keep their order.
+  std::vector< unsigned > getQueryOrder( std::vector< sptr< Dictionary::Class > > const & );
+
+  /// Returns true if the dictionary was looked up often enough to tell that
+  /// it rarely has the words asked for. Such dictionaries are worth asking
+  /// Dictionary::Class::mayHaveArticles() before being queried.
+  bool isRarelyFound( std::string const & dictionaryId );
+
+  /// Forgets all the lookups recorded
+  void clear();
+
+private:
+
+  struct Counters
+  {
+    unsigned lookups, hits;
+
+    Counters(): lookups( 0 ), hits( 0 )
+    {}
+
+    /// The share of the lookups which found anything. The dictionaries not
+    /// looked up yet are considered to be halfway.
+    double getYield() const
+    { return ( hits + 1.0 ) / ( lookups + 2.0 ); }
+  };
+
+  Mutex mutex;
+  std::map< std::string, Counters > counters;
+
+  LookupStats()
+  {}
+};
+
+#endif
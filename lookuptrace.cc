@@ -0,0 +1,396 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "lookuptrace.hh"
+#include "gddebug.hh"
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+using std::string;
+using std::vector;
+
+namespace LookupTrace {
+
+namespace {
+
+char const * const Header = "# GoldenDict lookup trace";
+
+struct State
+{
+  bool recording, collecting;
+  unsigned recordingId; // Tells the lookups started before apart
+  QFile file;
+  vector< Entry > collected;
+  QElapsedTimer started;
+
+  State(): recording( false ), collecting( false ), recordingId( 0 )
+  {}
+};
+
+State & state()
+{
+  static State s;
+
+  return s;
+}
+
+/// Escapes the characters which would break up the line into fields
+QString escapeField( QString const & str )
+{
+  QString result;
+
+  result.reserve( str.size() );
+
+  for( int x = 0; x < str.size(); ++x )
+  {
+    QChar ch = str[ x ];
+
+    if ( ch == '\\' )
+      result += "\\\\";
+    else
+    if ( ch == '\t' )
+      result += "\\t";
+    else
+    if ( ch == '\n' )
+      result += "\\n";
+    else
+    if ( ch == '\r' )
+      result += "\\r";
+    else
+      result += ch;
+  }
+
+  return result;
+}
+
+QString unescapeField( QString const & str )
+{
+  QString result;
+
+  result.reserve( str.size() );
+
+  for( int x = 0; x < str.size(); ++x )
+  {
+    QChar ch = str[ x ];
+
+    if ( ch == '\\' && x + 1 < str.size() )
+    {
+      ch = str[ ++x ];
+
+      if ( ch == 't' )
+        ch = '\t';
+      else
+      if ( ch == 'n' )
+        ch = '\n';
+      else
+      if ( ch == 'r' )
+        ch = '\r';
+    }
+
+    result += ch;
+  }
+
+  return result;
+}
+
+QString formatEntry( Entry const & entry )
+{
+  QString line = QString( "%1\t%2\t%3\t%4\t%5\t" ).arg( entry.startedAt )
+                                                  .arg( operationName( entry.operation ) )
+                                                  .arg( entry.groupId )
+                                                  .arg( entry.maxResults )
+                                                  .arg( entry.msecs );
+
+  line += escapeField( entry.word ) + '\t';
+
+  for( size_t x = 0; x < entry.dictionaries.size(); ++x )
+  {
+    DictionaryTime const & d = entry.dictionaries[ x ];
+
+    if ( x )
+      line += ' ';
+
+    line += QString( "%1:%2:%3" ).arg( QString::fromUtf8( d.dictionaryId.c_str() ) )
+                                 .arg( d.msecs )
+                                 .arg( d.found ? 1 : 0 );
+  }
+
+  return line;
+}
+
+bool parseOperation( QString const & name, Operation & operation )
+{
+  for( int x = PrefixMatch; x <= Article; ++x )
+  {
+    if ( name == operationName( (Operation) x ) )
+    {
+      operation = (Operation) x;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool parseEntry( QString const & line, Entry & entry )
+{
+  QStringList fields = line.split( '\t' );
+
+  if ( fields.size() != 7 )
+    return false;
+
+  bool ok[ 4 ];
+
+  entry.startedAt = fields[ 0 ].toLongLong( &ok[ 0 ] );
+  entry.groupId = fields[ 2 ].toUInt( &ok[ 1 ] );
+  entry.maxResults = fields[ 3 ].toUInt( &ok[ 2 ] );
+  entry.msecs = fields[ 4 ].toInt( &ok[ 3 ] );
+
+  if ( !ok[ 0 ] || !ok[ 1 ] || !ok[ 2 ] || !ok[ 3 ]
+       || !parseOperation( fields[ 1 ], entry.operation ) )
+    return false;
+
+  entry.word = unescapeField( fields[ 5 ] );
+
+  QStringList items = fields[ 6 ].split( ' ', QString::SkipEmptyParts );
+
+  entry.dictionaries.resize( items.size() );
+
+  for( int x = 0; x < items.size(); ++x )
+  {
+    QStringList parts = items[ x ].split( ':' );
+
+    if ( parts.size() != 3 )
+      return false;
+
+    DictionaryTime & d = entry.dictionaries[ x ];
+
+    d.dictionaryId = parts[ 0 ].toUtf8().data();
+    d.msecs = parts[ 1 ].toInt( &ok[ 0 ] );
+    d.found = parts[ 2 ] == "1";
+
+    if ( !ok[ 0 ] )
+      return false;
+  }
+
+  return true;
+}
+
+void record( Entry const & entry )
+{
+  State & s = state();
+
+  if ( s.collecting )
+  {
+    s.collected.push_back( entry );
+    return;
+  }
+
+  // Flushed right away, since the traces are wanted the most when the
+  // program gets stuck or crashes
+  s.file.write( formatEntry( entry ).toUtf8() + '\n' );
+  s.file.flush();
+}
+
+}
+
+bool startRecording( QString const & fileName )
+{
+  stop();
+
+  State & s = state();
+
+  s.file.setFileName( fileName );
+
+  if ( !s.file.open( QIODevice::WriteOnly | QIODevice::Append ) )
+  {
+    gdWarning( "Can't open the lookup trace \"%s\": %s\n",
+               fileName.toUtf8().data(), s.file.errorString().toUtf8().data() );
+    return false;
+  }
+
+  if ( !s.file.size() )
+  {
+    s.file.write( Header );
+    s.file.write( "\n" );
+  }
+
+  s.recording = true;
+  ++s.recordingId;
+  s.started.start();
+
+  return true;
+}
+
+void startCollecting()
+{
+  stop();
+
+  State & s = state();
+
+  s.recording = s.collecting = true;
+  ++s.recordingId;
+  s.started.start();
+}
+
+void stop()
+{
+  State & s = state();
+
+  s.recording = s.collecting = false;
+  ++s.recordingId;
+
+  if ( s.file.isOpen() )
+    s.file.close();
+}
+
+bool isRecording()
+{
+  return state().recording;
+}
+
+vector< Entry > takeCollected()
+{
+  vector< Entry > result;
+
+  result.swap( state().collected );
+
+  return result;
+}
+
+bool readTrace( QString const & fileName, vector< Entry > & entries, QString & error )
+{
+  QFile file( fileName );
+
+  if ( !file.open( QIODevice::ReadOnly ) )
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  QTextStream in( &file );
+
+  in.setCodec( "UTF-8" );
+
+  for( unsigned lineNumber = 1; !in.atEnd(); ++lineNumber )
+  {
+    QString line = in.readLine();
+
+    if ( line.isEmpty() || line.startsWith( '#' ) )
+      continue;
+
+    Entry entry;
+
+    if ( !parseEntry( line, entry ) )
+    {
+      error = QString( "malformed line %1" ).arg( lineNumber );
+      return false;
+    }
+
+    entries.push_back( entry );
+  }
+
+  return true;
+}
+
+QString operationName( Operation operation )
+{
+  switch( operation )
+  {
+    case PrefixMatch:
+      return "prefix";
+    case ExpressionMatch:
+      return "expression";
+    case Article:
+      return "article";
+  }
+
+  return QString();
+}
+
+Lookup::Lookup( Operation operation, QString const & word, unsigned groupId,
+                unsigned maxResults ):
+  recording( state().recordingId ), finished( false )
+{
+  entry.startedAt = state().started.elapsed();
+  entry.operation = operation;
+  entry.groupId = groupId;
+  entry.maxResults = maxResults;
+  entry.word = word;
+
+  timer.start();
+}
+
+Lookup::~Lookup()
+{
+  finish( false );
+}
+
+void Lookup::addRequest( void const * request, string const & dictionaryId )
+{
+  if ( finished || pendingRequests.count( request ) )
+    return;
+
+  std::map< string, unsigned >::iterator i = dictionaryIndices.find( dictionaryId );
+
+  if ( i == dictionaryIndices.end() )
+  {
+    i = dictionaryIndices.insert( std::make_pair( dictionaryId,
+                                                  (unsigned) entry.dictionaries.size() ) ).first;
+
+    entry.dictionaries.push_back( DictionaryTime() );
+    entry.dictionaries.back().dictionaryId = dictionaryId;
+    pendingCounts.push_back( 0 );
+  }
+
+  pendingRequests[ request ] = i->second;
+  ++pendingCounts[ i->second ];
+}
+
+void Lookup::requestFinished( void const * request, bool found )
+{
+  std::map< void const *, unsigned >::iterator i = pendingRequests.find( request );
+
+  if ( i == pendingRequests.end() )
+    return;
+
+  unsigned index = i->second;
+
+  pendingRequests.erase( i );
+
+  DictionaryTime & d = entry.dictionaries[ index ];
+
+  if ( found )
+    d.found = true;
+
+  if ( !--pendingCounts[ index ] )
+    d.msecs = (int) timer.elapsed();
+}
+
+void Lookup::finish( bool completed )
+{
+  if ( finished )
+    return;
+
+  finished = true;
+
+  entry.msecs = completed ? (int) timer.elapsed() : -1;
+
+  State & s = state();
+
+  if ( s.recording && s.recordingId == recording )
+    record( entry );
+}
+
+sptr< Lookup > startLookup( Operation operation, QString const & word,
+                            unsigned groupId, unsigned maxResults )
+{
+  if ( !state().recording )
+    return sptr< Lookup >();
+
+  return new Lookup( operation, word, groupId, maxResults );
+}
+
+}
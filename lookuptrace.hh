@@ -0,0 +1,126 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __LOOKUPTRACE_HH_INCLUDED__
+#define __LOOKUPTRACE_HH_INCLUDED__
+
+#include <QString>
+#include <QElapsedTimer>
+#include <map>
+#include <string>
+#include <vector>
+#include "sptr.hh"
+
+/// Records the lookups made, along with the time each of the dictionaries
+/// queried took to answer, so that the slow ones could be told apart and
+/// the lookups could be replayed later on, see LookupReplay. Nothing is
+/// recorded unless the recording was started. Used from the GUI thread only.
+///
+/// The trace is a text file, each lookup taking a line of tab-separated
+/// fields: the msecs since the recording started, the operation, the group
+/// id, the maximum number of results, the msecs the whole lookup took (-1 if
+/// it was cancelled), the word, and the dictionaries queried as
+/// "<id>:<msecs>:<found>" items separated by spaces, where the msecs are -1
+/// if the dictionary didn't answer.
+namespace LookupTrace {
+
+enum Operation
+{
+  PrefixMatch,     // Done by WordFinder
+  ExpressionMatch, // Done by WordFinder
+  Article          // Done by ArticleMaker
+};
+
+struct DictionaryTime
+{
+  std::string dictionaryId;
+  int msecs; // -1 if it didn't answer
+  bool found;
+
+  DictionaryTime(): msecs( -1 ), found( false )
+  {}
+};
+
+/// A single lookup recorded
+struct Entry
+{
+  qint64 startedAt; // Msecs since the recording started
+  Operation operation;
+  unsigned groupId; // Only known for the articles, 0 otherwise
+  unsigned maxResults; // Only used by the searches
+  int msecs; // -1 if the lookup was cancelled
+  QString word;
+  std::vector< DictionaryTime > dictionaries;
+
+  Entry(): startedAt( 0 ), operation( PrefixMatch ), groupId( 0 ),
+    maxResults( 0 ), msecs( -1 )
+  {}
+};
+
+/// Starts appending the lookups to the given trace file. Returns false if
+/// it couldn't be opened, the reason is logged.
+bool startRecording( QString const & fileName );
+
+/// Starts keeping the lookups in memory instead, see takeCollected()
+void startCollecting();
+
+/// Stops the recording. The lookups still running aren't recorded.
+void stop();
+
+bool isRecording();
+
+/// Returns the lookups kept since startCollecting(), forgetting them
+std::vector< Entry > takeCollected();
+
+/// Reads the whole trace file. Returns false on failure, with the reason
+/// stored in 'error'.
+bool readTrace( QString const & fileName, std::vector< Entry > &, QString & error );
+
+QString operationName( Operation );
+
+/// Tracks a single lookup while it runs. The lookups make it with
+/// startLookup() and tell it about their requests. It's recorded once
+/// finished, or as cancelled when destroyed before that.
+class Lookup
+{
+public:
+
+  Lookup( Operation, QString const & word, unsigned groupId, unsigned maxResults );
+
+  ~Lookup();
+
+  /// Tells that the given dictionary is queried with the given request. A
+  /// dictionary may be queried with several requests, it is considered to
+  /// have answered once all of them have finished.
+  void addRequest( void const * request, std::string const & dictionaryId );
+
+  /// Tells that the given request has finished. The requests which have
+  /// already been told about, or weren't added, are ignored, so this can be
+  /// called on each check of the requests.
+  void requestFinished( void const * request, bool found );
+
+  /// Records the lookup, unless it was recorded before. The lookups not
+  /// completed are recorded as cancelled.
+  void finish( bool completed = true );
+
+private:
+
+  Entry entry;
+  QElapsedTimer timer;
+  unsigned recording; // Of the recording the lookup belongs to
+  bool finished;
+
+  /// The requests pending, mapped to their dictionaries in the entry
+  std::map< void const *, unsigned > pendingRequests;
+  std::vector< unsigned > pendingCounts; // Per dictionary in the entry
+  std::map< std::string, unsigned > dictionaryIndices;
+};
+
+/// Returns the tracker for the new lookup, or an empty pointer if nothing
+/// is being recorded.
+sptr< Lookup > startLookup( Operation, QString const & word,
+                            unsigned groupId = 0, unsigned maxResults = 0 );
+
+}
+
+#endif
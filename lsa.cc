@@ -7,6 +7,7 @@
 #include "folding.hh"
 #include "utf8.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "fsencoding.hh"
 #include "audiolink.hh"
 #include "gddebug.hh"
@@ -222,16 +223,7 @@ sptr< Dictionary::DataRequest > LsaDictionary::getArticle( wstring const & word,
                                                            bool ignoreDiacritics )
   THROW_SPEC( std::exception )
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, string > mainArticles, alternateArticles;
 
@@ -563,6 +555,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
 
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         // Building the index
 
         gdDebug( "Lsa: Building the index for dictionary: %s\n", i->c_str() );
@@ -37,6 +37,10 @@
 #include <QString>
 
 #include "gddebug.hh"
+#include "lookuptrace.hh"
+#include "lookupreplay.hh"
+#include "loaddictionaries.hh"
+#include "xdxf.hh"
 
 #if defined( Q_OS_MAC ) && QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #include "lionsupport.h"
@@ -116,10 +120,11 @@ class GDCommandLine
   static int invalidWordsZoomLevel() { return std::numeric_limits< int >::max(); }
   static double invalidZoomFactor() { return std::numeric_limits< double >::max(); }
 
-  bool crashReport, toggleScanPopup, logFile;
+  bool crashReport, toggleScanPopup, logFile, checkXdxf2Html;
   int wordsZoomLevel;
   double zoomFactor;
   QString word, groupName, popupGroupName, errFileName;
+  QString recordLookupsFile, replayLookupsFile;
   QVector< QString > arguments;
 public:
   GDCommandLine( int argc, char **argv );
@@ -153,6 +158,21 @@ public:
   inline bool needLogFile()
   { return logFile; }
 
+  inline bool needRecordLookups()
+  { return !recordLookupsFile.isEmpty(); }
+
+  inline QString getRecordLookupsFile()
+  { return recordLookupsFile; }
+
+  inline bool needReplayLookups()
+  { return !replayLookupsFile.isEmpty(); }
+
+  inline QString getReplayLookupsFile()
+  { return replayLookupsFile; }
+
+  inline bool needCheckXdxf2Html()
+  { return checkXdxf2Html; }
+
   inline bool needTranslateWord()
   { return !word.isEmpty(); }
 
@@ -164,6 +184,7 @@ GDCommandLine::GDCommandLine( int argc, char **argv ):
 crashReport( false ),
 toggleScanPopup( false ),
 logFile( false ),
+checkXdxf2Html( false ),
 wordsZoomLevel( invalidWordsZoomLevel() ),
 zoomFactor( invalidZoomFactor() )
 {
@@ -230,6 +251,24 @@ zoomFactor( invalidZoomFactor() )
         popupGroupName = arguments[ i ].mid( arguments[ i ].indexOf( '=' ) + 1 );
         continue;
       }
+      else
+      if( arguments[ i ].startsWith( "--record-lookups=" ) )
+      {
+        recordLookupsFile = arguments[ i ].mid( arguments[ i ].indexOf( '=' ) + 1 );
+        continue;
+      }
+      else
+      if( arguments[ i ].startsWith( "--replay-lookups=" ) )
+      {
+        replayLookupsFile = arguments[ i ].mid( arguments[ i ].indexOf( '=' ) + 1 );
+        continue;
+      }
+      else
+      if( arguments[ i ].compare( "--check-xdxf2html" ) == 0 )
+      {
+        checkXdxf2Html = true;
+        continue;
+      }
       else
         word = arguments[ i ];
     }
@@ -336,6 +375,15 @@ int main( int argc, char ** argv )
   QHotkeyApplication app( "GoldenDict", argc, argv );
   LogFilePtrGuard logFilePtrGuard;
 
+  // The replay and the check may rebuild and remove the indices the running
+  // instance uses
+  if ( app.isRunning() && ( gdcl.needReplayLookups() || gdcl.needCheckXdxf2Html() ) )
+  {
+    gdWarning( "Can't replay the lookups or check the conversion while GoldenDict is running, "
+               "quit it first\n" );
+    return 1;
+  }
+
   if ( app.isRunning() )
   {
     bool wasMessage = false;
@@ -480,6 +528,19 @@ int main( int argc, char ** argv )
     translator.load( Config::getLocDir() + "/" + localeName );
   }
 
+  if ( gdcl.needReplayLookups() )
+    return LookupReplay::run( cfg, gdcl.getReplayLookupsFile() );
+
+  if ( gdcl.needCheckXdxf2Html() )
+  {
+    QNetworkAccessManager dictNetMgr;
+    std::vector< sptr< Dictionary::Class > > dictionaries;
+
+    loadDictionaries( 0, false, cfg, dictionaries, dictNetMgr, true, false );
+
+    return Xdxf::checkConversion( dictionaries );
+  }
+
   // Prevent app from quitting spontaneously when it works with scan popup
   // and with the main window closed.
   app.setQuitOnLastWindowClosed( false );
@@ -490,6 +551,9 @@ int main( int argc, char ** argv )
   QWebSecurityOrigin::addLocalScheme( "gdlookup" );
 #endif
 
+  if ( gdcl.needRecordLookups() )
+    LookupTrace::startRecording( gdcl.getRecordLookupsFile() );
+
   MainWindow m( cfg );
 
   app.addDataCommiter( m );
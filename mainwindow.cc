@@ -13,6 +13,7 @@
 #include "mruqmenu.hh"
 #include "gestures.hh"
 #include "dictheadwords.hh"
+#include "website.hh"
 #include <limits.h>
 #include <QDebug>
 #include <QTextStream>
@@ -34,6 +35,8 @@
 #include <QRunnable>
 #include <QThreadPool>
 #include <QSslConfiguration>
+#include <QDirIterator>
+#include <QDateTime>
 
 #include <limits.h>
 #include <set>
@@ -121,12 +124,16 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
   audioPlayerFactory( cfg.preferences ),
   wordFinder( this ),
   newReleaseCheckTimer( this ),
+  tabHibernationTimer( this ),
+  dictionaryWatcher( this ),
+  dictionaryWatchTimer( this ),
   latestReleaseReply( 0 ),
   wordListSelChanged( false )
 , wasMaximized( false )
 , blockUpdateWindowTitle( false )
 , headwordsDlg( 0 )
 , ftsIndexing( dictionaries )
+, ftsIndexingPending( false )
 , ftsDlg( 0 )
 , helpWindow( 0 )
 , starIcon( ":/icons/star.png" )
@@ -775,6 +782,15 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
 
   makeDictionaries();
 
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
+  if ( cfg.queryServer.enabled )
+  {
+    queryServer.reset( new QueryServer( 0, dictionaries, groupInstances,
+                                        articleMaker, articleNetMgr ) );
+    queryServer->listen( cfg.queryServer );
+  }
+#endif
+
   // After we have dictionaries and groups, we can populate history
 //  historyChanged();
 
@@ -853,6 +869,31 @@ MainWindow::MainWindow( Config::Class & cfg_ ):
   connect( &newReleaseCheckTimer, SIGNAL( timeout() ),
            this, SLOT( checkForNewRelease() ) );
 
+  connect( &tabHibernationTimer, SIGNAL( timeout() ),
+           this, SLOT( hibernateIdleTabs() ) );
+
+  connect( &tabHibernationTimer, SIGNAL( timeout() ),
+           this, SLOT( releaseIdleMetadata() ) );
+
+  tabHibernationTimer.start( 60 * 1000 );
+
+  dictionaryWatchTimer.setSingleShot( true );
+  dictionaryWatchTimer.setInterval( 3000 );
+
+  connect( &dictionaryWatcher, SIGNAL( directoryChanged( QString ) ),
+           this, SLOT( dictionaryFolderChanged( QString ) ) );
+
+  connect( &dictionaryWatchTimer, SIGNAL( timeout() ),
+           this, SLOT( reloadChangedDictionaries() ) );
+
+  dictionariesAvailableTimer.setSingleShot( true );
+  dictionariesAvailableTimer.setInterval( 3000 );
+
+  connect( &dictionariesAvailableTimer, SIGNAL( timeout() ),
+           this, SLOT( applyAvailableDictionaries() ) );
+
+  watchDictionaryFolders();
+
   if ( cfg.preferences.hideMenubar )
   {
     toggleMenuBarTriggered( false );
@@ -1335,7 +1376,60 @@ void MainWindow::makeDictionaries()
   ftsIndexing.stopIndexing();
   ftsIndexing.clearDictionaries();
 
-  loadDictionaries( this, isVisible(), cfg, dictionaries, dictNetMgr, false );
+  // The dictionaries are loaded in background, so that the window could be
+  // used right away. The ones loaded are put to use as they arrive, see
+  // applyAvailableDictionaries()
+  backgroundLoad = new BackgroundLoadDictionaries( cfg, dictionaries, dictNetMgr );
+
+  connect( backgroundLoad.get(), SIGNAL( finished() ),
+           this, SLOT( backgroundLoadFinished() ), Qt::QueuedConnection );
+
+  connect( backgroundLoad.get(), SIGNAL( indexingDictionary( QString const & ) ),
+           this, SLOT( backgroundIndexing( QString const & ) ) );
+
+  connect( backgroundLoad.get(), SIGNAL( dictionariesAdded() ),
+           this, SLOT( backgroundDictionariesAdded() ), Qt::QueuedConnection );
+
+  backgroundLoad->start( QThread::InheritPriority );
+
+  backgroundLoad->getAvailableDictionaries( dictionaries );
+
+  articleNetMgr.getResourceCache().clear();
+  articleMaker.clearSharedRequests();
+
+  for( unsigned x = 0; x < dictionaries.size(); x++ )
+  {
+    dictionaries[ x ]->setFTSParameters( cfg.preferences.fts );
+    dictionaries[ x ]->setSynonymSearchEnabled( cfg.preferences.synonymSearchEnabled );
+  }
+
+  // Started once all of them are there, see backgroundLoadFinished()
+  ftsIndexingPending = true;
+
+  prefetchWebSiteArticles();
+
+  updateStatusLine();
+  updateGroupList();
+}
+
+void MainWindow::setDictionaries( vector< sptr< Dictionary::Class > > const & newDictionaries )
+{
+  scanPopup.reset(); // It does not support dictionaries changes
+  closeHeadwordsDialog();
+  closeFullTextSearchDialog();
+
+  ftsIndexing.stopIndexing();
+  ftsIndexing.clearDictionaries();
+
+  wordFinder.clear();
+
+  groupInstances.clear(); // Release all the dictionaries they hold
+  dictionariesUnmuted.clear();
+
+  dictionaries = newDictionaries;
+
+  articleNetMgr.getResourceCache().clear();
+  articleMaker.clearSharedRequests();
 
   for( unsigned x = 0; x < dictionaries.size(); x++ )
   {
@@ -1345,9 +1439,297 @@ void MainWindow::makeDictionaries()
 
   ftsIndexing.setDictionaries( dictionaries );
   ftsIndexing.doIndexing();
+  ftsIndexingPending = false;
+
+  updateGroupList();
+
+  makeScanPopup();
+  installHotKeys();
 
+  updateSuggestionList();
   updateStatusLine();
+}
+
+void MainWindow::watchDictionaryFolders()
+{
+  QStringList folders;
+
+  for( int x = 0; x < cfg.paths.size(); ++x )
+  {
+    QDir dir( cfg.paths[ x ].path );
+
+    if ( !dir.exists() )
+      continue;
+
+    folders.append( dir.absolutePath() );
+
+    if ( !cfg.paths[ x ].recursive )
+      continue;
+
+    QDirIterator it( dir.absolutePath(), QDir::Dirs | QDir::NoDotAndDotDot,
+                     QDirIterator::Subdirectories );
+
+    while( it.hasNext() )
+    {
+      QString folder = it.next();
+
+      // Skip the dsl resources, just like the dictionary loading does
+      if ( !folder.endsWith( ".dsl.files", Qt::CaseInsensitive ) &&
+           !folder.endsWith( ".dsl.dz.files", Qt::CaseInsensitive ) )
+        folders.append( folder );
+    }
+  }
+
+  QStringList watched = dictionaryWatcher.directories();
+
+  if ( !watched.isEmpty() )
+    dictionaryWatcher.removePaths( watched );
+
+  if ( !folders.isEmpty() )
+    dictionaryWatcher.addPaths( folders );
+
+  dictionaryWatcher.blockSignals( false );
+}
+
+void MainWindow::stopWatchingDictionaryFolders()
+{
+  dictionaryWatcher.blockSignals( true );
+  dictionaryWatchTimer.stop();
+  dictionariesAvailableTimer.stop();
+  changedDictionaryFolders.clear();
+
+  // The dictionaries are loaded anew then, along with the indexing
+  ftsIndexingPending = false;
+
+  if ( !backgroundLoad )
+    return;
+
+  // Taken out first, so that the signals it has queued are ignored
+  sptr< BackgroundLoadDictionaries > load = backgroundLoad;
+
+  backgroundLoad.reset();
+
+  load->cancel();
+
+  if ( load->wait( 100 ) )
+    return;
+
+  // The index being built is finished first, which can take a while
+
+  ::Initializing init( this, true );
+
+  connect( load.get(), SIGNAL( indexingDictionary( QString const & ) ),
+           &init, SLOT( indexing( QString const & ) ) );
+
+  while( !load->wait( 50 ) )
+    QApplication::processEvents( QEventLoop::ExcludeUserInputEvents );
+}
+
+void MainWindow::dictionaryFolderChanged( QString const & folder )
+{
+  changedDictionaryFolders.insert( folder );
+
+  dictionaryWatchTimer.start();
+}
+
+void MainWindow::reloadChangedDictionaries()
+{
+  if ( backgroundLoad )
+  {
+    // Check again after the current loading is done
+    dictionaryWatchTimer.start();
+    return;
+  }
+
+  // Wait for the files to stop changing, e.g. to get copied completely
+
+  QDateTime settled = QDateTime::currentDateTime().addMSecs( -dictionaryWatchTimer.interval() );
+
+  for( QSet< QString >::const_iterator i = changedDictionaryFolders.constBegin();
+       i != changedDictionaryFolders.constEnd(); ++i )
+  {
+    QFileInfoList files = QDir( *i ).entryInfoList( QDir::Files );
+
+    for( int x = 0; x < files.size(); ++x )
+      if ( files[ x ].lastModified() > settled )
+      {
+        dictionaryWatchTimer.start();
+        return;
+      }
+  }
+
+  changedDictionaryFolders.clear();
+
+  // The dictionaries whose files were replaced are released right away,
+  // since their indices are to be rebuilt
+
+  vector< sptr< Dictionary::Class > > unchanged;
+
+  string indexDir = FsEncoding::encode( Config::getIndexDir() );
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+  {
+    vector< string > const & files = dictionaries[ x ]->getDictionaryFilenames();
+    string indexFile = indexDir + dictionaries[ x ]->getId();
+
+    if ( files.size() && QFileInfo( FsEncoding::decode( indexFile.c_str() ) ).exists()
+         && Dictionary::needToRebuildIndex( files, indexFile ) )
+      continue;
+
+    unchanged.push_back( dictionaries[ x ] );
+  }
+
+  if ( unchanged.size() != dictionaries.size() )
+    setDictionaries( unchanged );
+
+  backgroundLoad = new BackgroundLoadDictionaries( cfg, dictionaries, dictNetMgr );
+
+  // Queued, since the loader is deleted once it's finished
+  connect( backgroundLoad.get(), SIGNAL( finished() ),
+           this, SLOT( backgroundLoadFinished() ), Qt::QueuedConnection );
+
+  connect( backgroundLoad.get(), SIGNAL( indexingDictionary( QString const & ) ),
+           this, SLOT( backgroundIndexing( QString const & ) ) );
+
+  backgroundLoad->start();
+}
+
+void MainWindow::backgroundLoadFinished()
+{
+  if ( !backgroundLoad )
+    return;
+
+  vector< sptr< Dictionary::Class > > loaded;
+
+  bool loadedOk = backgroundLoad->getDictionaries( loaded );
+
+  backgroundLoad.reset();
+
+  if ( ftsIndexingPending )
+  {
+    // Loaded on startup, so the dictionaries were only added
+    dictionariesAvailableTimer.stop();
+
+    if ( loadedOk && haveDictionariesChanged( loaded ) )
+      addDictionaries( loaded );
+
+    ftsIndexing.setDictionaries( dictionaries );
+    ftsIndexing.doIndexing();
+    ftsIndexingPending = false;
+
+    return;
+  }
+
+  // Only replace the dictionaries in use if some were added or removed
+  if ( !loadedOk || !haveDictionariesChanged( loaded ) )
+    return;
+
+  setDictionaries( loaded );
+
+  if ( ArticleView * view = getCurrentArticleView() )
+    view->reload();
+
+  // New subfolders might have appeared
+  watchDictionaryFolders();
+}
+
+bool MainWindow::haveDictionariesChanged( vector< sptr< Dictionary::Class > > const & newDictionaries )
+{
+  if ( newDictionaries.size() != dictionaries.size() )
+    return true;
+
+  set< string > oldIds, newIds;
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+    oldIds.insert( dictionaries[ x ]->getId() );
+
+  for( unsigned x = 0; x < newDictionaries.size(); ++x )
+    newIds.insert( newDictionaries[ x ]->getId() );
+
+  return oldIds != newIds;
+}
+
+void MainWindow::backgroundIndexing( QString const & dictionaryName )
+{
+  mainStatusBar->showMessage( tr( "Indexing: %1" ).arg( dictionaryName ), 5000 );
+}
+
+void MainWindow::backgroundDictionariesAdded()
+{
+  // Not restarted, so that the dictionaries are put to use periodically
+  // while they keep arriving
+  if ( !dictionariesAvailableTimer.isActive() )
+    dictionariesAvailableTimer.start();
+}
+
+void MainWindow::applyAvailableDictionaries()
+{
+  if ( !backgroundLoad )
+    return;
+
+  vector< sptr< Dictionary::Class > > available;
+
+  backgroundLoad->getAvailableDictionaries( available );
+
+  if ( haveDictionariesChanged( available ) )
+    addDictionaries( available );
+}
+
+void MainWindow::addDictionaries( vector< sptr< Dictionary::Class > > const & newDictionaries )
+{
+  // Nothing holds on to the dictionaries in use in a way adding more would
+  // break, so unlike setDictionaries(), the popup, the dialogs, the caches
+  // and the full-text search indexing are left alone
+
+  set< string > oldIds;
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+    oldIds.insert( dictionaries[ x ]->getId() );
+
+  for( unsigned x = 0; x < newDictionaries.size(); ++x )
+  {
+    if ( oldIds.count( newDictionaries[ x ]->getId() ) )
+      continue;
+
+    newDictionaries[ x ]->deferredInit();
+    newDictionaries[ x ]->setFTSParameters( cfg.preferences.fts );
+    newDictionaries[ x ]->setSynonymSearchEnabled( cfg.preferences.synonymSearchEnabled );
+  }
+
+  wordFinder.clear();
+
+  dictionaries = newDictionaries;
+
+  // This reloads the tabs as well, showing the current words in the
+  // dictionaries just added
   updateGroupList();
+
+  if ( scanPopup )
+    scanPopup->dictionariesAdded();
+
+  updateSuggestionList();
+  updateStatusLine();
+}
+
+void MainWindow::prefetchWebSiteArticles()
+{
+  if( !cfg.preferences.prefetchWebSites )
+    return;
+
+  // Only the most recent words are worth the traffic
+  int const maxWords = 10;
+
+  QStringList words;
+
+  for( int x = 0; x < history.size() && words.size() < maxWords; ++x )
+  {
+    QString word = history.getItem( x ).word;
+
+    if( !words.contains( word, Qt::CaseInsensitive ) )
+      words.append( word );
+  }
+
+  WebSite::prefetchArticles( dictionaries, words );
 }
 
 void MainWindow::updateStatusLine()
@@ -1380,13 +1762,15 @@ void MainWindow::updateGroupList()
 
   groupInstances.clear();
 
+  Instances::DictionaryIndex dictionaryIndex( dictionaries );
+
   // Add dictionaryOrder first, as the 'All' group.
   {
-    Instances::Group g( cfg.dictionaryOrder, dictionaries, Config::Group() );
+    Instances::Group g( cfg.dictionaryOrder, dictionaryIndex, Config::Group() );
 
     // Add any missing entries to dictionary order
     Instances::complementDictionaryOrder( g,
-                                          Instances::Group( cfg.inactiveDictionaries, dictionaries, Config::Group() ),
+                                          Instances::Group( cfg.inactiveDictionaries, dictionaryIndex, Config::Group() ),
                                           dictionaries );
 
     g.name = tr( "All" );
@@ -1397,7 +1781,7 @@ void MainWindow::updateGroupList()
   }
 
   for( int x  = 0; x < cfg.groups.size(); ++x )
-    groupInstances.push_back( Instances::Group( cfg.groups[ x ], dictionaries, cfg.inactiveDictionaries ) );
+    groupInstances.push_back( Instances::Group( cfg.groups[ x ], dictionaryIndex, cfg.inactiveDictionaries ) );
 
   // Update names for dictionaries that are present, so that they could be
   // found in case they got moved.
@@ -1879,6 +2263,49 @@ void MainWindow::showStatusBarMessage( QString const & message, int timeout, QPi
     mainStatusBar->showMessage( message, timeout, icon );
 }
 
+void MainWindow::hibernateIdleTabs()
+{
+  if ( !cfg.preferences.hibernateTabs )
+    return;
+
+  int idleSecs = cfg.preferences.hibernateTabsAfter * 60;
+
+  for( int x = 0; x < ui.tabWidget->count(); ++x )
+  {
+    ArticleView & view =
+      dynamic_cast< ArticleView & >( *( ui.tabWidget->widget( x ) ) );
+
+    if ( x != ui.tabWidget->currentIndex() && !view.isHibernated()
+         && view.secondsHidden() >= idleSecs )
+      view.hibernate();
+  }
+}
+
+void MainWindow::releaseIdleMetadata()
+{
+  // The metadata is loaded again once needed, so this shouldn't happen too
+  // often to the dictionaries in use
+  int const idleSecs = 10 * 60;
+
+  unsigned released = 0;
+  quint64 releasedBytes = 0;
+
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+  {
+    quint64 evictable = 0;
+
+    if ( dictionaries[ x ]->releaseIdleMetadata( idleSecs, &evictable ) )
+    {
+      ++released;
+      releasedBytes += evictable;
+    }
+  }
+
+  if ( released )
+    GD_DPRINTF( "Released the metadata of %u dictionaries, about %llu bytes\n",
+                released, (unsigned long long) releasedBytes );
+}
+
 void MainWindow::tabSwitched( int )
 {
   translateBox->setPopupEnabled( false );
@@ -2034,6 +2461,8 @@ void MainWindow::updatePronounceAvailability()
 
 void MainWindow::editDictionaries( unsigned editDictionaryGroup )
 {
+  stopWatchingDictionaryFolders();
+
   hotkeyWrapper.reset(); // No hotkeys while we're editing dictionaries
   scanPopup.reset(); // No scan popup either. No one should use dictionaries.
   closeHeadwordsDialog();
@@ -2065,6 +2494,12 @@ void MainWindow::editDictionaries( unsigned editDictionaryGroup )
   dicts.exec();
   cfg.dictionariesDialogGeometry = newCfg.dictionariesDialogGeometry = dicts.saveGeometry();
 
+  if ( dicts.areDictionariesChanged() )
+  {
+    articleNetMgr.getResourceCache().clear();
+    articleMaker.clearSharedRequests();
+  }
+
   if ( dicts.areDictionariesChanged() || dicts.areGroupsChanged() )
   {
 
@@ -2105,6 +2540,8 @@ void MainWindow::editDictionaries( unsigned editDictionaryGroup )
 
   ftsIndexing.setDictionaries( dictionaries );
   ftsIndexing.doIndexing();
+
+  watchDictionaryFolders();
 }
 
 void MainWindow::editCurrentGroup()
@@ -2200,6 +2637,9 @@ void MainWindow::editPreferences()
 
     if( cfg.preferences.maxNetworkCacheSize != p.maxNetworkCacheSize )
       setupNetworkCache( p.maxNetworkCacheSize );
+
+    bool needPrefetch = p.prefetchWebSites && !cfg.preferences.prefetchWebSites;
+
     cfg.preferences = p;
 
     audioPlayerFactory.setPreferences( cfg.preferences );
@@ -2216,6 +2656,9 @@ void MainWindow::editPreferences()
     applyProxySettings();
     applyWebSettings();
 
+    if( needPrefetch )
+      prefetchWebSiteArticles();
+
     ui.tabWidget->setHideSingleTab(cfg.preferences.hideSingleTab);
 
     setAutostart( cfg.preferences.autoStart );
@@ -3662,6 +4105,8 @@ void MainWindow::on_saveArticle_triggered()
 
 void MainWindow::on_rescanFiles_triggered()
 {
+  stopWatchingDictionaryFolders();
+
   hotkeyWrapper.reset(); // No hotkeys while we're editing dictionaries
   scanPopup.reset(); // No scan popup either. No one should use dictionaries.
   closeHeadwordsDialog();
@@ -3671,12 +4116,15 @@ void MainWindow::on_rescanFiles_triggered()
   ftsIndexing.clearDictionaries();
 
   groupInstances.clear(); // Release all the dictionaries they hold
-  dictionaries.clear();
   dictionariesUnmuted.clear();
-  dictionaryBar.setDictionaries( dictionaries );
+  dictionaryBar.setDictionaries( vector< sptr< Dictionary::Class > >() );
 
+  // The dictionaries whose files are unchanged are kept by loadDictionaries()
   loadDictionaries( this, true, cfg, dictionaries, dictNetMgr );
 
+  articleNetMgr.getResourceCache().clear();
+  articleMaker.clearSharedRequests();
+
   for( unsigned x = 0; x < dictionaries.size(); x++ )
   {
     dictionaries[ x ]->setFTSParameters( cfg.preferences.fts );
@@ -3686,12 +4134,16 @@ void MainWindow::on_rescanFiles_triggered()
   ftsIndexing.setDictionaries( dictionaries );
   ftsIndexing.doIndexing();
 
+  prefetchWebSiteArticles();
+
   updateGroupList();
 
   makeScanPopup();
   installHotKeys();
 
   updateSuggestionList();
+
+  watchDictionaryFolders();
 }
 
 void MainWindow::on_alwaysOnTop_triggered( bool checked )
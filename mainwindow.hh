@@ -11,6 +11,8 @@
 #include <QSystemTrayIcon>
 #include <QNetworkAccessManager>
 #include <QProgressDialog>
+#include <QFileSystemWatcher>
+#include <QSet>
 #include "ui_mainwindow.h"
 #include "folding.hh"
 #include "config.hh"
@@ -33,6 +35,10 @@
 #include "dictheadwords.hh"
 #include "fulltextsearch.hh"
 #include "helpwindow.hh"
+#include "loaddictionaries.hh"
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
+#include "queryserver.hh"
+#endif
 
 #include "hotkeywrapper.hh"
 #ifdef HAVE_X11
@@ -160,6 +166,10 @@ private:
   Instances::Groups groupInstances;
   ArticleMaker articleMaker;
   ArticleNetworkAccessManager articleNetMgr;
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
+  // Goes before the article maker and the dictionaries it uses
+  QScopedPointer< QueryServer > queryServer;
+#endif
   QNetworkAccessManager dictNetMgr; // We give dictionaries a separate manager,
                                     // since their requests can be destroyed
                                     // in a separate thread
@@ -182,6 +192,16 @@ private:
 
   QTimer newReleaseCheckTimer; // Countdown to a check for the new program
                                // release, if enabled
+  QTimer tabHibernationTimer; // Periodic check for the tabs and the
+                              // dictionary metadata to release
+
+  /// Watches the dictionary folders for the files added, removed or replaced
+  QFileSystemWatcher dictionaryWatcher;
+  QTimer dictionaryWatchTimer; // Waits for the changes to settle down
+  QSet< QString > changedDictionaryFolders;
+  sptr< BackgroundLoadDictionaries > backgroundLoad;
+  QTimer dictionariesAvailableTimer; // Batches using the dictionaries
+                                     // as they get loaded on startup
   QNetworkReply *latestReleaseReply;
 
   sptr< QPrinter > printer; // The printer we use for all printing operations
@@ -197,6 +217,7 @@ private:
   DictHeadwords * headwordsDlg;
 
   FTS::FtsIndexing ftsIndexing;
+  bool ftsIndexingPending; // Until all the dictionaries are loaded on startup
 
   FTS::FullTextSearchDialog * ftsDlg;
 
@@ -218,6 +239,24 @@ private:
   void applyWebSettings();
   void setupNetworkCache( int maxSize );
   void makeDictionaries();
+  /// Replaces the dictionaries in use with the given ones, remaking
+  /// everything which depends on them.
+  void setDictionaries( vector< sptr< Dictionary::Class > > const & );
+  /// Puts the given dictionaries to use when they only add to the ones in
+  /// use, which is much cheaper than setDictionaries().
+  void addDictionaries( vector< sptr< Dictionary::Class > > const & );
+  /// Tells whether the given dictionaries differ from the ones in use.
+  bool haveDictionariesChanged( vector< sptr< Dictionary::Class > > const & );
+  /// Makes the watcher watch the folders of the dictionary paths configured.
+  void watchDictionaryFolders();
+  /// Stops watching the dictionary folders and cancels any background
+  /// loading, waiting for it to stop with a window telling so and
+  /// discarding its results. Should be done before loading the
+  /// dictionaries in the foreground.
+  void stopWatchingDictionaryFolders();
+  /// Fetches web site articles for the recent history words in background,
+  /// if enabled in preferences.
+  void prefetchWebSiteArticles();
   void updateStatusLine();
   void updateGroupList();
   void updateDictionaryBar();
@@ -339,6 +378,20 @@ private slots:
   void switchToNextTab();
   void switchToPrevTab();
   void ctrlReleased();
+  // Releases the pages of the tabs which weren't viewed for a while
+  void hibernateIdleTabs();
+  // Releases the descriptions, icons etc of the dictionaries which weren't
+  // used for a while
+  void releaseIdleMetadata();
+
+  void dictionaryFolderChanged( QString const & );
+  // Loads the dictionaries added or changed in background
+  void reloadChangedDictionaries();
+  void backgroundLoadFinished();
+  void backgroundIndexing( QString const & dictionaryName );
+  void backgroundDictionariesAdded();
+  // Puts the dictionaries loaded so far on startup to use
+  void applyAvailableDictionaries();
 
   // Switch optional parts expand mode for current tab
   void switchExpandOptionalPartsMode();
@@ -3,6 +3,7 @@
 
 #include "mdx.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "utf8.hh"
 #include "file.hh"
@@ -197,7 +198,8 @@ class MdxDictionary: public BtreeIndexing::BtreeDictionary
   ChunkedStorage::Reader chunks;
   QFile dictFile;
   vector< sptr< IndexedMdd > > mddResources;
-  MdictParser::StyleSheets styleSheets;
+  MdictParser::StyleSheets styleSheets; // Loaded on demand under idxMutex
+  bool styleSheetsLoaded;
 
   QAtomicInt deferredInitDone;
   Mutex deferredInitMutex;
@@ -270,15 +272,23 @@ public:
               && !fts.disabledTypes.contains( "MDICT", Qt::CaseInsensitive )
               && ( fts.maxDictionarySize == 0 || getArticleCount() <= fts.maxDictionarySize );
   }
+
+  virtual MemoryUsage getMemoryUsage();
+
 protected:
 
   virtual void loadIcon() throw();
 
+  virtual void releaseMetadata();
+
 private:
 
   virtual string const & ensureInitDone();
   void doDeferredInit();
 
+  /// Reads the style sheets from the index. Expects idxMutex to be locked.
+  void loadStyleSheets();
+
   /// Loads an article with the given offset, filling the given strings.
   void loadArticle( uint32_t offset, string & articleText, bool noFilter = false );
 
@@ -297,6 +307,7 @@ MdxDictionary::MdxDictionary( string const & id, string const & indexFile,
   idx( indexFile, "rb" ),
   idxHeader( idx.read< IdxHeader >() ),
   chunks( idx, idxHeader.chunksOffset ),
+  styleSheetsLoaded( false ),
   deferredInitRunnableStarted( false )
 {
   // Read the dictionary's name
@@ -406,26 +417,7 @@ void MdxDictionary::doDeferredInit()
 
     try
     {
-      // Retrieve stylesheets
-      idx.seek( idxHeader.styleSheetAddress );
-      for ( uint32_t i = 0; i < idxHeader.styleSheetCount; i++ )
-      {
-        qint32 key = idx.read< qint32 >();
-        vector< char > buf;
-        quint32 sz;
-
-        sz = idx.read< quint32 >();
-        buf.resize( sz );
-        idx.read( &buf.front(), sz );
-        QString styleBegin = QString::fromUtf8( buf.data() );
-
-        sz = idx.read< quint32 >();
-        buf.resize( sz );
-        idx.read( &buf.front(), sz );
-        QString styleEnd = QString::fromUtf8( buf.data() );
-
-        styleSheets[ key ] = pair<QString, QString>( styleBegin, styleEnd );
-      }
+      // The stylesheets are read once needed, see loadArticle()
 
       // Initialize the index
       openIndex( IndexInfo( idxHeader.indexBtreeMaxElements,
@@ -614,14 +606,7 @@ void MdxArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for ( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   // Some synonims make it that the articles appear several times. We combat this
   // by only allowing them to appear once.
@@ -982,6 +967,58 @@ void MdxDictionary::loadIcon() throw()
   dictionaryIconLoaded = true;
 }
 
+void MdxDictionary::loadStyleSheets()
+{
+  idx.seek( idxHeader.styleSheetAddress );
+  for ( uint32_t i = 0; i < idxHeader.styleSheetCount; i++ )
+  {
+    qint32 key = idx.read< qint32 >();
+    vector< char > buf;
+    quint32 sz;
+
+    sz = idx.read< quint32 >();
+    buf.resize( sz );
+    idx.read( &buf.front(), sz );
+    QString styleBegin = QString::fromUtf8( buf.data() );
+
+    sz = idx.read< quint32 >();
+    buf.resize( sz );
+    idx.read( &buf.front(), sz );
+    QString styleEnd = QString::fromUtf8( buf.data() );
+
+    styleSheets[ key ] = pair<QString, QString>( styleBegin, styleEnd );
+  }
+
+  styleSheetsLoaded = true;
+}
+
+void MdxDictionary::releaseMetadata()
+{
+  BtreeDictionary::releaseMetadata();
+
+  Mutex::Lock _( idxMutex );
+
+  styleSheets.clear();
+  styleSheetsLoaded = false;
+}
+
+Dictionary::Class::MemoryUsage MdxDictionary::getMemoryUsage()
+{
+  MemoryUsage result = BtreeDictionary::getMemoryUsage();
+
+  result.resident += dictionaryName.capacity() + encoding.capacity();
+
+  Mutex::Lock _( idxMutex );
+
+  for( MdictParser::StyleSheets::const_iterator i = styleSheets.begin();
+       i != styleSheets.end(); ++i )
+    result.evictable += sizeof( *i ) + ( i->second.first.capacity()
+                                         + i->second.second.capacity() ) * sizeof( QChar )
+                        + 4 * sizeof( void * ); // The tree node
+
+  return result;
+}
+
 void MdxDictionary::loadArticle( uint32_t offset, string & articleText, bool noFilter )
 {
   vector< char > chunk;
@@ -1009,6 +1046,14 @@ void MdxDictionary::loadArticle( uint32_t offset, string & articleText, bool noF
                                           decompressed.constData() + recordInfo.recordOffset,
                                           recordInfo.recordSize );
 
+  if ( idxHeader.styleSheetCount )
+  {
+    touchMetadata();
+
+    if ( !styleSheetsLoaded )
+      loadStyleSheets();
+  }
+
   article = MdictParser::substituteStylesheet( article, styleSheets );
 
   if( !noFilter )
@@ -1441,6 +1486,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( vector< string > const & f
     if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
          indexIsOldOrBad( dictFiles, indexFile ) )
     {
+      IndexingStats::EndOfBuild endOfBuild;
+
       // Building the index
 
       gdDebug( "MDict: Building the index for dictionary: %s\n", i->c_str() );
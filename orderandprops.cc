@@ -181,6 +181,8 @@ void OrderAndProps::inactiveDictionarySelectionChanged( QItemSelection const & c
 
 void OrderAndProps::disableDictionaryDescription()
 {
+  descriptionRequest.reset();
+
   ui.dictionaryInformation->setEnabled( false );
 
   ui.dictionaryName->clear();
@@ -231,22 +233,50 @@ void OrderAndProps::describeDictionary( DictListWidget * lst, QModelIndex const
 
     ui.dictionaryFileList->setPlainText( filenamesText );
 
-    QString const& descText = dict->getDescription();
-    if( !descText.isEmpty() && descText.compare( "NONE" ) != 0 )
-    {
-      ui.dictionaryDescription->setPlainText( descText );
-      ui.dictionaryDescription->setVisible( true );
-      ui.dictionaryDescriptionLabel->setVisible( true );
-      ui.infoVerticalSpacer->changeSize( 0, 0, QSizePolicy::Minimum, QSizePolicy::Minimum );
-    }
-    else
-    {
-      ui.dictionaryDescription->setVisible( false );
-      ui.dictionaryDescriptionLabel->setVisible( false );
-      ui.infoVerticalSpacer->changeSize( 20, 5, QSizePolicy::Minimum, QSizePolicy::Expanding );
-    }
-    ui.infoVerticalLayout->invalidate();
+    // Loading the description may take a while, so it is shown once ready
+    showDescription( QString() );
+
+    descriptionRequest = Dictionary::requestDescription( dict );
+
+    connect( descriptionRequest.get(), SIGNAL( finished() ),
+             this, SLOT( descriptionLoaded() ), Qt::QueuedConnection );
+  }
+}
+
+void OrderAndProps::descriptionLoaded()
+{
+  // Only the latest request matters, the earlier ones were for dictionaries
+  // no longer described
+  if( !descriptionRequest || sender() != descriptionRequest.get() )
+    return;
+
+  QString descText;
+
+  if( descriptionRequest->dataSize() > 0 )
+  {
+    vector< char > const & data = descriptionRequest->getFullData();
+    descText = QString::fromUtf8( &data.front(), data.size() );
   }
+
+  showDescription( descText );
+}
+
+void OrderAndProps::showDescription( QString const & descText )
+{
+  if( !descText.isEmpty() && descText.compare( "NONE" ) != 0 )
+  {
+    ui.dictionaryDescription->setPlainText( descText );
+    ui.dictionaryDescription->setVisible( true );
+    ui.dictionaryDescriptionLabel->setVisible( true );
+    ui.infoVerticalSpacer->changeSize( 0, 0, QSizePolicy::Minimum, QSizePolicy::Minimum );
+  }
+  else
+  {
+    ui.dictionaryDescription->setVisible( false );
+    ui.dictionaryDescriptionLabel->setVisible( false );
+    ui.infoVerticalSpacer->changeSize( 20, 5, QSizePolicy::Minimum, QSizePolicy::Expanding );
+  }
+  ui.infoVerticalLayout->invalidate();
 }
 
 void OrderAndProps::contextMenuRequested( const QPoint & pos )
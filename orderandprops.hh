@@ -30,13 +30,18 @@ private slots:
   void dictListFocused();
   void inactiveDictListFocused();
   void showDictNumbers();
+  void descriptionLoaded();
 
 private:
 
   Ui::OrderAndProps ui;
 
+  /// Loads the description of the dictionary currently described
+  sptr< Dictionary::DataRequest > descriptionRequest;
+
   void disableDictionaryDescription();
   void describeDictionary( DictListWidget *, QModelIndex const & );
+  void showDescription( QString const & );
 
 signals:
   void showDictionaryHeadwords( QString const & dictId );
@@ -213,6 +213,9 @@ Preferences::Preferences( QWidget * parent, Config::Class & cfg_ ):
   ui.collapseBigArticles->setChecked( p.collapseBigArticles );
   on_collapseBigArticles_toggled( ui.collapseBigArticles->isChecked() );
   ui.articleSizeLimit->setValue( p.articleSizeLimit );
+  ui.hibernateTabs->setChecked( p.hibernateTabs );
+  on_hibernateTabs_toggled( ui.hibernateTabs->isChecked() );
+  ui.hibernateTabsAfter->setValue( p.hibernateTabsAfter );
 
   ui.limitInputPhraseLength->setChecked( p.limitInputPhraseLength );
   on_limitInputPhraseLength_toggled( ui.limitInputPhraseLength->isChecked() );
@@ -330,6 +333,7 @@ Preferences::Preferences( QWidget * parent, Config::Class & cfg_ ):
   ui.disallowContentFromOtherSites->setChecked( p.disallowContentFromOtherSites );
   ui.enableWebPlugins->setChecked( p.enableWebPlugins );
   ui.hideGoldenDictHeader->setChecked( p.hideGoldenDictHeader );
+  ui.prefetchWebSites->setChecked( p.prefetchWebSites );
   ui.maxNetworkCacheSize->setValue( p.maxNetworkCacheSize );
   ui.clearNetworkCacheOnExit->setChecked( p.clearNetworkCacheOnExit );
 
@@ -434,6 +438,8 @@ Config::Preferences Preferences::getPreferences()
 
   p.collapseBigArticles = ui.collapseBigArticles->isChecked();
   p.articleSizeLimit = ui.articleSizeLimit->value();
+  p.hibernateTabs = ui.hibernateTabs->isChecked();
+  p.hibernateTabsAfter = ui.hibernateTabsAfter->value();
   p.limitInputPhraseLength = ui.limitInputPhraseLength->isChecked();
   p.inputPhraseLengthLimit = ui.inputPhraseLengthLimit->value();
   p.ignoreDiacritics = ui.ignoreDiacritics->isChecked();
@@ -463,6 +469,7 @@ Config::Preferences Preferences::getPreferences()
   p.disallowContentFromOtherSites = ui.disallowContentFromOtherSites->isChecked();
   p.enableWebPlugins = ui.enableWebPlugins->isChecked();
   p.hideGoldenDictHeader = ui.hideGoldenDictHeader->isChecked();
+  p.prefetchWebSites = ui.prefetchWebSites->isChecked();
   p.maxNetworkCacheSize = ui.maxNetworkCacheSize->value();
   p.clearNetworkCacheOnExit = ui.clearNetworkCacheOnExit->isChecked();
 
@@ -665,6 +672,11 @@ void Preferences::on_collapseBigArticles_toggled( bool checked )
   ui.articleSizeLimit->setEnabled( checked );
 }
 
+void Preferences::on_hibernateTabs_toggled( bool checked )
+{
+  ui.hibernateTabsAfter->setEnabled( checked );
+}
+
 void Preferences::on_limitInputPhraseLength_toggled( bool checked )
 {
   ui.inputPhraseLengthLimit->setEnabled( checked );
@@ -55,6 +55,7 @@ private slots:
   void on_maxNetworkCacheSize_valueChanged( int value );
 
   void on_collapseBigArticles_toggled( bool checked );
+  void on_hibernateTabs_toggled( bool checked );
   void on_limitInputPhraseLength_toggled( bool checked );
 
   void helpRequested();
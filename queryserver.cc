@@ -0,0 +1,634 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#include "queryserver.hh"
+#include "fulltextsearch.hh"
+#include "gddebug.hh"
+
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonParseError>
+
+using std::vector;
+
+//////// QueryServer
+
+QueryServer::QueryServer( QObject * parent,
+                          vector< sptr< Dictionary::Class > > const & dictionaries_,
+                          Instances::Groups const & groups_,
+                          ArticleMaker const & articleMaker_,
+                          ArticleNetworkAccessManager & articleNetMgr_ ):
+  QObject( parent ),
+  dictionaries( dictionaries_ ),
+  groups( groups_ ),
+  articleMaker( articleMaker_ ),
+  articleNetMgr( articleNetMgr_ ),
+  maxPendingRequests( 1 )
+{
+  connect( &server, SIGNAL( newConnection() ), this, SLOT( newConnection() ) );
+}
+
+QString QueryServer::defaultName()
+{
+#ifdef Q_OS_WIN32
+  // Named pipes are shared by all the users
+  return "GoldenDict-query-" + QString::fromLocal8Bit( qgetenv( "USERNAME" ) );
+#else
+  try
+  {
+    return QDir( Config::getConfigDir() ).filePath( "query.sock" );
+  }
+  catch( std::exception & )
+  {
+    return "goldendict-query";
+  }
+#endif
+}
+
+bool QueryServer::listen( Config::QueryServer const & cfg )
+{
+  close();
+
+  maxPendingRequests = cfg.maxPendingRequests ? cfg.maxPendingRequests : 1;
+
+  QString name = cfg.name.isEmpty() ? defaultName() : cfg.name;
+
+  // Only the current user may ask
+  server.setSocketOptions( QLocalServer::UserAccessOption );
+
+  if ( server.listen( name ) )
+    return true;
+
+  if ( server.serverError() == QAbstractSocket::AddressInUseError )
+  {
+    // Either another instance answers there, or the socket was left by a
+    // crash
+    QLocalSocket probe;
+
+    probe.connectToServer( name );
+
+    if ( !probe.waitForConnected( 1000 ) )
+    {
+      QLocalServer::removeServer( name );
+
+      if ( server.listen( name ) )
+        return true;
+    }
+  }
+
+  gdWarning( "Can't start the query server on \"%s\": %s\n",
+             name.toUtf8().data(), server.errorString().toUtf8().data() );
+
+  return false;
+}
+
+void QueryServer::close()
+{
+  server.close();
+
+  qDeleteAll( findChildren< QueryConnection * >() );
+}
+
+void QueryServer::newConnection()
+{
+  while( QLocalSocket * socket = server.nextPendingConnection() )
+    new QueryConnection( *this, socket );
+}
+
+//////// QueryConnection
+
+QueryConnection::QueryConnection( QueryServer & server_, QLocalSocket * socket_ ):
+  QObject( &server_ ),
+  server( server_ ),
+  socket( socket_ )
+{
+  socket->setParent( this );
+
+  // Whatever doesn't fit stays in the socket, slowing the client down
+  socket->setReadBufferSize( MaxRequestSize );
+
+  connect( socket, SIGNAL( readyRead() ), this, SLOT( readRequests() ) );
+  connect( socket, SIGNAL( bytesWritten( qint64 ) ), this, SLOT( readRequests() ) );
+  connect( socket, SIGNAL( disconnected() ), this, SLOT( socketDisconnected() ) );
+
+  readRequests();
+}
+
+void QueryConnection::readRequests()
+{
+  while( jobs.size() < server.maxPendingRequests &&
+         socket->bytesToWrite() < MaxUnsentSize &&
+         socket->state() == QLocalSocket::ConnectedState )
+  {
+    if ( !socket->canReadLine() )
+    {
+      if ( socket->bytesAvailable() >= MaxRequestSize )
+      {
+        sendError( QJsonValue(), "The request is too long" );
+        socket->disconnectFromServer();
+      }
+
+      break;
+    }
+
+    QByteArray line = socket->readLine().trimmed();
+
+    if ( !line.isEmpty() )
+      startJob( line );
+  }
+}
+
+void QueryConnection::socketDisconnected()
+{
+  // The pending jobs are cancelled along with us
+  deleteLater();
+}
+
+void QueryConnection::jobFinished()
+{
+  QueryJob * job = qobject_cast< QueryJob * >( sender() );
+
+  if ( !job )
+    return;
+
+  jobs.remove( job );
+
+  sendAnswer( job->getAnswer() );
+
+  job->deleteLater();
+
+  // There's room for more now
+  readRequests();
+}
+
+void QueryConnection::sendAnswer( QJsonObject const & answer )
+{
+  if ( socket->state() != QLocalSocket::ConnectedState )
+    return;
+
+  socket->write( QJsonDocument( answer ).toJson( QJsonDocument::Compact ) + '\n' );
+}
+
+void QueryConnection::sendError( QJsonValue const & id, QString const & error )
+{
+  QJsonObject answer;
+
+  answer.insert( "id", id );
+  answer.insert( "error", error );
+
+  sendAnswer( answer );
+}
+
+bool QueryConnection::getDictionaries( QJsonObject const & request,
+                                       vector< sptr< Dictionary::Class > > & dicts,
+                                       unsigned & groupId, QString & error )
+{
+  groupId = Instances::Group::AllGroupId;
+
+  if ( request.contains( "dicts" ) )
+  {
+    QJsonArray ids = request.value( "dicts" ).toArray();
+
+    for( int x = 0; x < ids.size(); ++x )
+    {
+      std::string id = ids[ x ].toString().toStdString();
+
+      unsigned y = 0;
+
+      while( y < server.dictionaries.size() && server.dictionaries[ y ]->getId() != id )
+        ++y;
+
+      if ( y == server.dictionaries.size() )
+      {
+        error = "Unknown dictionary: " + ids[ x ].toString();
+        return false;
+      }
+
+      dicts.push_back( server.dictionaries[ y ] );
+    }
+
+    if ( dicts.empty() )
+    {
+      error = "No dictionaries given";
+      return false;
+    }
+
+    return true;
+  }
+
+  if ( request.contains( "group" ) )
+  {
+    QJsonValue value = request.value( "group" );
+
+    Instances::Group const * group = 0;
+
+    if ( value.isDouble() )
+      group = server.groups.findGroup( (unsigned) value.toDouble() );
+    else
+    {
+      for( unsigned x = 0; x < server.groups.size(); ++x )
+        if ( server.groups[ x ].name == value.toString() )
+        {
+          group = &server.groups[ x ];
+          break;
+        }
+    }
+
+    if ( !group )
+    {
+      error = "Unknown group";
+      return false;
+    }
+
+    dicts = group->dictionaries;
+    groupId = group->id;
+
+    return true;
+  }
+
+  dicts = server.dictionaries;
+
+  return true;
+}
+
+void QueryConnection::startJob( QByteArray const & line )
+{
+  QJsonParseError parseError;
+
+  QJsonDocument document = QJsonDocument::fromJson( line, &parseError );
+
+  if ( !document.isObject() )
+  {
+    sendError( QJsonValue(), parseError.error != QJsonParseError::NoError ?
+                               "Malformed request: " + parseError.errorString() :
+                               QString( "The request must be an object" ) );
+    return;
+  }
+
+  QJsonObject request = document.object();
+  QJsonValue id = request.value( "id" );
+  QString op = request.value( "op" ).toString();
+
+  if ( op == "dictionaries" )
+  {
+    // Known right away
+    QJsonArray dicts;
+
+    for( unsigned x = 0; x < server.dictionaries.size(); ++x )
+    {
+      QJsonObject dict;
+
+      dict.insert( "id", QString::fromStdString( server.dictionaries[ x ]->getId() ) );
+      dict.insert( "name", QString::fromUtf8( server.dictionaries[ x ]->getName().c_str() ) );
+
+      dicts.append( dict );
+    }
+
+    QJsonArray groups;
+
+    for( unsigned x = 0; x < server.groups.size(); ++x )
+    {
+      QJsonObject group;
+      QJsonArray ids;
+
+      for( unsigned y = 0; y < server.groups[ x ].dictionaries.size(); ++y )
+        ids.append( QString::fromStdString( server.groups[ x ].dictionaries[ y ]->getId() ) );
+
+      group.insert( "id", (double) server.groups[ x ].id );
+      group.insert( "name", server.groups[ x ].name );
+      group.insert( "dicts", ids );
+
+      groups.append( group );
+    }
+
+    QJsonObject result;
+
+    result.insert( "dictionaries", dicts );
+    result.insert( "groups", groups );
+
+    QJsonObject answer;
+
+    answer.insert( "id", id );
+    answer.insert( "result", result );
+
+    sendAnswer( answer );
+
+    return;
+  }
+
+  vector< sptr< Dictionary::Class > > dicts;
+  unsigned groupId;
+  QString error;
+
+  if ( op != "resource" && !getDictionaries( request, dicts, groupId, error ) )
+  {
+    sendError( id, error );
+    return;
+  }
+
+  QueryJob * job = 0;
+
+  try
+  {
+    if ( op == "search" )
+    {
+      QString word = request.value( "word" ).toString();
+
+      if ( word.isEmpty() )
+      {
+        sendError( id, "No word given" );
+        return;
+      }
+
+      job = new QueryJob( this, id, QueryJob::Search, dicts );
+      connect( job, SIGNAL( finished() ), this, SLOT( jobFinished() ), Qt::QueuedConnection );
+      jobs.push_back( job );
+
+      int maxResults = request.value( "max" ).toInt( 40 );
+
+      job->startSearch( word, maxResults > 0 ? maxResults : 40 );
+    }
+    else
+    if ( op == "article" )
+    {
+      QString word = request.value( "word" ).toString();
+
+      if ( word.isEmpty() )
+      {
+        sendError( id, "No word given" );
+        return;
+      }
+
+      QStringList dictIds;
+
+      if ( request.contains( "dicts" ) )
+        for( unsigned x = 0; x < dicts.size(); ++x )
+          dictIds.append( QString::fromStdString( dicts[ x ]->getId() ) );
+
+      job = new QueryJob( this, id, QueryJob::Article, vector< sptr< Dictionary::Class > >() );
+      connect( job, SIGNAL( finished() ), this, SLOT( jobFinished() ), Qt::QueuedConnection );
+      jobs.push_back( job );
+
+      job->addRequest( server.articleMaker.makeDefinitionFor(
+                         Config::InputPhrase::fromPhrase( word ), groupId,
+                         QMap< QString, QString >(), QSet< QString >(), dictIds,
+                         request.value( "ignoreDiacritics" ).toBool() ),
+                       "text/html" );
+    }
+    else
+    if ( op == "fts" )
+    {
+      QString text = request.value( "text" ).toString();
+      int mode = request.value( "mode" ).toInt( FTS::WholeWords );
+
+      if ( text.isEmpty() )
+      {
+        sendError( id, "No text given" );
+        return;
+      }
+
+      if ( mode < FTS::WholeWords || mode > FTS::RegExp )
+      {
+        sendError( id, "Unknown search mode" );
+        return;
+      }
+
+      job = new QueryJob( this, id, QueryJob::FullTextSearch, dicts );
+      connect( job, SIGNAL( finished() ), this, SLOT( jobFinished() ), Qt::QueuedConnection );
+      jobs.push_back( job );
+
+      job->startFullTextSearch( text, mode,
+                                request.value( "matchCase" ).toBool(),
+                                request.value( "distance" ).toInt( -1 ),
+                                request.value( "max" ).toInt( -1 ),
+                                request.value( "ignoreWordsOrder" ).toBool(),
+                                request.value( "ignoreDiacritics" ).toBool() );
+    }
+    else
+    if ( op == "resource" )
+    {
+      QUrl url( request.value( "url" ).toString() );
+      QString contentType;
+
+      sptr< Dictionary::DataRequest > req = server.articleNetMgr.getResource( url, contentType );
+
+      if ( !req.get() )
+      {
+        sendError( id, "Unknown resource" );
+        return;
+      }
+
+      job = new QueryJob( this, id, QueryJob::Resource, vector< sptr< Dictionary::Class > >() );
+      connect( job, SIGNAL( finished() ), this, SLOT( jobFinished() ), Qt::QueuedConnection );
+      jobs.push_back( job );
+
+      job->addRequest( req, contentType );
+    }
+    else
+      sendError( id, "Unknown operation: " + op );
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "Query server request error: %s\n", e.what() );
+
+    if ( job )
+    {
+      jobs.remove( job );
+      delete job;
+    }
+
+    sendError( id, QString::fromUtf8( e.what() ) );
+  }
+}
+
+//////// QueryJob
+
+QueryJob::QueryJob( QObject * parent, QJsonValue const & id_, Operation operation_,
+                    vector< sptr< Dictionary::Class > > const & dicts_ ):
+  QObject( parent ),
+  id( id_ ),
+  operation( operation_ ),
+  dicts( dicts_ ),
+  finder( 0 ),
+  finderRunning( false )
+{
+}
+
+QueryJob::~QueryJob()
+{
+  for( std::list< sptr< Dictionary::DataRequest > >::iterator i = requests.begin();
+       i != requests.end(); ++i )
+  {
+    if ( (*i)->isFinished() )
+    {
+      // Its headwords are ours to delete
+      if ( operation == FullTextSearch )
+        takeFtsResults( **i, 0 );
+    }
+    else
+      (*i)->cancel();
+  }
+}
+
+void QueryJob::startSearch( QString const & word, unsigned long maxResults )
+{
+  finder = new WordFinder( this );
+
+  connect( finder, SIGNAL( finished() ), this, SLOT( finderFinished() ) );
+
+  finderRunning = true;
+
+  finder->prefixMatch( word, dicts, maxResults );
+}
+
+void QueryJob::addRequest( sptr< Dictionary::DataRequest > const & req,
+                           QString const & contentType_ )
+{
+  contentType = contentType_;
+
+  connect( req.get(), SIGNAL( finished() ),
+           this, SLOT( requestFinished() ), Qt::QueuedConnection );
+
+  requests.push_back( req );
+
+  collectResults(); // It may have finished already
+}
+
+void QueryJob::startFullTextSearch( QString const & text, int mode, bool matchCase,
+                                    int distanceBetweenWords, int maxResultsPerDict,
+                                    bool ignoreWordsOrder, bool ignoreDiacritics )
+{
+  for( unsigned x = 0; x < dicts.size(); ++x )
+  {
+    if ( !dicts[ x ]->canFTS() )
+      continue;
+
+    sptr< Dictionary::DataRequest > req =
+      dicts[ x ]->getSearchResults( text, mode, matchCase, distanceBetweenWords,
+                                    maxResultsPerDict, ignoreWordsOrder,
+                                    ignoreDiacritics );
+
+    connect( req.get(), SIGNAL( finished() ),
+             this, SLOT( requestFinished() ), Qt::QueuedConnection );
+
+    requests.push_back( req );
+  }
+
+  collectResults(); // Handle the ones which have already finished
+}
+
+void QueryJob::finderFinished()
+{
+  finderRunning = false;
+
+  WordFinder::SearchResults const & found = finder->getResults();
+
+  QJsonArray words;
+
+  for( unsigned x = 0; x < found.size(); ++x )
+    words.append( found[ x ].first );
+
+  if ( words.isEmpty() && !finder->getErrorString().isEmpty() )
+    error = finder->getErrorString();
+  else
+    result = words;
+
+  collectResults();
+}
+
+void QueryJob::requestFinished()
+{
+  collectResults();
+}
+
+void QueryJob::takeFtsResults( Dictionary::DataRequest & req, QJsonArray * results )
+{
+  // The request hands over a list allocated for its user
+  QList< FTS::FtsHeadword > * headwords;
+
+  if ( req.dataSize() < (long) sizeof( headwords ) )
+    return;
+
+  try
+  {
+    req.getDataSlice( 0, sizeof( headwords ), &headwords );
+  }
+  catch( std::exception & e )
+  {
+    gdWarning( "getDataSlice error: %s\n", e.what() );
+    return;
+  }
+
+  if ( results )
+  {
+    for( int x = 0; x < headwords->size(); ++x )
+    {
+      QJsonObject found;
+
+      found.insert( "headword", headwords->at( x ).headword );
+      found.insert( "dicts", QJsonArray::fromStringList( headwords->at( x ).dictIDs ) );
+
+      results->append( found );
+    }
+  }
+
+  delete headwords;
+}
+
+void QueryJob::collectResults()
+{
+  if ( !answer.isEmpty() )
+    return; // Already answered
+
+  for( std::list< sptr< Dictionary::DataRequest > >::iterator i = requests.begin();
+       i != requests.end(); )
+  {
+    Dictionary::DataRequest & req = **i;
+
+    if ( !req.isFinished() )
+    {
+      ++i;
+      continue;
+    }
+
+    if ( operation == FullTextSearch )
+      takeFtsResults( req, &ftsResults );
+    else
+    if ( req.dataSize() < 0 )
+      error = req.getErrorString().isEmpty() ? QString( "Not found" ) : req.getErrorString();
+    else
+    {
+      vector< char > const & data = req.getFullData();
+
+      if ( operation == Article )
+        result = QString::fromUtf8( data.empty() ? 0 : &data.front(), data.size() );
+      else
+      {
+        QJsonObject resource;
+
+        resource.insert( "contentType", contentType );
+        resource.insert( "data", QString::fromLatin1(
+                                   QByteArray( data.empty() ? 0 : &data.front(), data.size() ).toBase64() ) );
+
+        result = resource;
+      }
+    }
+
+    requests.erase( i++ );
+  }
+
+  if ( finderRunning || !requests.empty() )
+    return;
+
+  if ( operation == FullTextSearch )
+    result = ftsResults;
+
+  answer.insert( "id", id );
+
+  if ( !error.isEmpty() )
+    answer.insert( "error", error );
+  else
+    answer.insert( "result", result );
+
+  emit finished();
+}
@@ -0,0 +1,207 @@
+/* This file is part of GoldenDict. Licensed under GPLv3 or later, see the
+ * LICENSE file */
+
+#ifndef __QUERYSERVER_HH_INCLUDED__
+#define __QUERYSERVER_HH_INCLUDED__
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QJsonArray>
+#include <list>
+#include <vector>
+#include "config.hh"
+#include "dictionary.hh"
+#include "instances.hh"
+#include "article_maker.hh"
+#include "article_netmgr.hh"
+#include "wordfinder.hh"
+
+/// Answers the dictionary queries of other programs, such as editors and
+/// scripts, over a local socket, using the dictionaries already loaded.
+///
+/// Each request is a JSON object on a line of its own:
+///
+///   {"id": 1, "op": "search", "word": "hous", "max": 20}
+///   {"id": 2, "op": "article", "word": "house", "group": "English"}
+///   {"id": 3, "op": "fts", "text": "small house", "mode": 0, "max": 10}
+///   {"id": 4, "op": "resource", "url": "bres://<dict id>/picture.png"}
+///   {"id": 5, "op": "dictionaries"}
+///
+/// "group" takes a group name or id, "dicts" a list of dictionary ids to use
+/// instead. Each answer is a line as well, either {"id": ..., "result": ...}
+/// or {"id": ..., "error": "..."}. The requests of a connection are handled
+/// at once, so their answers may come in any order. Once too many of them
+/// are pending, or the answers aren't read fast enough, the connection isn't
+/// read anymore until they are, so the clients get slowed down by their
+/// sockets.
+///
+/// Everything here lives in the GUI thread; the dictionaries do their work
+/// in the thread pool as usual.
+class QueryServer: public QObject
+{
+  Q_OBJECT
+
+public:
+
+  QueryServer( QObject * parent,
+               std::vector< sptr< Dictionary::Class > > const & dictionaries,
+               Instances::Groups const & groups,
+               ArticleMaker const & articleMaker,
+               ArticleNetworkAccessManager & articleNetMgr );
+
+  /// Starts listening on the local socket given by the configuration.
+  /// Returns false if it couldn't be done, the reason is logged.
+  bool listen( Config::QueryServer const & );
+
+  /// Stops listening and drops all the connections.
+  void close();
+
+  /// Returns the socket name to use when none is configured
+  static QString defaultName();
+
+private slots:
+
+  void newConnection();
+
+private:
+
+  std::vector< sptr< Dictionary::Class > > const & dictionaries;
+  Instances::Groups const & groups;
+  ArticleMaker const & articleMaker;
+  ArticleNetworkAccessManager & articleNetMgr;
+
+  QLocalServer server;
+  unsigned maxPendingRequests;
+
+  friend class QueryConnection;
+};
+
+class QueryJob;
+
+/// A single client connection of QueryServer. This should really be
+/// private, but we need it to be handled by moc.
+class QueryConnection: public QObject
+{
+  Q_OBJECT
+
+public:
+
+  /// Takes over the socket, and is destroyed along with it once the client
+  /// disconnects.
+  QueryConnection( QueryServer &, QLocalSocket * );
+
+private slots:
+
+  /// Handles the complete request lines, as many as allowed
+  void readRequests();
+
+  void jobFinished();
+
+  void socketDisconnected();
+
+private:
+
+  enum
+  {
+    /// The longest request line accepted
+    MaxRequestSize = 64 * 1024,
+    /// No more requests are read while this much of the answers is unsent
+    MaxUnsentSize = 4 * 1024 * 1024
+  };
+
+  QueryServer & server;
+  QLocalSocket * socket;
+  std::list< QueryJob * > jobs; // Pending ones, they are our children
+
+  /// Starts handling the given request line
+  void startJob( QByteArray const & line );
+
+  void sendAnswer( QJsonObject const & );
+
+  void sendError( QJsonValue const & id, QString const & error );
+
+  /// Returns the dictionaries the request asks for, either by a "dicts" list
+  /// or by a "group". The group id is AllGroupId unless a group was given.
+  bool getDictionaries( QJsonObject const & request,
+                        std::vector< sptr< Dictionary::Class > > & dicts,
+                        unsigned & groupId, QString & error );
+};
+
+/// A query of QueryConnection waiting for the dictionaries to answer. This
+/// should really be private, but we need it to be handled by moc.
+class QueryJob: public QObject
+{
+  Q_OBJECT
+
+public:
+
+  enum Operation
+  {
+    Search,
+    Article,
+    FullTextSearch,
+    Resource
+  };
+
+  /// The dictionaries are kept for the time of the query. The finished()
+  /// signal is emitted once the answer is ready, possibly from within the
+  /// start functions.
+  QueryJob( QObject * parent, QJsonValue const & id, Operation,
+            std::vector< sptr< Dictionary::Class > > const & dicts );
+
+  /// Cancels whatever is still pending
+  ~QueryJob();
+
+  /// Starts a prefix search for the given word
+  void startSearch( QString const & word, unsigned long maxResults );
+
+  /// Takes the request for an article page or a resource
+  void addRequest( sptr< Dictionary::DataRequest > const &,
+                   QString const & contentType = QString() );
+
+  /// Starts a full-text search in every dictionary supporting it
+  void startFullTextSearch( QString const & text, int mode, bool matchCase,
+                            int distanceBetweenWords, int maxResultsPerDict,
+                            bool ignoreWordsOrder, bool ignoreDiacritics );
+
+  /// Returns the answer, once finished
+  QJsonObject const & getAnswer() const
+  { return answer; }
+
+signals:
+
+  void finished();
+
+private slots:
+
+  void finderFinished();
+
+  void requestFinished();
+
+private:
+
+  QJsonValue id;
+  Operation operation;
+  std::vector< sptr< Dictionary::Class > > dicts;
+  WordFinder * finder;
+  bool finderRunning;
+  std::list< sptr< Dictionary::DataRequest > > requests;
+  QString contentType;
+  QJsonArray ftsResults;
+  QJsonValue result;
+  QString error;
+  QJsonObject answer;
+
+  /// Takes the results of the finished requests, and makes up the answer
+  /// once they are all finished.
+  void collectResults();
+
+  /// Takes the headwords found by the given finished full-text search
+  /// request, appending them to 'results' if it's given.
+  static void takeFtsResults( Dictionary::DataRequest &, QJsonArray * results );
+};
+
+#endif
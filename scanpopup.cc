@@ -1240,6 +1240,14 @@ void ScanPopup::uninterceptMouse()
   }
 }
 
+void ScanPopup::dictionariesAdded()
+{
+  updateDictionaryBar();
+
+  if ( isVisible() )
+    definition->reload();
+}
+
 void ScanPopup::updateDictionaryBar()
 {
   if ( !dictionaryBar.toggleViewAction()->isChecked() )
@@ -58,6 +58,10 @@ public:
 
   void setDictionaryIconSize();
 
+  /// Should be called once more dictionaries were added to the ones and
+  /// the groups given on construction, which are referred to all along.
+  void dictionariesAdded();
+
   void saveConfigData();
 
 signals:
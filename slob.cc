@@ -5,6 +5,7 @@
 
 #include "slob.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "fsencoding.hh"
 #include "folding.hh"
 #include "gddebug.hh"
@@ -1424,16 +1425,7 @@ void SlobArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1721,6 +1713,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
              indexIsOldOrBad( indexFile ) )
         {
+          IndexingStats::EndOfBuild endOfBuild;
+
           SlobFile sf;
 
           gdDebug( "Slob: Building the index for dictionary: %s\n", i->c_str() );
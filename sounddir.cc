@@ -6,6 +6,7 @@
 #include "folding.hh"
 #include "utf8.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "chunkedstorage.hh"
 #include "filetype.hh"
 #include "htmlescape.hh"
@@ -130,16 +131,7 @@ sptr< Dictionary::DataRequest > SoundDirDictionary::getArticle( wstring const &
                                                                 bool ignoreDiacritics )
   THROW_SPEC( std::exception )
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticles( word, alts, ignoreDiacritics );
 
   // maps to the chain number
   multimap< wstring, unsigned > mainArticles, alternateArticles;
@@ -433,6 +425,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::SoundDirs const &
 
     if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) || indexIsOldOrBad( indexFile ) )
     {
+      IndexingStats::EndOfBuild endOfBuild;
+
       // Building the index
 
       qDebug() << "Sounds: Building the index for directory: " << i->path;
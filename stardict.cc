@@ -3,6 +3,7 @@
 
 #include "stardict.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "utf8.hh"
 #include "chunkedstorage.hh"
@@ -1471,16 +1472,7 @@ void StardictArticleRequest::run()
 
   try
   {
-    vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-    for( unsigned x = 0; x < alts.size(); ++x )
-    {
-      /// Make an additional query for each alt
-
-      vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-      chain.insert( chain.end(), altChain.begin(), altChain.end() );
-    }
+    vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
     multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -2147,6 +2139,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         // Building the index
 
         File::Class ifoFile( *i, "r" );
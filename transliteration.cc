@@ -16,9 +16,14 @@ BaseTransliterationDictionary::BaseTransliterationDictionary( string const & id,
                                                               bool caseSensitive_ ):
   Dictionary::Class( id, vector< string >() ),
   name( name_ ),
+  icon( icon_ ),
   caseSensitive( caseSensitive_ )
 {
-  dictionaryIcon = dictionaryNativeIcon = icon_;
+}
+
+void BaseTransliterationDictionary::loadIcon() throw()
+{
+  dictionaryIcon = dictionaryNativeIcon = icon;
   dictionaryIconLoaded = true;
 }
 
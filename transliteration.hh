@@ -19,10 +19,13 @@ using std::vector;
 class BaseTransliterationDictionary: public Dictionary::Class
 {
   string name;
+  QIcon icon; // Shared with the resources, so keeping it is free
 
 protected:
   bool caseSensitive;
 
+  virtual void loadIcon() throw();
+
 public:
 
   BaseTransliterationDictionary( string const & id, string const & name,
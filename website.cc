@@ -8,6 +8,9 @@
 #include <QTextCodec>
 #include <QDir>
 #include <QFileInfo>
+#include <QCache>
+#include <QDateTime>
+#include <map>
 #include "gddebug.hh"
 
 #if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
@@ -22,13 +25,169 @@ using namespace Dictionary;
 
 namespace {
 
+/// Makes a network request which Qt is allowed to pipeline over a connection
+/// already open to the same host, instead of waiting for a free one.
+QNetworkRequest makeNetworkRequest( QUrl const & url )
+{
+  QNetworkRequest req( url );
+
+  req.setAttribute( QNetworkRequest::HttpPipeliningAllowedAttribute, true );
+
+  return req;
+}
+
+/// Keeps the recently fetched web site articles, already processed, so that
+/// looking up the same words again doesn't hit the network.
+class ArticleCache
+{
+public:
+
+  /// The total size of the articles cached, in bytes
+  enum { MaxTotalSize = 4 * 1024 * 1024 };
+  /// Articles older than this are fetched anew
+  enum { MaxAgeSecs = 60 * 60 };
+
+  ArticleCache():
+    entries( MaxTotalSize )
+  {}
+
+  /// Returns true and fills the article if the one for the given url is
+  /// cached and is not outdated.
+  bool find( QString const & url, QByteArray & article );
+
+  void insert( QString const & url, QByteArray const & article );
+
+private:
+
+  struct Entry
+  {
+    QByteArray article;
+    QDateTime fetched;
+  };
+
+  Mutex mutex;
+  QCache< QString, Entry > entries;
+};
+
+bool ArticleCache::find( QString const & url, QByteArray & article )
+{
+  Mutex::Lock _( mutex );
+
+  Entry const * entry = entries.object( url );
+
+  if ( !entry )
+    return false;
+
+  if ( entry->fetched.secsTo( QDateTime::currentDateTime() ) > MaxAgeSecs )
+  {
+    entries.remove( url );
+    return false;
+  }
+
+  article = entry->article;
+
+  return true;
+}
+
+void ArticleCache::insert( QString const & url, QByteArray const & article )
+{
+  Entry * entry = new Entry;
+
+  entry->article = article;
+  entry->fetched = QDateTime::currentDateTime();
+
+  Mutex::Lock _( mutex );
+
+  // Articles larger than the whole cache are just deleted by QCache
+  entries.insert( url, entry, article.size() + 1 );
+}
+
+/// The prefetches of a web site dictionary by their urls. The lookups
+/// sharing them hold the table as well, since they may outlive the
+/// dictionary. Like the network manager the prefetches use, it is only ever
+/// touched from the GUI thread, so there's no locking.
+class PrefetchTable
+{
+public:
+
+  /// A request fetching an article in background. The lookups of its url
+  /// share it instead of making new requests. Until looked up, it runs to
+  /// the end to fill the cache, then it runs as long as any of the lookups
+  /// sharing it does.
+  struct Prefetch
+  {
+    sptr< DataRequest > request;
+    unsigned users; // The lookups which share it and haven't ended yet
+  };
+
+  typedef std::map< QString, Prefetch > Prefetches;
+  Prefetches prefetches;
+
+  /// Forgets the prefetch requests which are finished already.
+  void removeFinished();
+
+  /// Tells that one of the lookups sharing the given prefetch of the url
+  /// has ended, cancelling the prefetch if it was the last one.
+  void release( QString const & url, DataRequest * request );
+
+  /// Cancels all the prefetches, so that they never get to the dictionary
+  /// once it's gone.
+  void cancelAll();
+};
+
+void PrefetchTable::removeFinished()
+{
+  for( Prefetches::iterator i = prefetches.begin(); i != prefetches.end(); )
+  {
+    if ( i->second.request->isFinished() )
+      prefetches.erase( i++ );
+    else
+      ++i;
+  }
+}
+
+void PrefetchTable::release( QString const & url, DataRequest * request )
+{
+  Prefetches::iterator i = prefetches.find( url );
+
+  // Once finished, it might have been replaced by a newer one
+  if ( i == prefetches.end() || i->second.request.get() != request ||
+       !i->second.users || --i->second.users )
+    return;
+
+  if ( !i->second.request->isFinished() )
+  {
+    // No one waits for it anymore
+    i->second.request->cancel();
+    prefetches.erase( i );
+  }
+}
+
+void PrefetchTable::cancelAll()
+{
+  // The lookups sharing them are told they are finished, and release them
+  // while being iterated over, so the requests are taken out first
+  vector< sptr< DataRequest > > requests;
+
+  for( Prefetches::iterator i = prefetches.begin(); i != prefetches.end(); ++i )
+    requests.push_back( i->second.request );
+
+  prefetches.clear();
+
+  for( size_t x = 0; x < requests.size(); ++x )
+    requests[ x ]->cancel();
+}
+
 class WebSiteDictionary: public Dictionary::Class
 {
   string name;
   QByteArray urlTemplate;
+  QString urlTemplateText; // As configured, serves as the description
   QString iconFilename;
   bool inside_iframe;
   QNetworkAccessManager & netMgr;
+  ArticleCache articleCache;
+  sptr< PrefetchTable > prefetchTable;
 
 public:
 
@@ -40,13 +199,17 @@ public:
     Dictionary::Class( id, vector< string >() ),
     name( name_ ),
     urlTemplate( QUrl( urlTemplate_ ).toEncoded() ),
+    urlTemplateText( urlTemplate_ ),
     iconFilename( iconFilename_ ),
     inside_iframe( inside_iframe_ ),
-    netMgr( netMgr_ )
+    netMgr( netMgr_ ),
+    prefetchTable( new PrefetchTable )
   {
-    dictionaryDescription = urlTemplate_;
   }
 
+  ~WebSiteDictionary()
+  { prefetchTable->cancelAll(); }
+
   virtual string getName() throw()
   { return name; }
 
@@ -69,11 +232,33 @@ public:
 
   virtual sptr< Dictionary::DataRequest > getResource( string const & name ) THROW_SPEC( std::exception );
 
+  virtual QString const & getDescription()
+  {
+    if ( dictionaryDescription.isEmpty() )
+      dictionaryDescription = urlTemplateText;
+
+    return dictionaryDescription;
+  }
+
   void isolateWebCSS( QString & css );
 
+  /// Stores the processed article fetched from the given url, for the
+  /// lookups to come.
+  void cacheArticle( QString const & url, QByteArray const & article )
+  { articleCache.insert( url, article ); }
+
+  /// Starts fetching the article for the given word in background, unless
+  /// it is cached already or is shown inside an iframe anyway.
+  void prefetchArticle( wstring const & word );
+
 protected:
 
   virtual void loadIcon() throw();
+
+private:
+
+  /// Makes the url of the article for the given word out of the template.
+  QByteArray makeArticleUrl( wstring const & word );
 };
 
 sptr< WordSearchRequest > WebSiteDictionary::prefixMatch( wstring const & /*word*/,
@@ -95,13 +280,13 @@ class WebSiteArticleRequest: public WebSiteDataRequestSlots
 {
   QNetworkReply * netReply;
   QString url;
-  Class * dictPtr;
+  WebSiteDictionary * dictPtr;
   QNetworkAccessManager & mgr;
 
 public:
 
   WebSiteArticleRequest( QString const & url, QNetworkAccessManager & _mgr,
-                         Class * dictPtr_ );
+                         WebSiteDictionary * dictPtr_ );
   ~WebSiteArticleRequest()
   {}
 
@@ -120,7 +305,7 @@ void WebSiteArticleRequest::cancel()
 
 WebSiteArticleRequest::WebSiteArticleRequest( QString const & url_,
                                               QNetworkAccessManager & _mgr,
-                                              Class * dictPtr_ ):
+                                              WebSiteDictionary * dictPtr_ ):
   url( url_ ), dictPtr( dictPtr_ ), mgr( _mgr )
 {
   connect( &mgr, SIGNAL( finished( QNetworkReply * ) ),
@@ -129,7 +314,7 @@ WebSiteArticleRequest::WebSiteArticleRequest( QString const & url_,
 
   QUrl reqUrl( url );
 
-  netReply = mgr.get( QNetworkRequest( reqUrl ) );
+  netReply = mgr.get( makeNetworkRequest( reqUrl ) );
 
 #ifndef QT_NO_OPENSSL
   connect( netReply, SIGNAL( sslErrors( QList< QSslError > ) ),
@@ -202,7 +387,7 @@ void WebSiteArticleRequest::requestFinished( QNetworkReply * r )
     {
       disconnect( netReply, 0, 0, 0 );
       netReply->deleteLater();
-      netReply = mgr.get( QNetworkRequest( redirectUrl ) );
+      netReply = mgr.get( makeNetworkRequest( redirectUrl ) );
 #ifndef QT_NO_OPENSSL
       connect( netReply, SIGNAL( sslErrors( QList< QSslError > ) ),
                netReply, SLOT( ignoreSslErrors() ) );
@@ -406,6 +591,8 @@ void WebSiteArticleRequest::requestFinished( QNetworkReply * r )
 
     articleBody.prepend( "<div class=\"website_padding\"></div>" );
 
+    dictPtr->cacheArticle( url, articleBody );
+
     Mutex::Lock _( dataMutex );
 
     size_t prevSize = data.size();
@@ -436,57 +623,166 @@ void WebSiteArticleRequest::requestFinished( QNetworkReply * r )
   finish();
 }
 
-sptr< DataRequest > WebSiteDictionary::getArticle( wstring const & str,
-                                                   vector< wstring > const &,
-                                                   wstring const & context, bool )
-  THROW_SPEC( std::exception )
+QByteArray WebSiteDictionary::makeArticleUrl( wstring const & str )
 {
-  QByteArray urlString;
+  QByteArray urlString = urlTemplate;
 
-  // Context contains the right url to go to
-  if ( context.size() )
-    urlString = Utf8::encode( context ).c_str();
-  else
-  {
-    urlString = urlTemplate;
+  QString inputWord = gd::toQString( str );
 
-    QString inputWord = gd::toQString( str );
+  urlString.replace( "%25GDWORD%25", inputWord.toUtf8().toPercentEncoding() );
 
-    urlString.replace( "%25GDWORD%25", inputWord.toUtf8().toPercentEncoding() );
+  QTextCodec *codec = QTextCodec::codecForName( "Windows-1251" );
+  if( codec )
+    urlString.replace( "%25GD1251%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
 
-    QTextCodec *codec = QTextCodec::codecForName( "Windows-1251" );
-    if( codec )
-      urlString.replace( "%25GD1251%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
+  codec = QTextCodec::codecForName( "Big-5" );
+  if( codec )
+    urlString.replace( "%25GDBIG5%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
 
-    codec = QTextCodec::codecForName( "Big-5" );
-    if( codec )
-      urlString.replace( "%25GDBIG5%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
+  codec = QTextCodec::codecForName( "Big5-HKSCS" );
+  if( codec )
+    urlString.replace( "%25GDBIG5HKSCS%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
 
-    codec = QTextCodec::codecForName( "Big5-HKSCS" );
-    if( codec )
-      urlString.replace( "%25GDBIG5HKSCS%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
+  codec = QTextCodec::codecForName( "Shift-JIS" );
+  if( codec )
+    urlString.replace( "%25GDSHIFTJIS%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
+
+  codec = QTextCodec::codecForName( "GB18030" );
+  if( codec )
+    urlString.replace( "%25GDGBK%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
 
-    codec = QTextCodec::codecForName( "Shift-JIS" );
-    if( codec )
-      urlString.replace( "%25GDSHIFTJIS%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
 
-    codec = QTextCodec::codecForName( "GB18030" );
+  // Handle all ISO-8859 encodings
+  for( int x = 1; x <= 16; ++x )
+  {
+    codec = QTextCodec::codecForName( QString( "ISO 8859-%1" ).arg( x ).toLatin1() );
     if( codec )
-      urlString.replace( "%25GDGBK%25", codec->fromUnicode( inputWord ).toPercentEncoding() );
+      urlString.replace( QString( "%25GDISO%1%25" ).arg( x ), codec->fromUnicode( inputWord ).toPercentEncoding() );
+
+    if ( x == 10 )
+      x = 12; // Skip encodings 11..12, they don't exist
+  }
 
+  return urlString;
+}
 
-    // Handle all ISO-8859 encodings
-    for( int x = 1; x <= 16; ++x )
-    {
-      codec = QTextCodec::codecForName( QString( "ISO 8859-%1" ).arg( x ).toLatin1() );
-      if( codec )
-        urlString.replace( QString( "%25GDISO%1%25" ).arg( x ), codec->fromUnicode( inputWord ).toPercentEncoding() );
+void WebSiteDictionary::prefetchArticle( wstring const & word )
+{
+  if( inside_iframe )
+    return;
 
-      if ( x == 10 )
-        x = 12; // Skip encodings 11..12, they don't exist
-    }
+  prefetchTable->removeFinished();
+
+  QString url = QString::fromUtf8( makeArticleUrl( word ) );
+
+  QByteArray article;
+
+  if ( prefetchTable->prefetches.count( url ) || articleCache.find( url, article ) )
+    return;
+
+  PrefetchTable::Prefetch & prefetch = prefetchTable->prefetches[ url ];
+
+  prefetch.request = new WebSiteArticleRequest( url, netMgr, this );
+  prefetch.users = 0;
+}
+
+/// A lookup sharing a prefetch. Cancelling it only ends this lookup, the
+/// prefetch itself is cancelled once all the lookups sharing it have ended.
+class PrefetchUserRequest: public WebSiteDataRequestSlots
+{
+  QString url;
+  sptr< DataRequest > prefetch; // Reset once this one has ended
+  sptr< PrefetchTable > prefetchTable;
+
+public:
+
+  PrefetchUserRequest( QString const & url, sptr< DataRequest > const & prefetch,
+                       sptr< PrefetchTable > const & prefetchTable );
+  ~PrefetchUserRequest();
+
+  virtual void cancel();
+
+private:
+
+  virtual void prefetchFinished();
+
+  /// Tells the table this lookup no longer needs the prefetch.
+  void release();
+};
+
+PrefetchUserRequest::PrefetchUserRequest( QString const & url_,
+                                          sptr< DataRequest > const & prefetch_,
+                                          sptr< PrefetchTable > const & prefetchTable_ ):
+  url( url_ ), prefetch( prefetch_ ), prefetchTable( prefetchTable_ )
+{
+  connect( prefetch.get(), SIGNAL( finished() ),
+           this, SLOT( prefetchFinished() ) );
+
+  if ( prefetch->isFinished() )
+    prefetchFinished();
+}
+
+PrefetchUserRequest::~PrefetchUserRequest()
+{
+  release();
+}
+
+void PrefetchUserRequest::cancel()
+{
+  if ( isFinished() )
+    return;
+
+  release();
+  finish();
+}
+
+void PrefetchUserRequest::prefetchFinished()
+{
+  if ( isFinished() ) // Was cancelled
+    return;
+
+  if ( prefetch->dataSize() >= 0 )
+  {
+    Mutex::Lock _( dataMutex );
+
+    data = prefetch->getFullData();
+    hasAnyData = true;
   }
 
+  if ( !prefetch->getErrorString().isEmpty() )
+    setErrorString( prefetch->getErrorString() );
+
+  release();
+  finish();
+}
+
+void PrefetchUserRequest::release()
+{
+  if ( !prefetch.get() )
+    return;
+
+  disconnect( prefetch.get(), 0, this, 0 );
+
+  sptr< DataRequest > request = prefetch;
+
+  prefetch.reset();
+
+  prefetchTable->release( url, request.get() );
+}
+
+sptr< DataRequest > WebSiteDictionary::getArticle( wstring const & str,
+                                                   vector< wstring > const &,
+                                                   wstring const & context, bool )
+  THROW_SPEC( std::exception )
+{
+  QByteArray urlString;
+
+  // Context contains the right url to go to
+  if ( context.size() )
+    urlString = Utf8::encode( context ).c_str();
+  else
+    urlString = makeArticleUrl( str );
+
   if( inside_iframe )
   {
     // Just insert link in <iframe> tag
@@ -511,9 +807,32 @@ sptr< DataRequest > WebSiteDictionary::getArticle( wstring const & str,
     return dr;
   }
 
-  // To load data from site
+  // To load data from site, unless it was loaded recently
+
+  QString url = QString::fromUtf8( urlString );
+
+  QByteArray article;
+
+  if ( articleCache.find( url, article ) )
+  {
+    sptr< DataRequestInstant > dr = new DataRequestInstant( true );
+
+    dr->getData().assign( article.constData(), article.constData() + article.size() );
+
+    return dr;
+  }
+
+  prefetchTable->removeFinished();
 
-  return new WebSiteArticleRequest( urlString, netMgr, this );
+  PrefetchTable::Prefetches::iterator i = prefetchTable->prefetches.find( url );
+
+  if ( i != prefetchTable->prefetches.end() )
+  {
+    ++i->second.users;
+    return new PrefetchUserRequest( url, i->second.request, prefetchTable );
+  }
+
+  return new WebSiteArticleRequest( url, netMgr, this );
 }
 
 class WebSiteResourceRequest: public WebSiteDataRequestSlots
@@ -548,7 +867,7 @@ WebSiteResourceRequest::WebSiteResourceRequest( QString const & url_,
 
   QUrl reqUrl( url );
 
-  netReply = mgr.get( QNetworkRequest( reqUrl ) );
+  netReply = mgr.get( makeNetworkRequest( reqUrl ) );
 
 #ifndef QT_NO_OPENSSL
   connect( netReply, SIGNAL( sslErrors( QList< QSslError > ) ),
@@ -582,7 +901,7 @@ void WebSiteResourceRequest::requestFinished( QNetworkReply * r )
     {
       disconnect( netReply, 0, 0, 0 );
       netReply->deleteLater();
-      netReply = mgr.get( QNetworkRequest( redirectUrl ) );
+      netReply = mgr.get( makeNetworkRequest( redirectUrl ) );
 #ifndef QT_NO_OPENSSL
       connect( netReply, SIGNAL( sslErrors( QList< QSslError > ) ),
                netReply, SLOT( ignoreSslErrors() ) );
@@ -666,4 +985,19 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::WebSites const & w
   return result;
 }
 
+void prefetchArticles( vector< sptr< Dictionary::Class > > const & dictionaries,
+                       QStringList const & words )
+{
+  for( unsigned x = 0; x < dictionaries.size(); ++x )
+  {
+    WebSiteDictionary * dict = dynamic_cast< WebSiteDictionary * >( dictionaries[ x ].get() );
+
+    if ( !dict )
+      continue;
+
+    for( int y = 0; y < words.size(); ++y )
+      dict->prefetchArticle( gd::toWString( words[ y ] ) );
+  }
+}
+
 }
@@ -8,6 +8,7 @@
 #include "config.hh"
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QStringList>
 
 /// Support for any web sites via a templated url.
 namespace WebSite {
@@ -19,6 +20,12 @@ vector< sptr< Dictionary::Class > > makeDictionaries( Config::WebSites const &,
                                                       QNetworkAccessManager & )
     THROW_SPEC( std::exception );
 
+/// Starts fetching in background the articles for the given words from all
+/// the web site dictionaries among the ones given, so that later lookups of
+/// these words are served from memory. Other dictionaries are skipped.
+void prefetchArticles( vector< sptr< Dictionary::Class > > const &,
+                       QStringList const & words );
+
 /// Exposed here for moc
 class WebSiteDataRequestSlots: public Dictionary::DataRequest
 {
@@ -28,6 +35,9 @@ protected slots:
 
   virtual void requestFinished( QNetworkReply * )
   {}
+
+  virtual void prefetchFinished()
+  {}
 };
 
 }
@@ -4,6 +4,7 @@
 #include "wordfinder.hh"
 #include "folding.hh"
 #include "wstring_qt.hh"
+#include "lookupstats.hh"
 #include <QThreadPool>
 #include <map>
 #include "gddebug.hh"
@@ -126,6 +127,11 @@ void WordFinder::startSearch()
   searchQueued = false;
   searchInProgress = true;
 
+  if ( searchType != StemmedMatch )
+    trace = LookupTrace::startLookup( searchType == PrefixMatch ? LookupTrace::PrefixMatch :
+                                                                  LookupTrace::ExpressionMatch,
+                                      inputWord, 0, requestedMaxResults );
+
   // Gather all writings of the word
 
   if ( allWordWritings.size() != 1 )
@@ -140,10 +146,15 @@ void WordFinder::startSearch()
     allWordWritings.insert( allWordWritings.end(), writings.begin(), writings.end() );
   }
 
-  // Query each dictionary for all word writings
+  // Query each dictionary for all word writings. The ones which find the
+  // words most often go first, so their requests get the threads first.
 
-  for( size_t x = 0; x < inputDicts->size(); ++x )
+  vector< unsigned > queryOrder = LookupStats::instance().getQueryOrder( *inputDicts );
+
+  for( size_t n = 0; n < queryOrder.size(); ++n )
   {
+    size_t x = queryOrder[ n ];
+
     if ( ( (*inputDicts)[ x ]->getFeatures() & requestedFeatures ) != requestedFeatures )
       continue;
 
@@ -160,6 +171,9 @@ void WordFinder::startSearch()
                  this, SLOT( requestFinished() ), Qt::QueuedConnection );
 
         queuedRequests.push_back( sr );
+
+        if ( trace.get() )
+          trace->addRequest( sr.get(), (*inputDicts)[ x ]->getId() );
       }
       catch( std::exception & e )
       {
@@ -178,6 +192,8 @@ void WordFinder::cancel()
 {
   searchQueued = false;
   searchInProgress = false;
+
+  trace.reset(); // Recorded as cancelled, unless finished
   
   cancelSearches();
 }
@@ -199,6 +215,9 @@ void WordFinder::requestFinished()
   {
     if ( (*i)->isFinished() )
     {
+      if ( trace.get() )
+        trace->requestFinished( i->get(), (*i)->matchesCount() != 0 );
+
       if ( searchInProgress && !(*i)->getErrorString().isEmpty() )
         searchErrorString = tr( "Failed to query some dictionaries." );
 
@@ -511,6 +530,13 @@ void WordFinder::updateResults()
   {
     // That were all of them.
     searchInProgress = false;
+
+    if ( trace.get() )
+    {
+      trace->finish();
+      trace.reset();
+    }
+
     emit finished();
   }
 }
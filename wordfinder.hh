@@ -12,6 +12,7 @@
 #include <QWaitCondition>
 #include <QRunnable>
 #include "dictionary.hh"
+#include "lookuptrace.hh"
 
 /// This component takes care of finding words. The search is asynchronous.
 /// This means the GUI doesn't get blocked during the sometimes lenghtly
@@ -52,6 +53,10 @@ private:
   std::vector< sptr< Dictionary::Class > > const * inputDicts;
 
   std::vector< gd::wstring > allWordWritings; // All writings of the inputWord
+
+  /// Tracks the search in progress while the lookups are being recorded.
+  /// The stemmed searches aren't recorded, they're made by the articles.
+  sptr< LookupTrace::Lookup > trace;
   
   struct OneResult
   {
@@ -113,6 +118,11 @@ public:
   QString const & getErrorString()
   { return searchErrorString; }
 
+  /// Returns true if there's no search queued or in progress, that is, the
+  /// results of the last one are final.
+  bool isSearchFinished() const
+  { return !searchQueued && !searchInProgress; }
+
   /// Returns true if the search was inconclusive -- that is, there may be more
   /// results than the ones returned.
   bool wasSearchUncertain() const
@@ -3,6 +3,7 @@
 
 #include "xdxf.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "folding.hh"
 #include "utf8.hh"
 #include "chunkedstorage.hh"
@@ -16,6 +17,8 @@
 #include <list>
 #include <wctype.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include "gddebug.hh"
 #include "wstring_qt.hh"
 #include "xdxf2html.hh"
@@ -43,6 +46,9 @@
 #include <QSemaphore>
 #include <QThreadPool>
 #include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QTextStream>
 
 #include "qt4x5.hh"
 
@@ -125,6 +131,91 @@ bool indexIsOldOrBad( string const & indexFile )
 
 
 
+/// The results of converting the articles with both Xdxf2Html::convert()
+/// and its reference, see checkConversion()
+struct ConversionCheck
+{
+  QTextStream & out;
+  unsigned articles, mismatches;
+  qint64 domNsecs, streamingNsecs;
+
+  ConversionCheck( QTextStream & out_ ):
+    out( out_ ), articles( 0 ), mismatches( 0 ), domNsecs( 0 ), streamingNsecs( 0 )
+  {}
+};
+
+/// Returns the html with the attributes of each tag sorted by name. The DOM
+/// converter writes them in the order of a QHash, which isn't even the same
+/// from one run to another, while the streaming one keeps the source order.
+string sortAttributes( string const & html )
+{
+  string result;
+
+  result.reserve( html.size() );
+
+  size_t pos = 0;
+
+  while( pos < html.size() )
+  {
+    size_t tagStart = html.find( '<', pos );
+
+    if ( tagStart == string::npos )
+      break;
+
+    result.append( html, pos, tagStart - pos );
+
+    // Find the name and the end of the tag, skipping the quoted values
+
+    size_t nameEnd = tagStart + 1;
+
+    while( nameEnd < html.size() && !strchr( " \t\r\n/>", html[ nameEnd ] ) )
+      ++nameEnd;
+
+    vector< string > attributes;
+
+    size_t x = nameEnd;
+
+    for( ; ; )
+    {
+      while( x < html.size() && strchr( " \t\r\n", html[ x ] ) )
+        ++x;
+
+      if ( x >= html.size() || html[ x ] == '>' || html[ x ] == '/' )
+        break;
+
+      size_t attrStart = x;
+
+      while( x < html.size() && !strchr( " \t\r\n/>", html[ x ] ) )
+      {
+        if ( html[ x ] == '"' || html[ x ] == '\'' )
+        {
+          size_t quoteEnd = html.find( html[ x ], x + 1 );
+
+          x = quoteEnd == string::npos ? html.size() : quoteEnd;
+        }
+
+        ++x;
+      }
+
+      attributes.push_back( html.substr( attrStart, x - attrStart ) );
+    }
+
+    std::sort( attributes.begin(), attributes.end() );
+
+    result.append( html, tagStart, nameEnd - tagStart );
+
+    for( size_t y = 0; y < attributes.size(); ++y )
+      result += " " + attributes[ y ];
+
+    pos = x;
+  }
+
+  if ( pos < html.size() )
+    result.append( html, pos, string::npos );
+
+  return result;
+}
+
 class XdxfDictionary: public BtreeIndexing::BtreeDictionary
 {
   Mutex idxMutex;
@@ -199,6 +290,10 @@ public:
   virtual uint32_t getFtsIndexVersion()
   { return 1; }
 
+  /// Converts every article with both Xdxf2Html::convert() and its
+  /// reference, Xdxf2Html::convertWithDom(), adding the results to the check
+  void checkConversion( ConversionCheck & );
+
 protected:
 
   void loadIcon() throw();
@@ -209,6 +304,11 @@ private:
   void loadArticle( uint32_t address,
                     string & articleText, QString * headword = 0 );
 
+  /// Reads the xdxf source of the article. If it can't be read, returns
+  /// false, storing the html telling why to articleText.
+  bool loadArticleSource( uint32_t address, string & source, bool & isLogical,
+                          string & articleText );
+
   friend class XdxfArticleRequest;
   friend class XdxfResourceRequest;
 };
@@ -508,16 +608,7 @@ void XdxfArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -633,6 +724,19 @@ sptr< Dictionary::DataRequest > XdxfDictionary::getArticle( wstring const & word
 void XdxfDictionary::loadArticle( uint32_t address,
                                   string & articleText,
                                   QString * headword )
+{
+  string source;
+  bool isLogical;
+
+  if ( !loadArticleSource( address, source, isLogical, articleText ) )
+    return;
+
+  articleText = Xdxf2Html::convert( source, Xdxf2Html::XDXF, idxHeader.hasAbrv ? &abrv : NULL, this,
+                                    &resourceZip, isLogical, idxHeader.revisionNumber, headword );
+}
+
+bool XdxfDictionary::loadArticleSource( uint32_t address, string & source,
+                                        bool & isLogical, string & articleText )
 {
   // Read the properties
 
@@ -649,7 +753,7 @@ void XdxfDictionary::loadArticle( uint32_t address,
   if ( &chunk.front() + chunk.size() - propertiesData < 9 )
   {
     articleText = string( "<div class=\"xdxf\">Index seems corrupted</div>" );
-    return;
+    return false;
   }
 
   unsigned char fType = (unsigned char) *propertiesData;
@@ -674,13 +778,71 @@ void XdxfDictionary::loadArticle( uint32_t address,
   {
 //    throw exCantReadFile( getDictionaryFilenames()[ 0 ] );
       articleText = string( "<div class=\"xdxf\">DICTZIP error: " ) + dict_error_str( dz ) + "</div>";
-    return;
+    return false;
   }
 
-  articleText = Xdxf2Html::convert( string( articleBody ), Xdxf2Html::XDXF, idxHeader.hasAbrv ? &abrv : NULL, this,
-                                    &resourceZip, fType == Logical, idxHeader.revisionNumber, headword );
+  source = articleBody;
+  isLogical = fType == Logical;
 
   free( articleBody );
+
+  return true;
+}
+
+void XdxfDictionary::checkConversion( ConversionCheck & check )
+{
+  QSet< uint32_t > offsets;
+
+  findArticleLinks( 0, &offsets, 0 );
+
+  // Only a few mismatches are printed in full
+  unsigned const maxMismatchesShown = 10;
+
+  for( QSet< uint32_t >::const_iterator i = offsets.constBegin(); i != offsets.constEnd(); ++i )
+  {
+    string source, articleText;
+    bool isLogical;
+
+    if ( !loadArticleSource( *i, source, isLogical, articleText ) )
+      continue;
+
+    map< string, string > const * pAbrv = idxHeader.hasAbrv ? &abrv : NULL;
+    QString domHeadword, streamingHeadword;
+    QElapsedTimer timer;
+
+    timer.start();
+
+    string domHtml = Xdxf2Html::convertWithDom( source, Xdxf2Html::XDXF, pAbrv, this, &resourceZip,
+                                                isLogical, idxHeader.revisionNumber, &domHeadword );
+
+    check.domNsecs += timer.nsecsElapsed();
+
+    timer.restart();
+
+    string streamingHtml = Xdxf2Html::convert( source, Xdxf2Html::XDXF, pAbrv, this, &resourceZip,
+                                               isLogical, idxHeader.revisionNumber, &streamingHeadword );
+
+    check.streamingNsecs += timer.nsecsElapsed();
+
+    ++check.articles;
+
+    domHtml = sortAttributes( domHtml );
+    streamingHtml = sortAttributes( streamingHtml );
+
+    if ( domHtml == streamingHtml && domHeadword == streamingHeadword )
+      continue;
+
+    if ( ++check.mismatches > maxMismatchesShown )
+      continue;
+
+    check.out << "Mismatch in \"" << QString::fromUtf8( getName().c_str() )
+              << "\", article at " << *i << ", headword \"" << domHeadword << "\"\n"
+              << "Source:\n" << QString::fromUtf8( source.c_str() ) << "\n"
+              << "DOM converter, headword \"" << domHeadword << "\":\n"
+              << QString::fromUtf8( domHtml.c_str() ) << "\n"
+              << "Streaming converter, headword \"" << streamingHeadword << "\":\n"
+              << QString::fromUtf8( streamingHtml.c_str() ) << "\n\n";
+  }
 }
 
 class GzippedFile: public QIODevice
@@ -1193,6 +1355,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
       if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
            indexIsOldOrBad( indexFile ) )
       {
+        IndexingStats::EndOfBuild endOfBuild;
+
         // Building the index
 
         gdDebug( "Xdxf: Building the index for dictionary: %s\n", i->c_str() );
@@ -1499,4 +1663,33 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
   return dictionaries;
 }
 
+int checkConversion( vector< sptr< Dictionary::Class > > const & dictionaries )
+{
+  QTextStream out( stdout );
+
+  ConversionCheck check( out );
+
+  unsigned checked = 0;
+
+  for( size_t x = 0; x < dictionaries.size(); ++x )
+  {
+    XdxfDictionary * dict = dynamic_cast< XdxfDictionary * >( dictionaries[ x ].get() );
+
+    if ( !dict )
+      continue;
+
+    dict->checkConversion( check );
+    ++checked;
+  }
+
+  out << QString( "XDXF dictionaries: %1, articles: %2, mismatches: %3\n" )
+           .arg( checked ).arg( check.articles ).arg( check.mismatches );
+
+  out << QString( "DOM converter: %1 ms, streaming converter: %2 ms\n" )
+           .arg( check.domNsecs / 1000000.0, 0, 'f', 1 )
+           .arg( check.streamingNsecs / 1000000.0, 0, 'f', 1 );
+
+  return check.mismatches ? 1 : 0;
+}
+
 }
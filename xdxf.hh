@@ -18,6 +18,13 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
                                       Dictionary::Initializing & )
     THROW_SPEC( std::exception );
 
+/// Converts every article of the XDXF dictionaries among the given ones
+/// with both the streaming converter and the DOM one it has replaced, and
+/// prints the articles they convert differently, along with the time each
+/// converter took in total, to stdout. The attributes may come in any
+/// order. Returns the exit code for main(), which is 1 on any mismatches.
+int checkConversion( vector< sptr< Dictionary::Class > > const & );
+
 }
 
 #endif
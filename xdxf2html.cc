@@ -2,7 +2,11 @@
  * Part of GoldenDict. Licensed under GPLv3 or later, see the LICENSE file */
 
 #include "xdxf2html.hh"
-#include <QtXml>
+#include <QXmlStreamReader>
+#include <QVector>
+#include <QPair>
+#include <QUrl>
+#include <vector>
 #include "gddebug.hh"
 #include "utf8.hh"
 #include "wstring_qt.hh"
@@ -15,22 +19,8 @@
 #include "qt4x5.hh"
 #include <QDebug>
 
-#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
-#include <QRegularExpression>
-#endif
-
 namespace Xdxf2Html {
 
-static void fixLink( QDomElement & el, string const & dictId, const char *attrName )
-{
-  QUrl url;
-  url.setScheme( "bres" );
-  url.setHost( QString::fromStdString(dictId) );
-  url.setPath( Qt4x5::Url::ensureLeadingSlash( el.attribute(attrName) ) );
-
-  el.setAttribute( attrName, url.toEncoded().data() );
-}
-
 // converting a number into roman representation
 string convertToRoman( int input, int lower_case )
 {
@@ -60,120 +50,643 @@ string convertToRoman( int input, int lower_case )
     return romanvalue;
 }
 
-QDomElement fakeElement( QDomDocument & dom )
+namespace {
+
+using std::vector;
+
+// The article is converted in a single pass over the xml. The output is the
+// same html QDomDocument::toString( 1 ) used to produce, with the newlines
+// and the empty <b> and <i> elements removed -- including the indentation
+// it puts between the elements, since it matters for inline elements.
+
+// Entities unknown to xml, like &nbsp;, are passed through as they are.
+// The reader replaces them with the name enclosed in these characters.
+QChar const entityStart( 0xFDD0 ), entityEnd( 0xFDD1 );
+
+class EntityResolver: public QXmlStreamEntityResolver
 {
-  // Create element which will be removed after
-  // We will insert it to empty elements to avoid output ones in <xxx/> form
-  return dom.createElement( "b" );
+public:
+
+  virtual QString resolveUndeclaredEntity( QString const & name )
+  { return QString( entityStart ) + name + entityEnd; }
+};
+
+/// Makes the enclosed entities back into references.
+QString restoreEntities( QString const & str )
+{
+  if ( str.indexOf( entityStart ) < 0 )
+    return str;
+
+  QString result = str;
+
+  result.replace( entityStart, QChar( '&' ) );
+  result.replace( entityEnd, QChar( ';' ) );
+
+  return result;
 }
 
-string convert( string const & in, DICT_TYPE type, map < string, string > const * pAbrv,
-                Dictionary::Class *dictPtr,  IndexedZip * resourceZip,
-                bool isLogicalFormat, unsigned revisionNumber, QString * headword )
+/// Escapes the string the way QDom does it for text nodes (attribute is
+/// false) or attribute values (attribute is true).
+QString escape( QString const & str, bool attribute )
 {
-//  DPRINTF( "Source>>>>>>>>>>: %s\n\n\n", in.c_str() );
+  QString result;
 
-  // Convert spaces after each end of line to &nbsp;s, and then each end of
-  // line to a <br>
+  result.reserve( str.size() );
 
-  string inConverted;
+  for( int x = 0; x < str.size(); ++x )
+  {
+    QChar ch = str[ x ];
 
-  inConverted.reserve( in.size() );
+    if ( ch == '<' )
+      result += "&lt;";
+    else
+    if ( ch == '&' )
+      result += "&amp;";
+    else
+    if ( ch == '>' && x >= 2 && str[ x - 1 ] == ']' && str[ x - 2 ] == ']' )
+      result += "&gt;";
+    else
+    if ( ch == '\r' )
+      result += "&#xd;";
+    else
+    if ( attribute && ch == '"' )
+      result += "&quot;";
+    else
+    if ( attribute && ch == '\n' )
+      result += "&#xa;";
+    else
+    if ( attribute && ch == '\t' )
+      result += "&#x9;";
+    else
+      result += ch;
+  }
 
-  bool afterEol = false;
+  return result;
+}
 
-  for( string::const_iterator i = in.begin(), j = in.end(); i != j; ++i )
+bool isWhitespaceOnly( QString const & str )
+{
+  for( int x = 0; x < str.size(); ++x )
+    if ( str[ x ] != ' ' && str[ x ] != '\t' && str[ x ] != '\n' && str[ x ] != '\r' )
+      return false;
+
+  return true;
+}
+
+typedef QVector< QPair< QString, QString > > Attributes;
+
+bool hasAttribute( Attributes const & attributes, QString const & attrName )
+{
+  for( int x = 0; x < attributes.size(); ++x )
+    if ( attributes[ x ].first == attrName )
+      return true;
+
+  return false;
+}
+
+QString attribute( Attributes const & attributes, QString const & attrName )
+{
+  for( int x = 0; x < attributes.size(); ++x )
+    if ( attributes[ x ].first == attrName )
+      return attributes[ x ].second;
+
+  return QString();
+}
+
+void setAttribute( Attributes & attributes, QString const & attrName, QString const & value )
+{
+  for( int x = 0; x < attributes.size(); ++x )
+    if ( attributes[ x ].first == attrName )
+    {
+      attributes[ x ].second = value;
+      return;
+    }
+
+  attributes.append( QPair< QString, QString >( attrName, value ) );
+}
+
+void removeAttribute( Attributes & attributes, QString const & attrName )
+{
+  for( int x = 0; x < attributes.size(); ++x )
+    if ( attributes[ x ].first == attrName )
+    {
+      attributes.remove( x );
+      return;
+    }
+}
+
+/// The indentation QDom put before the child elements of an element of the
+/// given depth, and before its own end tag
+QString childIndentation( int depth )
+{
+  return QString( depth + 1, QChar( ' ' ) );
+}
+
+QString ownIndentation( int depth )
+{
+  return QString( depth > 0 ? depth : 0, QChar( ' ' ) );
+}
+
+/// Makes the start tag, without its closing bracket
+QString makeStartTag( QString const & name, Attributes const & attributes )
+{
+  QString result = '<' + name;
+
+  for( int x = 0; x < attributes.size(); ++x )
+    result += ' ' + attributes[ x ].first + "=\"" +
+              restoreEntities( escape( attributes[ x ].second, true ) ) + '"';
+
+  return result;
+}
+
+/// The elements the converter makes up itself, serialized the way QDom did
+
+QString makeEmptyElement( QString const & name, Attributes const & attributes )
+{
+  return makeStartTag( name, attributes ) + "/>";
+}
+
+QString makeTextElement( QString const & name, Attributes const & attributes,
+                         QString const & text )
+{
+  return makeStartTag( name, attributes ) + '>' + escape( text, false ) + "</" + name + '>';
+}
+
+QString makeParentElement( QString const & name, Attributes const & attributes, int depth,
+                           QString const & childMarkup )
+{
+  return makeStartTag( name, attributes ) + '>' + childIndentation( depth ) + childMarkup +
+         ownIndentation( depth ) + "</" + name + '>';
+}
+
+Attributes makeClassAttribute( QString const & value )
+{
+  Attributes attributes;
+
+  attributes.append( QPair< QString, QString >( "class", value ) );
+
+  return attributes;
+}
+
+void fixLink( Attributes & attributes, string const & dictId, const char *attrName )
+{
+  QUrl url;
+  url.setScheme( "bres" );
+  url.setHost( QString::fromStdString(dictId) );
+  url.setPath( Qt4x5::Url::ensureLeadingSlash( attribute( attributes, attrName ) ) );
+
+  setAttribute( attributes, attrName, url.toEncoded().data() );
+}
+
+/// An element whose end hasn't been met yet. Its start tag is written once
+/// its first child comes, since the empty elements are written differently.
+/// The few elements whose start tags depend on their text keep their content
+/// until they end, everything else goes straight to the result.
+struct Element
+{
+  QString sourceName; // As in the xdxf
+  QString name;
+  Attributes attributes;
+  int depth;
+  int defNesting; // The number of <def>s this one and its parents make up
+  bool opened; // The start tag is written
+  bool hasChildren, lastChildIsText;
+  bool fakeChild; // Written with an indented empty child if empty, since
+                  // QDom did so for the elements made empty on conversion
+  bool collectsText;
+  QString text; // The text of the child nodes, as QDomElement::text() has it
+  bool buffered;
+  QString content; // The serialized child nodes if buffered
+
+  Element( QString const & name_, int depth_ ):
+    sourceName( name_ ), name( name_ ), depth( depth_ ), defNesting( 0 ),
+    opened( false ), hasChildren( false ), lastChildIsText( false ),
+    fakeChild( false ), collectsText( false ), buffered( false )
+  {}
+};
+
+class Converter
+{
+  DICT_TYPE type;
+  map < string, string > const * pAbrv;
+  Dictionary::Class * dictPtr;
+  IndexedZip * resourceZip;
+  bool isLogicalFormat;
+  unsigned revisionNumber;
+  QString * headword;
+
+  int maxNestingDepth;
+  vector< int > defCounters; // Numbers of the last <def>s at each depth
+
+  QString html;
+  vector< Element > stack; // The document itself is at the bottom
+  vector< size_t > buffered; // Indices of the buffered elements in the stack
+  vector< size_t > textCollectors; // Indices of the ones collecting text
+
+public:
+
+  Converter( DICT_TYPE type_, map < string, string > const * pAbrv_,
+             Dictionary::Class * dictPtr_, IndexedZip * resourceZip_,
+             bool isLogicalFormat_, unsigned revisionNumber_, QString * headword_ ):
+    type( type_ ), pAbrv( pAbrv_ ), dictPtr( dictPtr_ ), resourceZip( resourceZip_ ),
+    isLogicalFormat( isLogicalFormat_ ), revisionNumber( revisionNumber_ ),
+    headword( headword_ ), maxNestingDepth( 1 )
+  {}
+
+  /// Converts the xml, returning false if it isn't well-formed.
+  bool convert( QByteArray const & xml, QString & result );
+
+private:
+
+  /// Finds the maximum nesting depth of <def>s, which sets their numbering
+  /// style.
+  bool findMaxNestingDepth( QByteArray const & xml );
+
+  /// Where the markup of the innermost element goes
+  QString & output()
+  { return buffered.empty() ? html : stack[ buffered.back() ].content; }
+
+  /// Prepares the innermost element for a new child, writing its start tag
+  /// if it's the first one.
+  Element & beginChild();
+
+  /// Writes the markup of a child element of the innermost element, along
+  /// with the indentation before it.
+  void appendElement( QString const & markup );
+
+  void appendText( QString const & );
+  void appendCData( QString const & );
+  void appendEntity( QString const & entityName );
+  void appendComment( QString const & );
+
+  /// Adds the text to the elements collecting it
+  void collectText( QString const & );
+
+  /// Appends the text collected, dropping the whitespace-only pieces, since
+  /// QDom never kept them.
+  void flushText( QString & pendingText );
+
+  /// Tells whether the start tag of the element depends on its text.
+  bool needsText( Element const & el ) const;
+
+  /// Renames the element and sets its attributes as html has it.
+  void transform( Element & el, QString const & parentSourceName );
+
+  void startElement( QString const & name, QXmlStreamAttributes const & );
+  void endElement();
+
+  /// Writes the element which has ended.
+  void writeElement( Element const & el );
+
+  /// Writes the number of the <def> of the logical format, and its comment.
+  void numberDef( Element const & el );
+
+  /// Writes the script and the link playing the sound the <rref> of the
+  /// given depth refers to.
+  void appendSoundLink( int depth, string const & filename );
+};
+
+bool Converter::convert( QByteArray const & xml, QString & result )
+{
+  if( isLogicalFormat && xml.contains( "<def" ) && !findMaxNestingDepth( xml ) )
+    return false;
+
+  if( headword )
+    headword->clear();
+
+  EntityResolver resolver;
+
+  QXmlStreamReader reader( xml );
+
+  reader.setNamespaceProcessing( false );
+  reader.setEntityResolver( &resolver );
+
+  html.reserve( xml.size() * 2 );
+
+  stack.push_back( Element( QString(), -1 ) );
+  stack.back().opened = true;
+
+  QString pendingText;
+
+  while( !reader.atEnd() )
   {
-    switch( *i )
+    QXmlStreamReader::TokenType token = reader.readNext();
+
+    if ( token == QXmlStreamReader::Characters && !reader.isCDATA() )
     {
-      case '\n':
-        afterEol = true;
-        if( !isLogicalFormat )
-          inConverted.append( "<br/>" );
+      pendingText += reader.text();
+      continue;
+    }
+
+    flushText( pendingText );
+
+    switch( token )
+    {
+      case QXmlStreamReader::StartElement:
+        startElement( reader.qualifiedName().toString(), reader.attributes() );
         break;
 
-      case '\r':
+      case QXmlStreamReader::EndElement:
+        endElement();
         break;
 
-      case ' ':
-        if ( afterEol )
-        {
-          if( !isLogicalFormat )
-            inConverted.append( "&nbsp;" ); 
-          break;
-        }
-        // Fall-through
+      case QXmlStreamReader::Characters: // CDATA
+        appendCData( reader.text().toString() );
+        break;
+
+      case QXmlStreamReader::EntityReference:
+        appendEntity( reader.name().toString() );
+        break;
+
+      case QXmlStreamReader::Comment:
+        appendComment( reader.text().toString() );
+        break;
 
       default:
-        inConverted.push_back( *i );
-        afterEol = false;
+        break;
     }
   }
 
-  // Strip "<nu />" tags - QDomDocument don't handle it correctly
-  string::size_type n;
-  while( ( n = inConverted.find( "<nu />" ) ) != string::npos )
-      inConverted.erase( n, 6 );
+  if ( reader.hasError() )
+  {
+    qWarning( "Xdxf2html error, xml parse failed: %s at %d,%d\n", reader.errorString().toLocal8Bit().constData(),
+              (int)reader.lineNumber(), (int)reader.columnNumber() );
+    return false;
+  }
 
-  // We build a dom representation of the given xml, then do some transforms
-  QDomDocument dd;
+  result = html;
+  result.remove( '\n' );
 
-  QString errorStr;
-  int errorLine, errorColumn;
+  return true;
+}
 
-  string in_data;
-  if( type == XDXF )
+bool Converter::findMaxNestingDepth( QByteArray const & xml )
+{
+  EntityResolver resolver;
+
+  QXmlStreamReader reader( xml );
+
+  reader.setNamespaceProcessing( false );
+  reader.setEntityResolver( &resolver );
+
+  vector< int > defNesting( 1, 0 );
+
+  while( !reader.atEnd() )
   {
-      in_data = "<div class=\"xdxf\"";
-      if( dictPtr->isToLanguageRTL() )
-        in_data += " dir=\"rtl\"";
-      in_data += ">";
+    QXmlStreamReader::TokenType token = reader.readNext();
+
+    if ( token == QXmlStreamReader::StartElement )
+    {
+      if ( reader.qualifiedName() == QLatin1String( "def" ) )
+      {
+        if ( defNesting.back() > maxNestingDepth )
+          maxNestingDepth = defNesting.back();
+
+        defNesting.push_back( defNesting.back() + 1 );
+      }
+      else
+        defNesting.push_back( 0 );
+    }
+    else
+    if ( token == QXmlStreamReader::EndElement )
+      defNesting.pop_back();
   }
-  else
-      in_data = "<div class=\"sdct_x\">";
-  in_data += inConverted + "</div>";
 
-  if( !dd.setContent( QByteArray( in_data.c_str() ), false, &errorStr, &errorLine, &errorColumn  ) )
+  if ( reader.hasError() )
   {
-    qWarning( "Xdxf2html error, xml parse failed: %s at %d,%d\n", errorStr.toLocal8Bit().constData(),  errorLine,  errorColumn );
-    gdWarning( "The input was: %s\n", in.c_str() );
+    qWarning( "Xdxf2html error, xml parse failed: %s at %d,%d\n", reader.errorString().toLocal8Bit().constData(),
+              (int)reader.lineNumber(), (int)reader.columnNumber() );
+    return false;
+  }
 
-    return in;
+  return true;
+}
+
+Element & Converter::beginChild()
+{
+  Element & el = stack.back();
+
+  if ( !el.opened )
+  {
+    output() += makeStartTag( el.name, el.attributes ) + '>';
+    el.opened = true;
   }
 
-  QDomNodeList nodes = dd.elementsByTagName( "ex" ); // Example
+  el.hasChildren = true;
+
+  return el;
+}
+
+void Converter::appendElement( QString const & markup )
+{
+  Element & el = beginChild();
+
+  if ( !el.lastChildIsText )
+    output() += childIndentation( el.depth );
+
+  output() += markup;
+  el.lastChildIsText = false;
+}
+
+void Converter::appendText( QString const & str )
+{
+  beginChild().lastChildIsText = true;
+
+  output() += escape( str, false );
+  collectText( str );
+}
+
+void Converter::appendCData( QString const & str )
+{
+  beginChild().lastChildIsText = true;
+
+  QString data = str;
+
+  output() += "<![CDATA[" + data.replace( "]]>", "]]]]><![CDATA[>" ) + "]]>";
+  collectText( str );
+}
+
+void Converter::appendEntity( QString const & entityName )
+{
+  beginChild().lastChildIsText = false;
+
+  output() += '&' + entityName + ';';
+}
+
+void Converter::appendComment( QString const & str )
+{
+  Element & el = beginChild();
+
+  if ( !el.lastChildIsText )
+    output() += childIndentation( el.depth );
+
+  output() += "<!--" + str;
+
+  if ( str.endsWith( '-' ) )
+    output() += ' ';
+
+  output() += "-->";
+  el.lastChildIsText = false;
+}
+
+void Converter::collectText( QString const & str )
+{
+  for( size_t x = 0; x < textCollectors.size(); ++x )
+    stack[ textCollectors[ x ] ].text += str;
+}
 
-  while( nodes.size() )
+void Converter::flushText( QString & pendingText )
+{
+  if ( pendingText.isEmpty() )
+    return;
+
+  for( int pos = 0; ; )
   {
-    QString author, source;
-    QDomElement el = nodes.at( 0 ).toElement();
+    int start = pendingText.indexOf( entityStart, pos );
 
-    author = el.attribute( "author", QString() );
-    source = el.attribute( "source", QString() );
+    QString piece = pendingText.mid( pos, start < 0 ? -1 : start - pos );
 
-    if( el.hasChildNodes() )
-    {
-      QDomNodeList lst = el.childNodes();
-      for( int i = 0; i < lst.count(); ++i )
-      {
-        QDomElement el2 = el.childNodes().at( i ).toElement();
-        if( el2.tagName().compare( "ex_orig", Qt::CaseInsensitive ) == 0 )
-        {
-          el2.setTagName( "span" );
-          el2.setAttribute( "class", "xdxf_ex_orig" );
-        }
-        else if( el2.tagName().compare( "ex_tran", Qt::CaseInsensitive ) == 0 )
-        {
-          el2.setTagName( "span" );
-          el2.setAttribute( "class", "xdxf_ex_tran" );
-        }
-      }
-    }
-    if( ( !author.isEmpty() || !source.isEmpty() )
-        && ( !el.text().isEmpty() || !el.childNodes().isEmpty() ) )
+    if ( !piece.isEmpty() && !isWhitespaceOnly( piece ) )
+      appendText( piece );
+
+    if ( start < 0 )
+      break;
+
+    int end = pendingText.indexOf( entityEnd, start );
+
+    appendEntity( pendingText.mid( start + 1, end - start - 1 ) );
+
+    pos = end + 1;
+  }
+
+  pendingText.clear();
+}
+
+bool Converter::needsText( Element const & el ) const
+{
+  QString const & name = el.sourceName;
+
+  if ( name == "kref" )
+    return true;
+
+  if ( name == "iref" )
+    return attribute( el.attributes, "href" ).isEmpty();
+
+  if ( name == ( revisionNumber < 29 ? "abr" : "abbr" ) )
+    return type == XDXF && pAbrv != NULL;
+
+  if ( name == "rref" )
+    return dictPtr != NULL && !hasAttribute( el.attributes, "start" );
+
+  return false;
+}
+
+void Converter::startElement( QString const & name, QXmlStreamAttributes const & attrs )
+{
+  // The indentation within the parent doesn't depend on the element, QDom
+  // wrote it even for the elements dropped later
+  appendElement( QString() );
+
+  Element el( name, stack.back().depth + 1 );
+
+  for( int x = 0; x < attrs.size(); ++x )
+    el.attributes.append( QPair< QString, QString >( attrs[ x ].qualifiedName().toString(),
+                                                     attrs[ x ].value().toString() ) );
+
+  if ( needsText( el ) )
+  {
+    el.buffered = true;
+    el.opened = true; // Its start tag is written with the rest of it
+    el.collectsText = true;
+  }
+  else
+  {
+    transform( el, stack.back().sourceName );
+
+    el.collectsText = name == "k" && headword && type != STARDICT;
+  }
+
+  if ( name == "def" )
+    el.defNesting = stack.back().defNesting + 1;
+
+  stack.push_back( el );
+
+  if ( el.buffered )
+    buffered.push_back( stack.size() - 1 );
+
+  if ( el.collectsText )
+    textCollectors.push_back( stack.size() - 1 );
+
+  if ( name == "def" && isLogicalFormat )
+    numberDef( stack.back() );
+}
+
+void Converter::numberDef( Element const & el )
+{
+  // This is a logical type of XDXF, so we need to render proper numbering.
+  // The <def>s are numbered among the ones of the same depth, until the one
+  // of a smaller depth comes.
+
+  int nestingDepth = el.defNesting - 1;
+
+  if ( (int)defCounters.size() <= nestingDepth )
+    defCounters.resize( nestingDepth + 1, 0 );
+
+  int siblingCount = ++defCounters[ nestingDepth ];
+
+  defCounters.resize( nestingDepth + 1 );
+
+  if ( !nestingDepth )
+    return; // Top-level ones aren't numbered
+
+  QString numberText; // the number to be inserted into the beginning of <def> (I,II,IV,1,2,3,a),b),c)...)
+
+  if( maxNestingDepth == 1 )
+  {
+    numberText = numberText.setNum( siblingCount ) + ". ";
+  }
+  else if( maxNestingDepth == 2 )
+  {
+    if( nestingDepth == 1 )
+      numberText = numberText.setNum( siblingCount ) + ". ";
+    if( nestingDepth == 2 )
+      numberText = numberText.setNum( siblingCount ) + ") ";
+  }
+  else
+  {
+    if( nestingDepth == 1 )
+      numberText = QString::fromStdString( convertToRoman(siblingCount,0) + ". " );
+    if( nestingDepth == 2 )
+      numberText = numberText.setNum( siblingCount ) + ". ";
+    if( nestingDepth == 3 )
+      numberText = numberText.setNum( siblingCount ) + ") ";
+    if( nestingDepth == 4 )
+      numberText = QString::fromStdString( convertToRoman(siblingCount,1) + ") " );
+  }
+
+  appendElement( makeTextElement( "span", makeClassAttribute( "xdxf_num" ), numberText ) );
+  collectText( numberText );
+
+  if ( hasAttribute( el.attributes, "cmt" ) )
+  {
+    QString cmt = attribute( el.attributes, "cmt" );
+
+    appendElement( makeTextElement( "span", makeClassAttribute( "xdxf_co" ), cmt ) );
+    collectText( cmt );
+  }
+}
+
+void Converter::endElement()
+{
+  Element & el = stack.back();
+
+  if ( el.sourceName == "ex" && el.hasChildren )
+  {
+    QString author = attribute( el.attributes, "author" );
+    QString source = attribute( el.attributes, "source" );
+
+    if( !author.isEmpty() || !source.isEmpty() )
     {
-      QDomElement el2 = dd.createElement( "span" );
-      el2.setAttribute( "class", "xdxf_ex_source" );
       QString text = author;
       if( !source.isEmpty() )
       {
@@ -181,229 +694,217 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
           text += ", ";
         text += source;
       }
-      QDomText txtNode = dd.createTextNode( text );
-      el2.appendChild( txtNode );
-      el.appendChild( el2 );
+      appendElement( makeTextElement( "span", makeClassAttribute( "xdxf_ex_source" ), text ) );
+      collectText( text );
     }
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
-
-    el.setTagName( "span" );
-    if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_ex" );
-    else
-      el.setAttribute( "class", "xdxf_ex_old" );
   }
-  
-  nodes = dd.elementsByTagName( "mrkd" ); // marked out words in translations/examples of usage
 
-  while( nodes.size() )
-  {
-    QDomElement el = nodes.at( 0 ).toElement();
+  if ( el.sourceName == "k" && el.collectsText && headword->isEmpty() )
+    *headword = el.text;
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+  if ( el.collectsText )
+    textCollectors.pop_back();
 
-    el.setTagName( "span" );
-    el.setAttribute( "class", "xdxf_ex_markd" );
+  if ( !el.buffered )
+  {
+    writeElement( el );
+    stack.pop_back();
+    return;
   }
 
-  nodes = dd.elementsByTagName( "k" ); // Key
+  // From now on the markup goes where the parent's does
+  buffered.pop_back();
 
-  if( headword )
-    headword->clear();
+  transform( el, stack[ stack.size() - 2 ].sourceName );
 
-  while( nodes.size() )
+  if ( el.sourceName == "rref" )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    string filename = Utf8::encode( gd::toWString( el.text ) );
 
-    if( type == STARDICT )
+    if ( Filetype::isNameOfPicture( filename ) )
     {
-        el.setTagName( "span" );
-        el.setAttribute( "class", "xdxf_k" );
+      QUrl url;
+      url.setScheme( "bres" );
+      url.setHost( QString::fromUtf8( dictPtr->getId().c_str() ) );
+      url.setPath( Qt4x5::Url::ensureLeadingSlash( QString::fromUtf8( filename.c_str() ) ) );
+
+      Attributes attributes;
+      setAttribute( attributes, "src", url.toEncoded().data() );
+      setAttribute( attributes, "alt", Html::escape( filename ).c_str() );
+
+      output() += makeEmptyElement( "img", attributes );
+      stack.pop_back();
+      return;
     }
     else
+    if ( Filetype::isNameOfSound( filename ) )
     {
-        if( headword && headword->isEmpty() )
-          *headword = el.text();
+      int depth = el.depth;
 
-        el.setTagName( "div" );
-        el.setAttribute( "class", "xdxf_headwords" );
-        if( dictPtr->isFromLanguageRTL() != dictPtr->isToLanguageRTL() )
-          el.setAttribute( "dir", dictPtr->isFromLanguageRTL() ? "rtl" : "ltr" );
+      stack.pop_back();
+      appendSoundLink( depth, filename );
+      return;
     }
   }
-  
-  // processing of nested <def>s
-  if( isLogicalFormat ) // in articles with visual format <def> tags do not effect the formatting.
-  {
-    nodes = dd.elementsByTagName( "def" );
-    
-    // this is a logical type of XDXF, so we need to render proper numbering
-    // we will do it this way:
-    
-    // 1. we compute the maximum nesting depth of the article
-    int maxNestingDepth = 1; // maximum nesting depth of the article
-    for( int i = 0; i < nodes.size(); i++ )
-    {
-      QDomElement el = nodes.at( i ).toElement();
-      QDomElement nestingNode = el;
-      int nestingCount = 0;
-      while ( nestingNode.parentNode().toElement().tagName() == "def" )
-      {
-        nestingCount++;
-        nestingNode = nestingNode.parentNode().toElement();
-      }
-      if ( nestingCount > maxNestingDepth )
-        maxNestingDepth = nestingCount;
-    }
-    // 2. in this loop we go layer-by-layer through all <def> and insert proper numbers according to its structure
-    for( int j = maxNestingDepth; j > 0; j-- ) // j symbolizes special depth to be processed at this iteration
+
+  writeElement( el );
+
+  bool hasKcmt = el.sourceName == "kref" && hasAttribute( el.attributes, "kcmt" );
+  QString kcmt = hasKcmt ? attribute( el.attributes, "kcmt" ) : QString();
+
+  stack.pop_back();
+
+  if ( hasKcmt )
+    appendText( " " + kcmt );
+}
+
+void Converter::writeElement( Element const & el )
+{
+  QString & out = output();
+
+  if ( el.buffered )
+  {
+    out += makeStartTag( el.name, el.attributes );
+
+    if ( el.hasChildren )
+      out += '>' + el.content;
+  }
+  else
+  if ( !el.opened )
+  {
+    // It had no children
+    if ( !el.fakeChild && el.attributes.isEmpty() && ( el.name == "b" || el.name == "i" ) )
+      return; // These were dropped from the output
+
+    out += makeStartTag( el.name, el.attributes );
+  }
+
+  if ( !el.hasChildren )
+  {
+    if ( el.fakeChild )
+      out += '>' + childIndentation( el.depth ) + ownIndentation( el.depth ) + "</" + el.name + '>';
+    else
+      out += "/>";
+
+    return;
+  }
+
+  if ( !el.lastChildIsText )
+    out += ownIndentation( el.depth );
+
+  out += "</" + el.name + '>';
+}
+
+void Converter::transform( Element & el, QString const & parentSourceName )
+{
+  QString const & name = el.sourceName;
+
+  Attributes & attributes = el.attributes;
+
+  if ( parentSourceName == "ex" )
+  {
+    if( name.compare( "ex_orig", Qt::CaseInsensitive ) == 0 )
     {
-      int siblingCount = 0; // this  that counts the number of among all siblings of this depth
-      QString numberText = ""; // the number to be inserted into the beginning of <def> (I,II,IV,1,2,3,a),b),c)...)
-      for( int i = 0; i < nodes.size(); i++ )
-      {
-        QDomElement el = nodes.at( i ).toElement();
-        QDomElement nestingNode = el;
-        // computing the depth @nestingDepth of a current node @el
-        int nestingDepth = 0;
-        while( nestingNode.parentNode().toElement().tagName() == "def" )
-        {
-          nestingDepth++;
-          nestingNode=nestingNode.parentNode().toElement();
-        } 
-        // we process nodes on of current depth @j
-        // we do this in order not to break the numbering at this depth level
-        if (nestingDepth == j)
-        {
-          siblingCount++;
-          if( maxNestingDepth == 1 )
-          {
-            numberText = numberText.setNum( siblingCount ) + ". ";
-          }
-          else if( maxNestingDepth == 2 )
-          {
-            if( nestingDepth == 1 )
-              numberText = numberText.setNum( siblingCount ) + ". ";
-            if( nestingDepth == 2 )
-              numberText = numberText.setNum( siblingCount ) + ") ";
-          }
-          else
-          {
-            if( nestingDepth == 1 )
-              numberText = QString::fromStdString( convertToRoman(siblingCount,0) + ". " );
-            if( nestingDepth == 2 )
-              numberText = numberText.setNum( siblingCount ) + ". ";
-            if( nestingDepth == 3 )
-              numberText = numberText.setNum( siblingCount ) + ") ";
-            if( nestingDepth == 4 )
-              numberText = QString::fromStdString( convertToRoman(siblingCount,1) + ") " );
-          }
-          QDomElement numberNode = dd.createElement( "span" );
-          numberNode.setAttribute( "class", "xdxf_num" );
-          QDomText text_num = dd.createTextNode( numberText );
-          numberNode.appendChild( text_num );
-          el.insertBefore( numberNode, el.firstChild() );
-          
-          if ( el.hasAttribute( "cmt" ) )
-          {
-            QDomElement cmtNode = dd.createElement( "span" );
-            cmtNode.setAttribute( "class", "xdxf_co" );
-            QDomText text_num = dd.createTextNode( el.attribute( "cmt" ) );
-            cmtNode.appendChild( text_num );
-            el.insertAfter( cmtNode, el.firstChild() );
-          }
-        }
-        else if( nestingDepth < j ) // if it goes one level up @siblingCount needs to be reset
-          siblingCount = 0;
-      }
+      el.name = "span";
+      setAttribute( attributes, "class", "xdxf_ex_orig" );
+      return;
     }
-    // we finally change all <def> tags into 'xdxf_def' <span>s
-    while( nodes.size() )
+    else if( name.compare( "ex_tran", Qt::CaseInsensitive ) == 0 )
     {
-      QDomElement el = nodes.at( 0 ).toElement();
-      el.setTagName( "span" );
-      el.setAttribute( "class", "xdxf_def" );
+      el.name = "span";
+      setAttribute( attributes, "class", "xdxf_ex_tran" );
+      return;
     }
   }
-  
-  nodes = dd.elementsByTagName( "opt" ); // Optional headword part
 
-  while( nodes.size() )
+  if ( name == "ex" ) // Example
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    // The source is added once its end is met
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    el.setTagName( "span" );
-    el.setAttribute( "class", "xdxf_opt" );
+    el.name = "span";
+    if( isLogicalFormat )
+      setAttribute( attributes, "class", "xdxf_ex" );
+    else
+      setAttribute( attributes, "class", "xdxf_ex_old" );
   }
-
-  nodes = dd.elementsByTagName( "kref" ); // Reference to another word
-
-  while( nodes.size() )
+  else
+  if ( name == "mrkd" ) // marked out words in translations/examples of usage
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    el.fakeChild = true;
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_ex_markd" );
+  }
+  else
+  if ( name == "k" ) // Key
+  {
+    el.fakeChild = true;
 
-    el.setTagName( "a" );
-    el.setAttribute( "href", QString( "bword:" ) + el.text() );
-    el.setAttribute( "class", "xdxf_kref" );
-    if ( el.hasAttribute( "idref" ) )
+    if( type == STARDICT )
     {
-      // todo implement support for referencing only specific parts of the article
-      el.setAttribute( "href", QString( "bword:" ) + el.text() + "#" + el.attribute( "idref" ));
+        el.name = "span";
+        setAttribute( attributes, "class", "xdxf_k" );
     }
-    if ( el.hasAttribute( "kcmt" ) )
+    else
     {
-      QDomText kcmtText = dd.createTextNode( " " + el.attribute( "kcmt" ) );
-      el.parentNode().insertAfter( kcmtText, el );
+        el.name = "div";
+        setAttribute( attributes, "class", "xdxf_headwords" );
+        if( dictPtr->isFromLanguageRTL() != dictPtr->isToLanguageRTL() )
+          setAttribute( attributes, "dir", dictPtr->isFromLanguageRTL() ? "rtl" : "ltr" );
     }
   }
+  else
+  if ( name == "def" && isLogicalFormat )
+  {
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_def" );
+  }
+  else
+  if ( name == "opt" ) // Optional headword part
+  {
+    el.fakeChild = true;
 
-  nodes = dd.elementsByTagName( "iref" ); // Reference to internet site
-
-  while( nodes.size() )
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_opt" );
+  }
+  else
+  if ( name == "kref" ) // Reference to another word
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    el.fakeChild = true;
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.name = "a";
+    setAttribute( attributes, "href", QString( "bword:" ) + el.text );
+    setAttribute( attributes, "class", "xdxf_kref" );
+    if ( hasAttribute( attributes, "idref" ) )
+    {
+      // todo implement support for referencing only specific parts of the article
+      setAttribute( attributes, "href", QString( "bword:" ) + el.text + "#" + attribute( attributes, "idref" ) );
+    }
+  }
+  else
+  if ( name == "iref" ) // Reference to internet site
+  {
+    el.fakeChild = true;
 
-    QString ref = el.attribute( "href" );
+    QString ref = attribute( attributes, "href" );
     if( ref.isEmpty() )
-      ref = el.text();
+      ref = el.text;
 
-    el.setAttribute( "href", ref );
-    el.setTagName( "a" );
+    setAttribute( attributes, "href", ref );
+    el.name = "a";
   }
-
-  // Abbreviations
-  if( revisionNumber < 29 )
-    nodes = dd.elementsByTagName( "abr" );
   else
-    nodes = dd.elementsByTagName( "abbr" );
-
-  while( nodes.size() )
+  if ( name == ( revisionNumber < 29 ? "abr" : "abbr" ) ) // Abbreviations
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    el.setTagName( "span" );
-    el.setAttribute( "class", "xdxf_abbr" );
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_abbr" );
     if( type == XDXF && pAbrv != NULL )
     {
-        string val = Utf8::encode( Folding::trimWhitespace( gd::toWString( el.text() ) ) );
+        string val = Utf8::encode( Folding::trimWhitespace( gd::toWString( el.text ) ) );
 
         // If we have such a key, display a title
 
@@ -439,261 +940,237 @@ string convert( string const & in, DICT_TYPE type, map < string, string > const
           }
           else
             title = i->second;
-          el.setAttribute( "title", gd::toQString( Utf8::decode( title ) ) );
+          setAttribute( attributes, "title", gd::toQString( Utf8::decode( title ) ) );
         }
     }
   }
-
-  nodes = dd.elementsByTagName( "dtrn" ); // Direct translation
-
-  while( nodes.size() )
+  else
+  if ( name == "dtrn" ) // Direct translation
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    el.setTagName( "span" );
-    el.setAttribute( "class", "xdxf_dtrn" );
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_dtrn" );
   }
-
-  nodes = dd.elementsByTagName( "c" ); // Color
-
-  while( nodes.size() )
+  else
+  if ( name == "c" ) // Color
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    el.setTagName( "span" );
+    el.name = "span";
 
-    if ( el.hasAttribute( "c" ) )
+    if ( hasAttribute( attributes, "c" ) )
     {
-      el.setAttribute( "style", "color:" + el.attribute( "c" ) );
-      el.removeAttribute( "c" );
+      setAttribute( attributes, "style", "color:" + attribute( attributes, "c" ) );
+      removeAttribute( attributes, "c" );
     }
     else
-      el.setAttribute( "style", "color:blue" );
+      setAttribute( attributes, "style", "color:blue" );
   }
-
-  nodes = dd.elementsByTagName( "co" ); // Editorial comment
-
-  while( nodes.size() )
-  {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
-
-    el.setTagName( "span" );
-    if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_co" );
-    else
-      el.setAttribute( "class", "xdxf_co_old" );
-  }
-
-  /* grammar information */
-  nodes = dd.elementsByTagName( "gr" ); // proper grammar tag
-  while( nodes.size() )
-  {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
-
-    el.setTagName( "span" );
-    if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_gr" );
-    else
-      el.setAttribute( "class", "xdxf_gr_old" );
-  }
-  nodes = dd.elementsByTagName( "pos" ); // deprecated grammar tag
-  while( nodes.size() )
+  else
+  if ( name == "co" ) // Editorial comment
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    el.fakeChild = true;
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
-
-    el.setTagName( "span" );
+    el.name = "span";
     if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_gr" );
+      setAttribute( attributes, "class", "xdxf_co" );
     else
-      el.setAttribute( "class", "xdxf_gr_old" );
+      setAttribute( attributes, "class", "xdxf_co_old" );
   }
-  nodes = dd.elementsByTagName( "tense" ); // deprecated grammar tag
-  while( nodes.size() )
+  else
+  if ( name == "gr" || name == "pos" || name == "tense" ) // grammar information
   {
-    QDomElement el = nodes.at( 0 ).toElement();
-
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    el.setTagName( "span" );
+    el.name = "span";
     if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_gr" );
+      setAttribute( attributes, "class", "xdxf_gr" );
     else
-      el.setAttribute( "class", "xdxf_gr_old" );
+      setAttribute( attributes, "class", "xdxf_gr_old" );
   }
-  /* end of grammar generation */
-  
-  nodes = dd.elementsByTagName( "tr" ); // Transcription
-
-  while( nodes.size() )
+  else
+  if ( name == "tr" ) // Transcription
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    el.fakeChild = true;
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
-
-    el.setTagName( "span" );
+    el.name = "span";
     if( isLogicalFormat )
-      el.setAttribute( "class", "xdxf_tr" );
+      setAttribute( attributes, "class", "xdxf_tr" );
     else
-      el.setAttribute( "class", "xdxf_tr_old" );
+      setAttribute( attributes, "class", "xdxf_tr_old" );
   }
-  
-  // Ensure that ArticleNetworkAccessManager can deal with XDXF images.
-  // We modify the URL by using the dictionary ID as the hostname.
-  // This is necessary to determine from which dictionary a requested
-  // image originates.
-  nodes = dd.elementsByTagName( "img" );
-
-  for( int i = 0; i < nodes.size(); i++ )
+  else
+  if ( name == "img" )
   {
-    QDomElement el = nodes.at( i ).toElement();
+    // Ensure that ArticleNetworkAccessManager can deal with XDXF images.
+    // We modify the URL by using the dictionary ID as the hostname.
+    // This is necessary to determine from which dictionary a requested
+    // image originates.
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+    el.fakeChild = true;
 
-    if ( el.hasAttribute( "src" ) )
+    if ( hasAttribute( attributes, "src" ) )
     {
-      fixLink( el, dictPtr->getId(), "src" );
+      fixLink( attributes, dictPtr->getId(), "src" );
     }
 
-    if ( el.hasAttribute( "losrc" ) )
+    if ( hasAttribute( attributes, "losrc" ) )
     {
-      fixLink( el, dictPtr->getId(), "losrc" );
+      fixLink( attributes, dictPtr->getId(), "losrc" );
     }
 
-    if ( el.hasAttribute( "hisrc" ) )
+    if ( hasAttribute( attributes, "hisrc" ) )
     {
-      fixLink( el, dictPtr->getId(), "hisrc" );
+      fixLink( attributes, dictPtr->getId(), "hisrc" );
     }
   }
+  else
+  if ( name == "rref" ) // Resource reference
+  {
+    // The pictures and sounds are replaced once the end is met. We don't
+    // really know how to handle the rest at the moment, so we'll just
+    // convert it to a span and leave it as is for now.
 
-  nodes = dd.elementsByTagName( "rref" ); // Resource reference
+    el.fakeChild = true;
 
-  while( nodes.size() )
+    el.name = "span";
+    setAttribute( attributes, "class", "xdxf_rref" );
+  }
+}
+
+void Converter::appendSoundLink( int depth, string const & filename )
+{
+  bool search = false;
+  if( type == STARDICT )
   {
-    QDomElement el = nodes.at( 0 ).toElement();
+    string n = FsEncoding::dirname( dictPtr->getDictionaryFilenames()[ 0 ] ) +
+               FsEncoding::separator() + string( "res" ) + FsEncoding::separator() +
+               FsEncoding::encode( filename );
+    search = !File::exists( n ) &&
+             ( !resourceZip ||
+               !resourceZip->isOpen() ||
+               !resourceZip->hasFile( Utf8::decode( filename ) ) );
+  }
+  else
+  {
+    string n = dictPtr->getDictionaryFilenames()[ 0 ] + ".files" +
+               FsEncoding::separator() +
+               FsEncoding::encode( filename );
+    search = !File::exists( n ) && !File::exists( FsEncoding::dirname( dictPtr->getDictionaryFilenames()[ 0 ] ) +
+                                                  FsEncoding::separator() +
+                                                  FsEncoding::encode( filename ) ) &&
+             ( !resourceZip ||
+               !resourceZip->isOpen() ||
+               !resourceZip->hasFile( Utf8::decode( filename ) ) );
+  }
 
-    if( el.text().isEmpty() && el.childNodes().isEmpty() )
-      el.appendChild( fakeElement( dd ) );
+  QUrl url;
+  url.setScheme( "gdau" );
+  url.setHost( QString::fromUtf8( search ? Dictionary::ResourceSearch::xdxfTypeName() : dictPtr->getId().c_str() ) );
+  url.setPath( Qt4x5::Url::ensureLeadingSlash( QString::fromUtf8( filename.c_str() ) ) );
 
-//    if( type == XDXF && dictPtr != NULL && !el.hasAttribute( "start" ) )
-    if( dictPtr != NULL && !el.hasAttribute( "start" ) )
-    {
-        string filename = Utf8::encode( gd::toWString( el.text() ) );
+  // The indentation before the script was written when the element started
 
-        if ( Filetype::isNameOfPicture( filename ) )
-        {
-          QUrl url;
-          url.setScheme( "bres" );
-          url.setHost( QString::fromUtf8( dictPtr->getId().c_str() ) );
-          url.setPath( Qt4x5::Url::ensureLeadingSlash( QString::fromUtf8( filename.c_str() ) ) );
+  Attributes scriptAttributes;
+  setAttribute( scriptAttributes, "type", "text/javascript" );
 
-          QDomElement newEl = dd.createElement( "img" );
-          newEl.setAttribute( "src", url.toEncoded().data() );
-          newEl.setAttribute( "alt", Html::escape( filename ).c_str() );
+  output() += makeTextElement( "script", scriptAttributes,
+                               makeAudioLinkScript( string( "\"" ) + url.toEncoded().data() + "\"",
+                                                    dictPtr->getId() ).c_str() );
 
-          QDomNode parent = el.parentNode();
-          if( !parent.isNull() )
-          {
-            parent.replaceChild( newEl, el );
-            continue;
-          }
-        }
-        else if( Filetype::isNameOfSound( filename ) )
-        {
+  Attributes imgAttributes;
+  setAttribute( imgAttributes, "src", "qrcx://localhost/icons/playsound.png" );
+  setAttribute( imgAttributes, "border", "0" );
+  setAttribute( imgAttributes, "align", "absmiddle" );
+  setAttribute( imgAttributes, "alt", "Play" );
 
-          QDomElement el_script = dd.createElement( "script" );
-          QDomNode parent = el.parentNode();
-          if( !parent.isNull() )
-          {
-            bool search = false;
-            if( type == STARDICT )
-            {
-              string n = FsEncoding::dirname( dictPtr->getDictionaryFilenames()[ 0 ] ) +
-                         FsEncoding::separator() + string( "res" ) + FsEncoding::separator() +
-                         FsEncoding::encode( filename );
-              search = !File::exists( n ) &&
-                       ( !resourceZip ||
-                         !resourceZip->isOpen() ||
-                         !resourceZip->hasFile( Utf8::decode( filename ) ) );
-            }
-            else
-            {
-              string n = dictPtr->getDictionaryFilenames()[ 0 ] + ".files" +
-                         FsEncoding::separator() +
-                         FsEncoding::encode( filename );
-              search = !File::exists( n ) && !File::exists( FsEncoding::dirname( dictPtr->getDictionaryFilenames()[ 0 ] ) +
-                                                            FsEncoding::separator() +
-                                                            FsEncoding::encode( filename ) ) &&
-                       ( !resourceZip ||
-                         !resourceZip->isOpen() ||
-                         !resourceZip->hasFile( Utf8::decode( filename ) ) );
-            }
+  Attributes aAttributes;
+  setAttribute( aAttributes, "href", url.toEncoded().data() );
 
+  QString a = makeParentElement( "a", aAttributes, depth + 1,
+                                 makeEmptyElement( "img", imgAttributes ) );
 
-            QUrl url;
-            url.setScheme( "gdau" );
-            url.setHost( QString::fromUtf8( search ? Dictionary::ResourceSearch::xdxfTypeName() : dictPtr->getId().c_str() ) );
-            url.setPath( Qt4x5::Url::ensureLeadingSlash( QString::fromUtf8( filename.c_str() ) ) );
+  appendElement( makeParentElement( "span", makeClassAttribute( "xdxf_wav" ), depth, a ) );
+}
 
-            el_script.setAttribute( "type", "text/javascript" );
-            parent.replaceChild( el_script, el );
+}
+}
 
-            QDomText el_txt = dd.createTextNode( makeAudioLinkScript( string( "\"" ) + url.toEncoded().data() + "\"",
-                                                                      dictPtr->getId() ).c_str() );
-            el_script.appendChild( el_txt );
+string convert( string const & in, DICT_TYPE type, map < string, string > const * pAbrv,
+                Dictionary::Class *dictPtr,  IndexedZip * resourceZip,
+                bool isLogicalFormat, unsigned revisionNumber, QString * headword )
+{
+//  DPRINTF( "Source>>>>>>>>>>: %s\n\n\n", in.c_str() );
+
+  // Convert spaces after each end of line to &nbsp;s, and then each end of
+  // line to a <br>
 
-            QDomElement el_span = dd.createElement( "span" );
-            el_span.setAttribute( "class", "xdxf_wav" );
-            parent.insertAfter( el_span, el_script );
+  string inConverted;
 
-            QDomElement el_a = dd.createElement( "a" );
-            el_a.setAttribute( "href", url.toEncoded().data() );
-            el_span.appendChild( el_a );
+  inConverted.reserve( in.size() );
 
-            QDomElement el_img = dd.createElement( "img");
-            el_img.setAttribute( "src", "qrcx://localhost/icons/playsound.png" );
-            el_img.setAttribute( "border", "0" );
-            el_img.setAttribute( "align", "absmiddle" );
-            el_img.setAttribute( "alt", "Play" );
-            el_a.appendChild( el_img );
+  bool afterEol = false;
 
-            continue;
-          }
+  for( string::const_iterator i = in.begin(), j = in.end(); i != j; ++i )
+  {
+    switch( *i )
+    {
+      case '\n':
+        afterEol = true;
+        if( !isLogicalFormat )
+          inConverted.append( "<br/>" );
+        break;
+
+      case '\r':
+        break;
+
+      case ' ':
+        if ( afterEol )
+        {
+          if( !isLogicalFormat )
+            inConverted.append( "&nbsp;" ); 
+          break;
         }
+        // Fall-through
+
+      default:
+        inConverted.push_back( *i );
+        afterEol = false;
     }
+  }
 
-    // We don't really know how to handle this at the moment, so we'll just
-    // convert it to a span and leave it as is for now.
+  // Strip "<nu />" tags - QDomDocument don't handle it correctly
+  string::size_type n;
+  while( ( n = inConverted.find( "<nu />" ) ) != string::npos )
+      inConverted.erase( n, 6 );
+
+  string in_data;
+  if( type == XDXF )
+  {
+      in_data = "<div class=\"xdxf\"";
+      if( dictPtr->isToLanguageRTL() )
+        in_data += " dir=\"rtl\"";
+      in_data += ">";
+  }
+  else
+      in_data = "<div class=\"sdct_x\">";
+  in_data += inConverted + "</div>";
 
-    el.setTagName( "span" );
-    el.setAttribute( "class", "xdxf_rref" );
+  Converter converter( type, pAbrv, dictPtr, resourceZip, isLogicalFormat, revisionNumber, headword );
+
+  QString result;
+
+  if( !converter.convert( QByteArray( in_data.data(), in_data.size() ), result ) )
+  {
+    gdWarning( "The input was: %s\n", in.c_str() );
+
+    return in;
   }
 
-//  GD_DPRINTF( "Result>>>>>>>>>>: %s\n\n\n", dd.toByteArray( 0 ).data() );
+//  GD_DPRINTF( "Result>>>>>>>>>>: %s\n\n\n", result.toUtf8().data() );
 
-#if QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 )
-  return dd.toString( 1 ).remove('\n').remove( QRegularExpression( "<(b|i)/>" ) ).toUtf8().data();
-#else
-  return dd.toString( 1 ).remove('\n').remove( QRegExp( "<(b|i)/>" ) ).toUtf8().data();
-#endif
+  return result.toUtf8().data();
 }
 
 }
-
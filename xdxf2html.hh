@@ -24,6 +24,13 @@ string convert( string const &, DICT_TYPE type, map < string, string > const * p
                 Dictionary::Class *dictPtr, IndexedZip * resourceZip, bool isLogicalFormat = false,
                 unsigned revisionNumber = 0, QString * headword = 0 );
 
+/// The DOM-based converter convert() has replaced, taking the same
+/// arguments. It is only kept as the reference its output is checked
+/// against, see Xdxf::checkConversion().
+string convertWithDom( string const &, DICT_TYPE type, map < string, string > const * pAbrv,
+                       Dictionary::Class *dictPtr, IndexedZip * resourceZip, bool isLogicalFormat = false,
+                       unsigned revisionNumber = 0, QString * headword = 0 );
+
 }
 
 #endif
@@ -5,6 +5,7 @@
 
 #include "zim.hh"
 #include "btreeidx.hh"
+#include "indexingstats.hh"
 #include "fsencoding.hh"
 #include "folding.hh"
 #include "gddebug.hh"
@@ -1260,16 +1261,7 @@ void ZimArticleRequest::run()
     return;
   }
 
-  vector< WordArticleLink > chain = dict.findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = dict.findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = dict.findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, pair< string, string > > mainArticles, alternateArticles;
 
@@ -1576,6 +1568,8 @@ vector< sptr< Dictionary::Class > > makeDictionaries(
         if ( Dictionary::needToRebuildIndex( dictFiles, indexFile ) ||
              indexIsOldOrBad( indexFile ) )
         {
+          IndexingStats::EndOfBuild endOfBuild;
+
           gdDebug( "Zim: Building the index for dictionary: %s\n", i->c_str() );
 
 
@@ -180,16 +180,7 @@ sptr< Dictionary::DataRequest > ZipSoundsDictionary::getArticle( wstring const &
                                                                  bool ignoreDiacritics )
   THROW_SPEC( std::exception )
 {
-  vector< WordArticleLink > chain = findArticles( word, ignoreDiacritics );
-
-  for( unsigned x = 0; x < alts.size(); ++x )
-  {
-    /// Make an additional query for each alt
-
-    vector< WordArticleLink > altChain = findArticles( alts[ x ], ignoreDiacritics );
-
-    chain.insert( chain.end(), altChain.begin(), altChain.end() );
-  }
+  vector< WordArticleLink > chain = findArticles( word, alts, ignoreDiacritics );
 
   multimap< wstring, uint32_t > mainArticles, alternateArticles;
 